@@ -0,0 +1,62 @@
+/**
+ * Cost of a send and of a receive call on the ICS platform, run against the fake icsneo library so the
+ * numbers are the platform's own and not the tool's.
+ *
+ * usage: set CTRE_ICSNEO_LIBRARY_PATH to the fake library (see FakeIcsNeo.cpp), then run
+ *        CTRE_PhoenixPlatform_ics_bench [iterations]
+ */
+#include "ctre/phoenix/platform/Platform.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream> // std::cout
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const int kDefaultIterations = 1000000;
+	const uint32_t kReceiveCapacity = 64;
+
+	double NsPer(std::chrono::steady_clock::duration elapsed, int iterations)
+	{
+		return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int iterations = (argc > 1) ? std::atoi(argv[1]) : kDefaultIterations;
+	if (iterations <= 0) {
+		std::cout << "usage: " << argv[0] << " [iterations]" << std::endl;
+		return 2;
+	}
+
+	/* the first call opens the tool, keep it out of the timing */
+	uint8_t data[8] = {};
+	int32_t err = CANbus_SendFrame(1, data, 8);
+	if (err != 0) {
+		std::cout << "could not open the tool (" << err << "), is CTRE_ICSNEO_LIBRARY_PATH set?" << std::endl;
+		return 1;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		(void)CANbus_SendFrame(1, data, 8);
+	std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+
+	canframe_t frames[kReceiveCapacity];
+	uint32_t filled = 0;
+	uint64_t received = 0;
+	for (int i = 0; i < iterations; ++i) {
+		(void)CANbus_ReceiveFrame(frames, kReceiveCapacity, &filled);
+		received += filled;
+	}
+	std::chrono::steady_clock::time_point done = std::chrono::steady_clock::now();
+
+	DisposePlatform();
+
+	std::cout << "send    " << NsPer(sent - start, iterations) << " ns/frame" << std::endl;
+	std::cout << "receive " << NsPer(done - sent, iterations) << " ns/call, " << received << " frames" << std::endl;
+	return 0;
+}
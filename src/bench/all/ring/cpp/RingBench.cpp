@@ -0,0 +1,224 @@
+/**
+ * Throughput and latency of the rings in RingBuffer.h, moving the same frames the platforms move.
+ *
+ * usage: CTRE_PhoenixPlatform_ring_bench [items]
+ * Exits non-zero if a ring hands a producer's frames out of order, or a broadcast reader sees them out of order.
+ */
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream> // std::cout
+#include <thread>
+#include <vector>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const uint32_t kDefaultItems = 10000000;
+	const uint32_t kCapacity = 4096;
+	const uint32_t kBulk = 32;
+	const uint32_t kProducers = 4;
+	const uint32_t kRoundTrips = 200000;
+
+	typedef std::chrono::steady_clock Clock;
+
+	double Seconds(Clock::duration elapsed)
+	{
+		return std::chrono::duration<double>(elapsed).count();
+	}
+
+	/* one thread pushes then pops, the cost of the ring itself with no cache line moving between cores */
+	template <typename Ring>
+	void SameThread(const char * name, uint32_t items, bool bulk)
+	{
+		static Ring ring;
+		canframe_ex_t frames[kBulk] = {};
+		Clock::time_point start = Clock::now();
+		for (uint32_t i = 0; i < items; i += kBulk) {
+			if (bulk) {
+				(void)ring.PushBulk(frames, kBulk);
+				(void)ring.PopBulk(frames, kBulk);
+			}
+			else {
+				for (uint32_t k = 0; k < kBulk; ++k)
+					(void)ring.Push(frames[k]);
+				for (uint32_t k = 0; k < kBulk; ++k)
+					(void)ring.Pop(frames[k]);
+			}
+		}
+		double ns = Seconds(Clock::now() - start) * 1e9 / items;
+		std::cout << name << (bulk ? " bulk  " : " single") << " push+pop " << ns << " ns/item" << std::endl;
+	}
+
+	/* producers on their own threads, arbID carries a per-producer sequence so order can be checked */
+	template <typename Ring>
+	bool AcrossThreads(const char * name, uint32_t producers, uint32_t items)
+	{
+		static Ring ring;
+		uint32_t perProducer = items / producers;
+
+		Clock::time_point start = Clock::now();
+		std::vector<std::thread> threads;
+		for (uint32_t p = 0; p < producers; ++p) {
+			threads.emplace_back([p, perProducer] {
+				canframe_ex_t frame = {};
+				frame.bus = static_cast<uint8_t>(p);
+				for (uint32_t i = 0; i < perProducer;) {
+					frame.arbID = i;
+					if (ring.Push(frame))
+						++i;
+					else
+						std::this_thread::yield();
+				}
+			});
+		}
+
+		std::vector<uint32_t> next(producers, 0);
+		uint64_t received = 0;
+		uint64_t outOfOrder = 0;
+		canframe_ex_t frames[kBulk];
+		while (received < static_cast<uint64_t>(perProducer) * producers) {
+			uint32_t count = ring.PopBulk(frames, kBulk);
+			if (count == 0)
+				std::this_thread::yield();
+			for (uint32_t k = 0; k < count; ++k) {
+				uint32_t & expect = next[frames[k].bus];
+				if (frames[k].arbID != expect) { ++outOfOrder; }
+				expect = frames[k].arbID + 1;
+			}
+			received += count;
+		}
+		for (std::thread & thread : threads)
+			thread.join();
+
+		double rate = static_cast<double>(received) / Seconds(Clock::now() - start) / 1e6;
+		std::cout << name << " " << producers << " producer(s) " << rate << " Mframes/s";
+		if (outOfOrder > 0)
+			std::cout << ", " << outOfOrder << " OUT OF ORDER";
+		std::cout << std::endl;
+		return outOfOrder == 0;
+	}
+
+	/*
+	 * one writer, every reader sees every item it keeps up with. The writer never waits, so a reader
+	 * that falls a ring behind loses items, which is reported rather than treated as a failure.
+	 */
+	bool Broadcast(uint32_t readers, uint32_t items)
+	{
+		static BroadcastRing<canframe_ex_t, kCapacity> ring;
+
+		std::vector<uint64_t> received(readers, 0);
+		std::vector<uint64_t> lost(readers, 0);
+		std::atomic<uint64_t> outOfOrder{ 0 };
+		std::vector<std::thread> threads;
+		/* subscribe before the writer starts so every reader starts from the first item */
+		std::vector<BroadcastRing<canframe_ex_t, kCapacity>::Reader> positions(readers, ring.Subscribe());
+
+		Clock::time_point start = Clock::now();
+		for (uint32_t r = 0; r < readers; ++r) {
+			threads.emplace_back([r, items, &positions, &received, &lost, &outOfOrder] {
+				canframe_ex_t frames[kBulk];
+				uint64_t next = 0;
+				while (next < items) {
+					uint32_t count = ring.PopBulk(positions[r], frames, kBulk);
+					if (count == 0)
+						std::this_thread::yield();
+					for (uint32_t k = 0; k < count; ++k) {
+						if (frames[k].arbID < next) { ++outOfOrder; }
+						next = frames[k].arbID + 1ULL;
+					}
+					received[r] += count;
+				}
+				lost[r] = positions[r].Stats().dropped;
+			});
+		}
+
+		canframe_ex_t frames[kBulk] = {};
+		for (uint32_t i = 0; i < items; i += kBulk) {
+			for (uint32_t k = 0; k < kBulk; ++k)
+				frames[k].arbID = i + k;
+			ring.PushBulk(frames, (items - i < kBulk) ? items - i : kBulk);
+		}
+		for (std::thread & thread : threads)
+			thread.join();
+
+		double seconds = Seconds(Clock::now() - start);
+		uint64_t total = 0;
+		uint64_t totalLost = 0;
+		for (uint32_t r = 0; r < readers; ++r) {
+			total += received[r];
+			totalLost += lost[r];
+		}
+		std::cout << "broadcast " << readers << " reader(s) " << static_cast<double>(items) / seconds / 1e6 << " Mframes/s written, "
+			<< static_cast<double>(total) / seconds / 1e6 << " Mframes/s read, " << totalLost << " lost to lapping";
+		if (outOfOrder > 0)
+			std::cout << ", " << outOfOrder << " OUT OF ORDER";
+		std::cout << std::endl;
+		return outOfOrder == 0;
+	}
+
+	/*
+	 * ping-pong over a pair of rings, half a round trip is the time from push to the other thread's pop.
+	 * Waiting sides yield like the platforms' threads do, so on one core this measures a context switch.
+	 */
+	void Latency(uint32_t roundTrips)
+	{
+		static SpscRing<canframe_ex_t, kCapacity> ping;
+		static SpscRing<canframe_ex_t, kCapacity> pong;
+
+		std::thread echo([roundTrips] {
+			canframe_ex_t frame;
+			for (uint32_t i = 0; i < roundTrips; ++i) {
+				while (ping.Pop(frame) == false) { std::this_thread::yield(); }
+				while (pong.Push(frame) == false) { std::this_thread::yield(); }
+			}
+		});
+
+		std::vector<double> halfTripNs(roundTrips);
+		canframe_ex_t frame = {};
+		for (uint32_t i = 0; i < roundTrips; ++i) {
+			Clock::time_point sent = Clock::now();
+			while (ping.Push(frame) == false) { std::this_thread::yield(); }
+			while (pong.Pop(frame) == false) { std::this_thread::yield(); }
+			halfTripNs[i] = Seconds(Clock::now() - sent) * 1e9 / 2;
+		}
+		echo.join();
+
+		std::sort(halfTripNs.begin(), halfTripNs.end());
+		std::cout << "spsc latency median " << halfTripNs[roundTrips / 2] << " ns, 99% " << halfTripNs[roundTrips * 99 / 100]
+			<< " ns, max " << halfTripNs[roundTrips - 1] << " ns" << std::endl;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	uint32_t items = kDefaultItems;
+	if (argc > 1) {
+		long value = std::atol(argv[1]);
+		if (value < static_cast<long>(kBulk * kProducers)) {
+			std::cout << "usage: " << argv[0] << " [items, at least " << kBulk * kProducers << "]" << std::endl;
+			return 2;
+		}
+		items = static_cast<uint32_t>(value);
+	}
+
+	SameThread<SpscRing<canframe_ex_t, kCapacity>>("spsc", items, false);
+	SameThread<SpscRing<canframe_ex_t, kCapacity>>("spsc", items, true);
+	SameThread<MpscRing<canframe_ex_t, kCapacity>>("mpsc", items, false);
+	SameThread<MpscRing<canframe_ex_t, kCapacity>>("mpsc", items, true);
+
+	bool ok = true;
+	ok = AcrossThreads<SpscRing<canframe_ex_t, kCapacity>>("spsc", 1, items) && ok;
+	ok = AcrossThreads<MpscRing<canframe_ex_t, kCapacity>>("mpsc", 1, items) && ok;
+	ok = AcrossThreads<MpscRing<canframe_ex_t, kCapacity>>("mpsc", kProducers, items) && ok;
+	ok = Broadcast(1, items) && ok;
+	ok = Broadcast(kProducers, items) && ok;
+
+	Latency(kRoundTrips);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+/**
+ * C++20 coroutine layer over the platform receive API.
+ *
+ *   CANAsyncReceiver rx;
+ *   std::optional<canframe_ex_t> status = co_await rx.NextFrame(0x02041400, 0x1FFFFFFF, std::chrono::milliseconds(50));
+ *   std::vector<canframe_ex_t> batch = co_await rx.Frames(0x02041400, 0x1FFFFF00, 10, std::chrono::milliseconds(100));
+ *   co_await rx.Delay(std::chrono::milliseconds(5));
+ *
+ * The awaitables work inside any coroutine type the application already uses.
+ * The receiver subscribes to the bus, see CANbus_Subscribe, and its callback copies each frame into a
+ * queue of the receiver's own, so it never takes frames from CANbus_ReceiveFrame or from another receiver.
+ * There is no thread per waiter. The thread that owns the receiver drives every waiter, either by
+ * calling RunOnce in a loop, or by calling Poll whenever EventHandle is ready or NextDeadline passes
+ * in its own epoll / select loop. Waiters are resumed from inside Poll on that thread, and the receiver
+ * and its awaitables must only be used from that thread.
+ * Every waiter whose arbID/mask matches gets its own copy of a frame, frames nobody waits for are dropped.
+ *
+ * Timeouts and delays run on CANbus_GetTimeNs, the clock frame times are on, so under simulation
+ * they follow the sim clock.
+ *
+ * Header only, and empty unless the compiler has coroutines, so the platform itself stays C++14.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+#include "ctre/phoenix/platform/RxEvent.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <poll.h>
+#endif
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+			namespace can {
+
+				class CANAsyncReceiver
+				{
+				public:
+					using Duration = std::chrono::nanoseconds;
+					/** same as CANbus_Subscribe, bind ICSSubscribe to a bus to wait on another one */
+					using SubscribeFunc = std::function<int32_t(uint32_t, uint32_t, canframe_callback_t, void *, uint32_t *)>;
+					/** same as CANbus_Unsubscribe, bound to the same bus as the SubscribeFunc */
+					using UnsubscribeFunc = std::function<int32_t(uint32_t)>;
+
+					/** NextDeadline when no waiter can time out */
+					static const uint64_t kNever = UINT64_MAX;
+
+					/** Something a coroutine is suspended on, see NextFrame, Frames and Delay */
+					class Waiter
+					{
+					public:
+						~Waiter()
+						{
+							/* the coroutine was destroyed while suspended */
+							if (_receiver != nullptr)
+								_receiver->Remove(this);
+						}
+
+						bool await_ready() const noexcept { return false; }
+						void await_suspend(std::coroutine_handle<> handle)
+						{
+							_handle = handle;
+							_receiver->Add(this);
+						}
+
+					protected:
+						Waiter(CANAsyncReceiver & receiver, uint32_t arbID, uint32_t mask, size_t count, Duration timeout) :
+							_receiver(&receiver), _arbID(arbID & mask), _mask(mask), _count(count), _timeout(timeout)
+						{
+						}
+
+						std::vector<canframe_ex_t> _frames;
+
+					private:
+						Waiter(const Waiter &) = delete;
+						Waiter & operator=(const Waiter &) = delete;
+
+						friend class CANAsyncReceiver;
+
+						bool Wants(const canframe_ex_t & frame) const
+						{
+							return _frames.size() < _count && (frame.arbID & _mask) == _arbID;
+						}
+						bool IsDone(uint64_t nowNs) const
+						{
+							return (_count > 0 && _frames.size() >= _count) || nowNs >= _deadlineNs;
+						}
+
+						CANAsyncReceiver * _receiver;	//!< null once it is neither waiting nor about to be resumed
+						uint32_t _arbID;
+						uint32_t _mask;
+						size_t _count;	//!< frames wanted, 0 to only wait out the timeout
+						Duration _timeout;
+						uint64_t _deadlineNs = kNever;	//!< on the CANbus_GetTimeNs clock
+						std::coroutine_handle<> _handle;
+					};
+
+					/** co_await gives the frame, or nullopt on timeout */
+					class FrameAwaiter : public Waiter
+					{
+					public:
+						FrameAwaiter(CANAsyncReceiver & receiver, uint32_t arbID, uint32_t mask, Duration timeout) :
+							Waiter(receiver, arbID, mask, 1, timeout)
+						{
+						}
+						std::optional<canframe_ex_t> await_resume()
+						{
+							if (_frames.empty())
+								return std::nullopt;
+							return _frames.front();
+						}
+					};
+
+					/** co_await gives the frames, fewer than asked for on timeout */
+					class BatchAwaiter : public Waiter
+					{
+					public:
+						BatchAwaiter(CANAsyncReceiver & receiver, uint32_t arbID, uint32_t mask, size_t count, Duration timeout) :
+							Waiter(receiver, arbID, mask, count, timeout)
+						{
+						}
+						std::vector<canframe_ex_t> await_resume() { return std::move(_frames); }
+					};
+
+					/** co_await resumes once the time has passed */
+					class DelayAwaiter : public Waiter
+					{
+					public:
+						DelayAwaiter(CANAsyncReceiver & receiver, Duration delay) :
+							Waiter(receiver, 0, 0, 0, delay)
+						{
+						}
+						void await_resume() {}
+					};
+
+					/** wait on the CANbus_* bus, for frames whose arbID matches under mask, every frame by default */
+					explicit CANAsyncReceiver(uint32_t arbID = 0, uint32_t mask = 0) :
+						CANAsyncReceiver(CANbus_Subscribe, CANbus_Unsubscribe, arbID, mask)
+					{
+					}
+
+					CANAsyncReceiver(SubscribeFunc subscribe, UnsubscribeFunc unsubscribe, uint32_t arbID = 0, uint32_t mask = 0) :
+						_unsubscribe(std::move(unsubscribe))
+					{
+						/* open the event first so the first frame already signals it */
+						_hasEvent = _queued.Open(_event);
+						_status = subscribe(arbID, mask, &CANAsyncReceiver::OnFrame, this, &_handle);
+					}
+
+					~CANAsyncReceiver()
+					{
+						/* once this returns the callback is done with us */
+						if (_status == 0)
+							(void)_unsubscribe(_handle);
+						/* coroutines still waiting stay suspended forever */
+						for (Waiter * waiter : _waiters)
+							waiter->_receiver = nullptr;
+						for (Waiter * waiter : _ready)
+							waiter->_receiver = nullptr;
+					}
+
+					/** next frame whose arbID matches under mask, giving up after timeout */
+					FrameAwaiter NextFrame(uint32_t arbID, uint32_t mask, Duration timeout = Duration::max())
+					{
+						return FrameAwaiter(*this, arbID, mask, timeout);
+					}
+
+					/** the next count frames whose arbID matches under mask, or what arrived before timeout */
+					BatchAwaiter Frames(uint32_t arbID, uint32_t mask, size_t count, Duration timeout = Duration::max())
+					{
+						return BatchAwaiter(*this, arbID, mask, count, timeout);
+					}
+
+					DelayAwaiter Delay(Duration delay)
+					{
+						return DelayAwaiter(*this, delay);
+					}
+
+					/** @return 0 if the receiver is subscribed, else the subscribe error, and no frame will ever arrive */
+					int32_t Status() const { return _status; }
+
+					/** frames dropped because the receiver's queue was full, Poll more often if this grows */
+					uint64_t Dropped() const { return _queue.Stats().dropped; }
+
+					/**
+					 * Handle that is ready when frames are waiting in the receiver's queue, see CANbus_GetRxEvent.
+					 * @return false if it could not be created, call Poll at least every millisecond instead
+					 */
+					bool EventHandle(intptr_t & handle) const
+					{
+						handle = _event;
+						return _hasEvent;
+					}
+
+					/** earliest time a waiter times out on the CANbus_GetTimeNs clock, kNever if none can */
+					uint64_t NextDeadline() const
+					{
+						uint64_t deadlineNs = kNever;
+						for (const Waiter * waiter : _waiters)
+							deadlineNs = std::min(deadlineNs, waiter->_deadlineNs);
+						return deadlineNs;
+					}
+
+					/**
+					 * Receive everything waiting, hand it to the waiters, and resume the ones that
+					 * have all their frames or ran out of time.
+					 * Waiters that a resumed coroutine starts are left for the next call.
+					 *
+					 * @return number of coroutines resumed
+					 */
+					size_t Poll()
+					{
+						canframe_ex_t frames[kBatch];
+						uint32_t filled;
+						do {
+							filled = _queue.PopBulk(frames, kBatch);
+							if (filled < kBatch)
+								_queued.Clear([this] { return _queue.Empty(); });
+							for (uint32_t i = 0; i < filled; ++i) {
+								for (Waiter * waiter : _waiters) {
+									if (waiter->Wants(frames[i]))
+										waiter->_frames.push_back(frames[i]);
+								}
+							}
+						} while (filled == kBatch);
+
+						uint64_t nowNs = CANbus_GetTimeNs();
+						auto firstDone = std::stable_partition(_waiters.begin(), _waiters.end(),
+							[nowNs](const Waiter * waiter) { return waiter->IsDone(nowNs) == false; });
+						_ready.insert(_ready.end(), firstDone, _waiters.end());
+						_waiters.erase(firstDone, _waiters.end());
+
+						/* one at a time, a resumed coroutine may destroy one that is still in _ready */
+						size_t resumed = 0;
+						while (_ready.empty() == false) {
+							Waiter * waiter = _ready.front();
+							_ready.erase(_ready.begin());
+							waiter->_receiver = nullptr;
+							waiter->_handle.resume();
+							++resumed;
+						}
+						return resumed;
+					}
+
+					/**
+					 * Block until frames arrive, the earliest waiter times out or maxWait passes, then Poll.
+					 * @return number of coroutines resumed
+					 */
+					size_t RunOnce(Duration maxWait)
+					{
+						uint64_t nowNs = CANbus_GetTimeNs();
+						uint64_t deadlineNs = NextDeadline();
+						uint64_t waitNs = (deadlineNs <= nowNs) ? 0 : std::min(ToNs(maxWait), deadlineNs - nowNs);
+						if (_hasEvent == false && waitNs > kNsPerMs)
+							waitNs = kNsPerMs;
+
+						/* round up, waking a little late beats spinning until the deadline */
+						uint64_t waitMs = waitNs / kNsPerMs + ((waitNs % kNsPerMs) != 0 ? 1 : 0);
+						int timeoutMs = static_cast<int>(std::min<uint64_t>(waitMs, INT_MAX));
+
+						if (_hasEvent) {
+#if defined(_WIN32)
+							(void)WaitForSingleObject(reinterpret_cast<HANDLE>(_event), static_cast<DWORD>(timeoutMs));
+#else
+							struct pollfd pfd;
+							pfd.fd = static_cast<int>(_event);
+							pfd.events = POLLIN;
+							pfd.revents = 0;
+							(void)poll(&pfd, 1, timeoutMs);
+#endif
+						}
+						else if (timeoutMs > 0) {
+							std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+						}
+						return Poll();
+					}
+
+				private:
+					CANAsyncReceiver(const CANAsyncReceiver &) = delete;
+					CANAsyncReceiver & operator=(const CANAsyncReceiver &) = delete;
+
+					static const uint32_t kBatch = 64;
+					static const uint32_t kQueueCapacity = 1024;
+					static const uint64_t kNsPerMs = 1000000;
+
+					/* I/O thread, must not block, see CANbus_Subscribe */
+					static void OnFrame(const canframe_ex_t * frame, void * context)
+					{
+						CANAsyncReceiver * receiver = static_cast<CANAsyncReceiver *>(context);
+						/* a full queue drops the frame and counts it, the I/O thread never waits on us */
+						if (receiver->_queue.Push(*frame))
+							receiver->_queued.Signal();
+					}
+
+					static uint64_t ToNs(Duration duration)
+					{
+						return (duration.count() <= 0) ? 0 : static_cast<uint64_t>(duration.count());
+					}
+
+					void Add(Waiter * waiter)
+					{
+						uint64_t nowNs = CANbus_GetTimeNs();
+						uint64_t timeoutNs = ToNs(waiter->_timeout);
+						waiter->_deadlineNs = (timeoutNs >= kNever - nowNs) ? kNever : nowNs + timeoutNs;
+						_waiters.push_back(waiter);
+					}
+					void Remove(Waiter * waiter)
+					{
+						_waiters.erase(std::remove(_waiters.begin(), _waiters.end(), waiter), _waiters.end());
+						_ready.erase(std::remove(_ready.begin(), _ready.end(), waiter), _ready.end());
+					}
+
+					UnsubscribeFunc _unsubscribe;
+					int32_t _status = 0;
+					uint32_t _handle = 0;	//!< subscription, valid while _status is 0
+					/* a bus with several I/O threads may call back from any of them */
+					MpscRing<canframe_ex_t, kQueueCapacity> _queue;
+					RxEvent _queued;	//!< ready while _queue has frames
+					intptr_t _event = 0;
+					bool _hasEvent = false;
+					std::vector<Waiter *> _waiters;	//!< suspended, in the order they started waiting
+					std::vector<Waiter *> _ready;	//!< done, waiting their turn to be resumed by Poll
+				};
+
+			} // namespace can
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
+
+#endif
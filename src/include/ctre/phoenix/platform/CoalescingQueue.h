@@ -0,0 +1,198 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Latest-wins frame queue, see CANbus_SetRxCoalescing.
+ *
+ * Holds at most one frame per arbID. A frame whose arbID is already queued overwrites the queued
+ * frame in its place in line, found through an open-addressed index from arbID to position, so
+ * after a stall the backlog is one current frame per arbID rather than every stale one.
+ * Frames with different arbIDs stay in arrival order.
+ *
+ * One producer and one consumer, behind a lock held only for the copies.
+ * Nothing allocates after construction.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			template <uint32_t Capacity>
+			class CoalescingQueue
+			{
+				static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+				static const uint32_t kMask = Capacity - 1;
+				/* never more than half full, so probes stay short and there is always a free entry */
+				static const uint32_t kIndexSize = Capacity * 2;
+				static const uint32_t kIndexMask = kIndexSize - 1;
+				static const uint32_t kNone = 0xFFFFFFFF;
+
+			public:
+				CoalescingQueue() = default;
+
+				/** @return number of frames queued or merged into a queued frame, the rest were dropped */
+				uint32_t PushBulk(const can::canframe_ex_t * frames, uint32_t count)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					uint32_t pushed = 0;
+					for (uint32_t i = 0; i < count; ++i) {
+						if (PushLocked(frames[i]))
+							++pushed;
+					}
+					return pushed;
+				}
+
+				/** @return number of frames filled, oldest position first */
+				uint32_t PopBulk(can::canframe_ex_t * toFill, uint32_t capacity)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					uint32_t filled = 0;
+					while (filled < capacity && _head != _tail) {
+						toFill[filled++] = _frames[_head & kMask];
+						PopLocked();
+					}
+					/* popping takes lent frames first, same as releasing them */
+					_leased = (filled < _leased) ? _leased - filled : 0;
+					return filled;
+				}
+
+				/**
+				 * Lend the oldest frames in place, see SpscRing::Lease.
+				 * Lent frames are never overwritten, a newer frame with the same arbID queues behind them.
+				 */
+				uint32_t Lease(RingSpans<can::canframe_ex_t> & spans, uint32_t maxCount)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					uint32_t size = _tail - _head;
+					uint32_t count = (size < maxCount) ? size : maxCount;
+					uint32_t start = _head & kMask;
+					uint32_t untilEnd = Capacity - start;
+					spans.first = &_frames[start];
+					spans.firstCount = (count < untilEnd) ? count : untilEnd;
+					spans.second = &_frames[0];
+					spans.secondCount = count - spans.firstCount;
+					_leased = count;
+					return count;
+				}
+
+				/** Hand back the first count frames of the last Lease */
+				void Release(uint32_t count)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					for (uint32_t i = 0; i < count && _head != _tail; ++i)
+						PopLocked();
+					_leased = 0;
+				}
+
+				/** Append every queued frame to frames, oldest position first, leaving them queued */
+				void CopyTo(std::vector<can::canframe_ex_t> & frames) const
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					for (uint32_t pos = _head; pos != _tail; ++pos)
+						frames.push_back(_frames[pos & kMask]);
+				}
+
+				bool Empty() const
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					return _head == _tail;
+				}
+
+				/** frames dropped because Capacity distinct arbIDs were already queued */
+				uint64_t Dropped() const
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					return _dropped;
+				}
+
+			private:
+				CoalescingQueue(const CoalescingQueue &) = delete;
+				CoalescingQueue & operator=(const CoalescingQueue &) = delete;
+
+				struct Entry {
+					uint32_t arbID;
+					uint32_t pos;	//!< position of the frame with this arbID that newer ones merge into
+					bool used;
+				};
+
+				static uint32_t Home(uint32_t arbID)
+				{
+					uint32_t h = arbID * 0x9E3779B1u;
+					return (h ^ (h >> 16)) & kIndexMask;
+				}
+
+				uint32_t Find(uint32_t arbID) const
+				{
+					for (uint32_t i = Home(arbID); _index[i].used; i = (i + 1) & kIndexMask) {
+						if (_index[i].arbID == arbID)
+							return i;
+					}
+					return kNone;
+				}
+
+				/* linear probing without tombstones, shift later entries of the run back into the hole */
+				void Erase(uint32_t hole)
+				{
+					for (uint32_t i = (hole + 1) & kIndexMask; _index[i].used; i = (i + 1) & kIndexMask) {
+						uint32_t fromHome = (i - Home(_index[i].arbID)) & kIndexMask;
+						uint32_t fromHole = (i - hole) & kIndexMask;
+						if (fromHome >= fromHole) {
+							_index[hole] = _index[i];
+							hole = i;
+						}
+					}
+					_index[hole].used = false;
+				}
+
+				bool PushLocked(const can::canframe_ex_t & frame)
+				{
+					uint32_t entry = Find(frame.arbID);
+					if (entry != kNone && _index[entry].pos - _head >= _leased) {
+						_frames[_index[entry].pos & kMask] = frame;
+						return true;
+					}
+					if (_tail - _head == Capacity) {
+						++_dropped;
+						return false;
+					}
+					if (entry == kNone) {
+						entry = Home(frame.arbID);
+						while (_index[entry].used)
+							entry = (entry + 1) & kIndexMask;
+						_index[entry].arbID = frame.arbID;
+						_index[entry].used = true;
+					}
+					/* new arbID, or the queued one is lent out, either way newer frames merge here now */
+					_index[entry].pos = _tail;
+					_frames[_tail & kMask] = frame;
+					++_tail;
+					return true;
+				}
+
+				void PopLocked()
+				{
+					uint32_t entry = Find(_frames[_head & kMask].arbID);
+					if (entry != kNone && _index[entry].pos == _head)
+						Erase(entry);
+					++_head;
+				}
+
+				mutable std::mutex _lck;
+				uint32_t _head = 0;	//!< position of the oldest frame, free running
+				uint32_t _tail = 0;	//!< position the next new frame goes to
+				uint32_t _leased = 0;	//!< frames from _head that are lent out and must not change
+				uint64_t _dropped = 0;
+				can::canframe_ex_t _frames[Capacity];
+				Entry _index[kIndexSize] = {};
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,149 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Time-ordered merge of frames from several receive queues, by canframe_ex_t::timeStampNs.
+ *
+ * Each source is a function that receives from one queue, such as one bus.
+ * Frames wait in a small staging ring per source, and a heap over the heads of those rings hands out
+ * the oldest frame once it is older than the reorder window. A frame that reaches its queue later than
+ * the window after its timestamp can still come out behind a newer one; those are counted as late.
+ * The window is the latency this adds, so it only has to cover how long a frame can take from the bus
+ * to its queue. If a source's staging ring fills, frames are let out early rather than stalling it.
+ *
+ * Not thread safe, receive from one thread.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			class FrameMerger
+			{
+			public:
+				/** receive into toFill, same as CANbus_ReceiveFrameEx @return number of frames filled */
+				typedef std::function<uint32_t(can::canframe_ex_t * toFill, uint32_t capacity)> Source;
+
+				static const uint64_t kDefaultWindowNs = 5000000;
+				static const uint32_t kStagingSize = 256;
+
+				explicit FrameMerger(uint64_t windowNs = kDefaultWindowNs) : _windowNs(windowNs) {}
+
+				/** @return the source's index */
+				uint32_t AddSource(Source source)
+				{
+					_sources.push_back(std::unique_ptr<Staging>(new Staging(std::move(source))));
+					return static_cast<uint32_t>(_sources.size() - 1);
+				}
+
+				void SetWindowNs(uint64_t windowNs) { _windowNs = windowNs; }
+				uint64_t GetWindowNs() const { return _windowNs; }
+
+				/** frames that came out behind a newer frame */
+				uint64_t GetLateCount() const { return _lateCount; }
+
+				/**
+				 * Pull what each source has and hand out frames in time order.
+				 *
+				 * @param toFill filled oldest first
+				 * @param capacity size of toFill
+				 * @param nowNs now on the timestamp clock, UINT64_MAX lets everything staged out
+				 * @return number of frames filled
+				 */
+				uint32_t Receive(can::canframe_ex_t * toFill, uint32_t capacity, uint64_t nowNs)
+				{
+					/* stage, and heap up the sources that have something */
+					_heap.clear();
+					uint32_t fullSources = 0;
+					for (uint32_t i = 0; i < _sources.size(); ++i) {
+						Staging & staging = *_sources[i];
+						staging.Refill();
+						if (staging.count > 0)
+							_heap.push_back(i);
+						if (staging.count == kStagingSize)
+							++fullSources;
+					}
+					auto later = [this](uint32_t a, uint32_t b) { return HeadNs(a) > HeadNs(b); };
+					std::make_heap(_heap.begin(), _heap.end(), later);
+
+					uint64_t releaseNs = (nowNs > _windowNs) ? nowNs - _windowNs : 0;
+
+					uint32_t filled = 0;
+					while (filled < capacity && _heap.empty() == false) {
+						uint32_t oldest = _heap.front();
+						Staging & staging = *_sources[oldest];
+						const can::canframe_ex_t & frame = staging.frames[staging.head];
+						if (frame.timeStampNs > releaseNs && fullSources == 0)
+							break;
+
+						if (frame.timeStampNs < _lastOutNs)
+							++_lateCount;
+						else
+							_lastOutNs = frame.timeStampNs;
+						toFill[filled++] = frame;
+
+						std::pop_heap(_heap.begin(), _heap.end(), later);
+						_heap.pop_back();
+						if (staging.count == kStagingSize)
+							--fullSources;
+						staging.head = (staging.head + 1) % kStagingSize;
+						--staging.count;
+						if (staging.count > 0) {
+							_heap.push_back(oldest);
+							std::push_heap(_heap.begin(), _heap.end(), later);
+						}
+					}
+					return filled;
+				}
+
+			private:
+				FrameMerger(const FrameMerger &) = delete;
+				FrameMerger & operator=(const FrameMerger &) = delete;
+
+				struct Staging {
+					explicit Staging(Source s) : source(std::move(s)) {}
+
+					/* fill the free space, which is at most two runs because it wraps */
+					void Refill()
+					{
+						while (count < kStagingSize) {
+							uint32_t tail = (head + count) % kStagingSize;
+							uint32_t free = kStagingSize - count;
+							uint32_t toEnd = kStagingSize - tail;
+							uint32_t room = (free < toEnd) ? free : toEnd;
+							uint32_t got = source(&frames[tail], room);
+							count += got;
+							if (got < room)
+								break;
+						}
+					}
+
+					Source source;
+					can::canframe_ex_t frames[kStagingSize];
+					uint32_t head = 0;
+					uint32_t count = 0;
+				};
+
+				uint64_t HeadNs(uint32_t source) const
+				{
+					const Staging & staging = *_sources[source];
+					return staging.frames[staging.head].timeStampNs;
+				}
+
+				std::vector<std::unique_ptr<Staging>> _sources;
+				std::vector<uint32_t> _heap;	//!< sources with staged frames, oldest head on top
+				uint64_t _windowNs;
+				uint64_t _lastOutNs = 0;
+				uint64_t _lateCount = 0;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
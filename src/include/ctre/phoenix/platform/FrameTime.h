@@ -0,0 +1,207 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+/**
+ * Receive timestamps for the platforms, see canframe_ex_t.
+ *
+ * Every hardware platform stamps frames on the steady clock in nanoseconds.
+ * ClockMapper carries a device's own clock onto it.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** the platform clock, see CANbus_GetTimeNs */
+			inline uint64_t SteadyNowNs()
+			{
+				return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+
+			/** narrow an extended frame for CANbus_ReceiveFrame, whose timeStampUs is the same clock in wrapping microseconds */
+			inline void ToCanframe(const can::canframe_ex_t & from, can::canframe_t & to)
+			{
+				to.arbID = from.arbID;
+				to.timeStampUs = static_cast<uint32_t>(from.timeStampNs / 1000);
+				for (int i = 0; i < 8; ++i)
+					to.data[i] = from.data[i];
+				to.dlc = from.dlc;
+				to.flags = from.flags;
+			}
+
+			/**
+			 * Receive from a ring of extended frames into canframe_t, converting in place through a lease
+			 * so there is no second copy. Leases until full or empty, a queue may lend a class at a time.
+			 * @return number of frames filled
+			 */
+			template <typename Ring>
+			uint32_t ReceiveAsCanframes(Ring & ring, can::canframe_t * toFillArray, uint32_t capacity)
+			{
+				uint32_t filled = 0;
+				while (filled < capacity) {
+					RingSpans<can::canframe_ex_t> spans;
+					uint32_t count = ring.Lease(spans, capacity - filled);
+					if (count == 0)
+						break;
+					for (uint32_t i = 0; i < spans.firstCount; ++i)
+						ToCanframe(spans.first[i], toFillArray[filled + i]);
+					for (uint32_t i = 0; i < spans.secondCount; ++i)
+						ToCanframe(spans.second[i], toFillArray[filled + spans.firstCount + i]);
+					ring.Release(count);
+					filled += count;
+				}
+				return filled;
+			}
+
+			/**
+			 * Maps a device clock onto the host clock, following drift between the two.
+			 *
+			 * Each frame gives one sample of (host time the frame was read - device time), which is the offset
+			 * between the clocks plus however long it took to read the frame. The smallest sample in each window
+			 * is the best estimate of the offset at that moment, so those minimums are the points of a
+			 * least-squares line of offset against device time over the last kPoints windows.
+			 * The slope of the line is the drift. A sample below the line wins over it, so the mapped time
+			 * is never later than the host read time.
+			 * A jump larger than kJumpNs, such as the device clock restarting, drops the history.
+			 *
+			 * Not thread safe, use one per device from its receive thread.
+			 */
+			class ClockMapper
+			{
+			public:
+				static const int64_t kWindowNs = 250000000;
+				static const int kPoints = 16;
+				static const int64_t kJumpNs = 100000000;
+
+				/** forget everything, for when the device is reopened */
+				void Reset()
+				{
+					_valid = false;
+					_count = 0;
+					_next = 0;
+					_windowEndNs = 0;
+				}
+
+				/**
+				 * @param deviceNs    device time of the frame
+				 * @param hostNowNs   host time when the frame was read from the device
+				 * @return device time on the host clock, never later than hostNowNs
+				 */
+				int64_t ToHostNs(int64_t deviceNs, int64_t hostNowNs)
+				{
+					int64_t sampleNs = hostNowNs - deviceNs;
+
+					/* device clock went backwards, the history describes another clock */
+					if (_valid && deviceNs + kJumpNs < _lastDeviceNs)
+						Reset();
+
+					if (_valid == false) {
+						_valid = true;
+						StartWindow(hostNowNs);
+					}
+					_lastDeviceNs = deviceNs;
+
+					if (sampleNs < _windowMinNs) {
+						_windowMinNs = sampleNs;
+						_windowMinDeviceNs = deviceNs;
+					}
+					if (hostNowNs >= _windowEndNs) {
+						AddPoint(_windowMinDeviceNs, _windowMinNs);
+						StartWindow(hostNowNs);
+					}
+
+					int64_t offsetNs = (_count == 0) ? _windowMinNs : OffsetAt(deviceNs);
+					if (sampleNs < offsetNs)
+						offsetNs = sampleNs;
+					return deviceNs + offsetNs;
+				}
+
+				/** estimated drift of the host clock against the device clock, in parts per million */
+				double DriftPpm() const { return _slope * 1e6; }
+
+			private:
+				void StartWindow(int64_t hostNowNs)
+				{
+					_windowMinNs = std::numeric_limits<int64_t>::max();
+					_windowEndNs = hostNowNs + kWindowNs;
+				}
+
+				void AddPoint(int64_t deviceNs, int64_t offsetNs)
+				{
+					/* a window minimum far off the line is a clock step, start the line again from here */
+					if (_count > 0) {
+						int64_t error = offsetNs - OffsetAt(deviceNs);
+						if (error > kJumpNs || error < -kJumpNs)
+							_count = 0;
+					}
+
+					_pointDeviceNs[_next] = deviceNs;
+					_pointOffsetNs[_next] = offsetNs;
+					_next = (_next + 1) % kPoints;
+					if (_count < kPoints)
+						++_count;
+					Fit();
+				}
+
+				/* least squares over the points, relative to the newest to keep the doubles small */
+				void Fit()
+				{
+					int newest = (_next + kPoints - 1) % kPoints;
+					_refDeviceNs = _pointDeviceNs[newest];
+					_refOffsetNs = _pointOffsetNs[newest];
+
+					double meanX = 0, meanY = 0;
+					for (int i = 0; i < _count; ++i) {
+						int p = (newest + kPoints - i) % kPoints;
+						meanX += static_cast<double>(_pointDeviceNs[p] - _refDeviceNs);
+						meanY += static_cast<double>(_pointOffsetNs[p] - _refOffsetNs);
+					}
+					meanX /= _count;
+					meanY /= _count;
+
+					double sxx = 0, sxy = 0;
+					for (int i = 0; i < _count; ++i) {
+						int p = (newest + kPoints - i) % kPoints;
+						double dx = static_cast<double>(_pointDeviceNs[p] - _refDeviceNs) - meanX;
+						double dy = static_cast<double>(_pointOffsetNs[p] - _refOffsetNs) - meanY;
+						sxx += dx * dx;
+						sxy += dx * dy;
+					}
+					_slope = (sxx > 0) ? sxy / sxx : 0;
+					_intercept = meanY - _slope * meanX;
+				}
+
+				int64_t OffsetAt(int64_t deviceNs) const
+				{
+					double x = static_cast<double>(deviceNs - _refDeviceNs);
+					return _refOffsetNs + static_cast<int64_t>(_intercept + _slope * x);
+				}
+
+				bool _valid = false;
+				int64_t _lastDeviceNs = 0;
+
+				int64_t _windowEndNs = 0;
+				int64_t _windowMinNs = std::numeric_limits<int64_t>::max();
+				int64_t _windowMinDeviceNs = 0;
+
+				int64_t _pointDeviceNs[kPoints] = {};
+				int64_t _pointOffsetNs[kPoints] = {};
+				int _count = 0;
+				int _next = 0;
+
+				int64_t _refDeviceNs = 0;
+				int64_t _refOffsetNs = 0;
+				double _slope = 0;
+				double _intercept = 0;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+
+#include <cstdint>
+
+/**
+ * Optional extensions to the platform CAN API.
+ * Every platform exports these; one that can't support a call returns FeatureNotSupported.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+			namespace can {
+
+				/**
+				 * Received frame with a full receive time, see CANbus_ReceiveFrameEx.
+				 * canframe_t::timeStampUs is the same time, in microseconds truncated to 32 bits, so it wraps every 71 minutes.
+				 */
+				struct canframe_ex_t {
+					uint64_t timeStampNs;	//!< when the frame came off the bus, on the CANbus_GetTimeNs clock
+					uint32_t arbID;
+					uint8_t data[8];
+					uint8_t dlc;
+					uint8_t flags;
+					uint8_t bus;	//!< bus the frame was received on, 0 on platforms with one bus
+					uint8_t reserved;
+				};
+
+				/**
+				 * The clock receive times are on: the monotonic steady clock (CLOCK_MONOTONIC on Linux,
+				 * QueryPerformanceCounter on Windows) in nanoseconds, or the sim clock under simulation.
+				 * Never steps with wall-clock changes, so times can be compared across buses and against the host.
+				 *
+				 * @return now on that clock
+				 */
+				uint64_t CANbus_GetTimeNs();
+
+				/**
+				 * Same as CANbus_ReceiveFrame, with 64-bit nanosecond receive times.
+				 * Both draw from the same queue.
+				 *
+				 * @return 0 on success
+				 */
+				int32_t CANbus_ReceiveFrameEx(canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+				/** Frames lent by CANbus_LeaseFrames, frames that wrap past the end of the platform's ring are in second */
+				struct canframe_lease_t {
+					const canframe_ex_t * first;
+					uint32_t firstCount;
+					const canframe_ex_t * second;
+					uint32_t secondCount;
+				};
+
+				/**
+				 * Receive without copying: lend the caller the oldest received frames where the platform already holds them.
+				 * The frames stay valid, and are not received again, until they are released with CANbus_ReleaseFrames.
+				 * Leasing again before releasing lends the same frames first.
+				 * Only one thread may receive at a time, by leasing or with CANbus_ReceiveFrame.
+				 *
+				 * @param lease set to the lent frames, both counts 0 if nothing is waiting
+				 * @param maxFrames most frames to lend
+				 * @return 0 on success, FeatureNotSupported if the platform has no receive ring
+				 */
+				int32_t CANbus_LeaseFrames(canframe_lease_t * lease, uint32_t maxFrames);
+
+				/**
+				 * Hand back leased frames once they have been processed.
+				 *
+				 * @param count frames to release from the start of the last lease, at most the number it lent
+				 * @return 0 on success, FeatureNotSupported if the platform has no receive ring
+				 */
+				int32_t CANbus_ReleaseFrames(uint32_t count);
+
+				/**
+				 * Get a handle that becomes ready when received frames are waiting, so CAN can share
+				 * an epoll / select / WaitForMultipleObjects loop with other sources instead of being polled.
+				 * It is a file descriptor that polls readable on Linux and macOS, and an event HANDLE on Windows.
+				 *
+				 * A burst of frames makes it ready once. It stays ready until a receive call finds
+				 * nothing left, so after a wake-up receive until CANbus_ReceiveFrame fills nothing
+				 * (or CANbus_LeaseFrames lends nothing). Never read from, reset or close the handle,
+				 * it belongs to the platform.
+				 *
+				 * @param handle set to the file descriptor or HANDLE, cast to intptr_t
+				 * @return 0 on success, InvalidParamValue if handle is null, ResourceNotAvailable if the handle could not be created
+				 */
+				int32_t CANbus_GetRxEvent(intptr_t * handle);
+
+				/** Called with each received frame that matches a subscription, see CANbus_Subscribe */
+				typedef void (*canframe_callback_t)(const canframe_ex_t * frame, void * context);
+
+				/**
+				 * Have the platform's I/O thread call back as soon as a frame matching arbID under mask arrives,
+				 * before it is queued for CANbus_ReceiveFrame. Frames are still queued as usual.
+				 *
+				 * The callback runs inline on the I/O thread, so it holds up every frame behind it.
+				 * It must not block, must not call into the platform, and should do no more than
+				 * hand the frame to a queue or set a flag. Several subscriptions may match one frame;
+				 * their order is only fixed among subscriptions with the same mask and arbID.
+				 *
+				 * @param arbID arbitration ID to match, only the bits set in mask are compared
+				 * @param mask bits of arbID that must match, 0 to match every frame
+				 * @param callback called with the frame and context
+				 * @param context passed through to callback
+				 * @param handle set to the handle to pass to CANbus_Unsubscribe
+				 * @return 0 on success, InvalidParamValue if callback or handle is null
+				 */
+				int32_t CANbus_Subscribe(uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle);
+
+				/**
+				 * Remove a subscription. Once this returns its callback is not running and is never called again,
+				 * so its context can be freed. Must not be called from inside a callback.
+				 *
+				 * @param handle from CANbus_Subscribe
+				 * @return 0 on success, InvalidParamValue if there is no such subscription
+				 */
+				int32_t CANbus_Unsubscribe(uint32_t handle);
+
+				/** Number of receive priority classes, see CANbus_SetRxClasses */
+				static const uint32_t kRxClassCount = 4;
+
+				/**
+				 * Puts received frames into a priority class, see CANbus_SetRxClasses.
+				 * A frame matches when arbID & mask lies within firstArbID..lastArbID, so a mask match
+				 * has firstArbID == lastArbID, and a plain range has mask 0x1FFFFFFF.
+				 */
+				struct canframe_class_rule_t {
+					uint32_t firstArbID;
+					uint32_t lastArbID;
+					uint32_t mask;
+					uint32_t rxClass;	//!< 0 is the most urgent, below kRxClassCount
+				};
+
+				/**
+				 * Give urgent frames their own receive queue so bulk traffic can't hold them up.
+				 *
+				 * Each frame goes to the class of the first rule it matches, or to defaultClass, and each class
+				 * is queued separately. CANbus_ReceiveFrame, CANbus_ReceiveFrameEx and CANbus_LeaseFrames drain
+				 * class 0 first, so frames of different classes no longer come out in receive order; within a
+				 * class they still do. Until this is called every frame is in class 0.
+				 * Replaces the rules set before, frames already queued stay in their class.
+				 *
+				 * @param rules checked in order, may be null if count is 0
+				 * @param count number of rules
+				 * @param defaultClass class of frames no rule matches
+				 * @return 0 on success, InvalidParamValue if a class is not below kRxClassCount,
+				 *         FeatureNotSupported if the platform has a single receive queue
+				 */
+				int32_t CANbus_SetRxClasses(const canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass);
+
+				/**
+				 * Same as CANbus_ReceiveFrameEx, from one class only.
+				 * The rx event stays ready while another class still holds frames.
+				 *
+				 * @return 0 on success, InvalidParamValue if rxClass is not below kRxClassCount,
+				 *         FeatureNotSupported if the platform has a single receive queue
+				 */
+				int32_t CANbus_ReceiveClassEx(uint32_t rxClass, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+				/**
+				 * Make a receive class keep only the latest frame per arbID, for periodic status frames where
+				 * only the current value matters. A frame whose arbID is already queued in the class replaces
+				 * the queued one in its place in line, so a consumer that fell behind finds one current frame
+				 * per arbID instead of a backlog of stale ones. Frames that must all be seen, such as replies
+				 * and streams, belong in a class left in the default FIFO mode, see CANbus_SetRxClasses.
+				 * Every frame is in class 0 until classes are set, so coalescing class 0 then covers everything.
+				 *
+				 * A frame already lent by CANbus_LeaseFrames is never replaced, a newer one queues behind it.
+				 * Frames queued before the mode changed are received first.
+				 *
+				 * @param rxClass class to change
+				 * @param latestOnly true for latest-wins, false for FIFO
+				 * @return 0 on success, InvalidParamValue if rxClass is not below kRxClassCount,
+				 *         FeatureNotSupported if the platform has a single receive queue
+				 */
+				int32_t CANbus_SetRxCoalescing(uint32_t rxClass, bool latestOnly);
+
+			} // namespace can
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,446 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * Fixed-capacity lock-free rings for passing frames between threads.
+ *
+ * SpscRing    one producer thread, one consumer thread
+ * MpscRing    any number of producer threads, one consumer thread
+ * BroadcastRing one writer, any number of readers that each see every item
+ *
+ * All of them are header-only, hold their items inline and contain no pointers,
+ * so they can be placed in memory shared between processes.
+ * Capacity must be a power of two.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** What a push does when the ring is full */
+			enum class RingOverflow {
+				DropNewest,	//!< refuse the new item
+				DropOldest,	//!< discard the oldest queued item to make room
+				Block,	//!< yield until the consumer makes room
+			};
+
+			/**
+			 * Items lent out by a ring, see Lease.
+			 * Items that wrap past the end of the ring's storage are in second.
+			 */
+			template <typename T>
+			struct RingSpans {
+				T * first;
+				uint32_t firstCount;
+				T * second;
+				uint32_t secondCount;
+			};
+
+			/** Counters since the ring was created */
+			struct RingStats {
+				uint64_t pushed;	//!< items accepted
+				uint64_t popped;	//!< items handed to a consumer
+				uint64_t dropped;	//!< items refused or discarded because the ring was full
+				uint32_t highWater;	//!< most items queued at once, sampled once per push call
+			};
+
+			namespace detail {
+
+				static const size_t kRingCacheLine = 64;
+
+				/* single writers publish with a plain store, shared counters need a read-modify-write */
+				template <bool Shared>
+				inline void RingCount(std::atomic<uint64_t> & counter, uint64_t n)
+				{
+					if (Shared)
+						counter.fetch_add(n, std::memory_order_relaxed);
+					else
+						counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+				}
+
+				/**
+				 * Bounded queue with a sequence number per slot, after Dmitry Vyukov's MPMC queue.
+				 *
+				 * The slot for position p is free for a producer when its sequence is p,
+				 * and holds an item for a consumer when its sequence is p + 1.
+				 * Each side only ever writes its own index and the slots, so a single producer or a single
+				 * consumer moves its index with a plain store, and only shared sides pay for a CAS.
+				 * DropOldest makes producers discard through the consumer side, which is then shared.
+				 */
+				template <typename T, uint32_t Capacity, bool MultiProducer, bool MultiConsumer, RingOverflow Overflow>
+				class RingCore
+				{
+					static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+					static const uint32_t kMask = Capacity - 1;
+					static const bool kSharedHead = MultiConsumer || Overflow == RingOverflow::DropOldest;
+
+				public:
+					RingCore()
+					{
+						for (uint32_t i = 0; i < Capacity; ++i)
+							_seqs[i].store(i, std::memory_order_relaxed);
+					}
+
+					/** @return false if the item was refused, only possible with DropNewest */
+					bool Push(const T & item)
+					{
+						return PushBulk(&item, 1) == 1;
+					}
+
+					/** @return number of items accepted, count unless DropNewest refused the rest */
+					uint32_t PushBulk(const T * items, uint32_t count)
+					{
+						uint32_t pushed = 0;
+						uint64_t dropped = 0;
+						while (pushed < count) {
+							if (TryPush(items[pushed])) {
+								++pushed;
+							}
+							else if (Overflow == RingOverflow::DropNewest) {
+								dropped = count - pushed;
+								break;
+							}
+							else if (Overflow == RingOverflow::DropOldest) {
+								T discarded;
+								if (TryPop(discarded))
+									++dropped;
+							}
+							else {
+								std::this_thread::yield();
+							}
+						}
+
+						RingCount<MultiProducer>(_producer.pushed, pushed);
+						if (dropped > 0)
+							_dropped.count.fetch_add(dropped, std::memory_order_relaxed);
+
+						/* one look at the consumer's index per call, not per item */
+						uint32_t size = Size();
+						if (size > _producer.highWater.load(std::memory_order_relaxed))
+							_producer.highWater.store(size, std::memory_order_relaxed);
+						return pushed;
+					}
+
+					/** @return false if the ring is empty */
+					bool Pop(T & item)
+					{
+						return PopBulk(&item, 1) == 1;
+					}
+
+					/** @return number of items copied into items, never waits */
+					uint32_t PopBulk(T * items, uint32_t capacity)
+					{
+						uint32_t popped = 0;
+						while (popped < capacity && TryPop(items[popped])) {
+							++popped;
+						}
+						if (popped > 0)
+							RingCount<MultiConsumer>(_consumer.popped, popped);
+						return popped;
+					}
+
+					/**
+					 * Lend the consumer the oldest queued items in place, without copying them.
+					 * They stay queued, and the producer can't reuse their slots, until Release.
+					 * Leasing again before releasing returns the same items first.
+					 * Only for a single consumer that producers never discard through (not DropOldest).
+					 *
+					 * @return number of items lent, firstCount + secondCount
+					 */
+					uint32_t Lease(RingSpans<T> & spans, uint32_t maxCount)
+					{
+						static_assert(kSharedHead == false, "Lease needs a single consumer and no DropOldest");
+
+						uint32_t head = _consumer.head.load(std::memory_order_relaxed);
+						uint32_t ready = 0;
+						while (ready < maxCount && ready < Capacity &&
+							_seqs[(head + ready) & kMask].load(std::memory_order_acquire) == head + ready + 1) {
+							++ready;
+						}
+
+						uint32_t start = head & kMask;
+						uint32_t untilEnd = Capacity - start;
+						spans.first = &_items[start];
+						spans.firstCount = (ready < untilEnd) ? ready : untilEnd;
+						spans.second = &_items[0];
+						spans.secondCount = ready - spans.firstCount;
+						return ready;
+					}
+
+					/** Hand back the first count items of the last Lease, at most the number it lent */
+					void Release(uint32_t count)
+					{
+						static_assert(kSharedHead == false, "Lease needs a single consumer and no DropOldest");
+
+						uint32_t head = _consumer.head.load(std::memory_order_relaxed);
+						for (uint32_t i = 0; i < count; ++i)
+							_seqs[(head + i) & kMask].store(head + i + Capacity, std::memory_order_release);
+						_consumer.head.store(head + count, std::memory_order_relaxed);
+						RingCount<MultiConsumer>(_consumer.popped, count);
+					}
+
+					/** @return items queued, exact only while neither side is running */
+					uint32_t Size() const
+					{
+						/* head first, so a concurrent pop can't make it look past the tail */
+						uint32_t head = _consumer.head.load(std::memory_order_acquire);
+						uint32_t size = _producer.tail.load(std::memory_order_acquire) - head;
+						return (size > Capacity) ? Capacity : size;
+					}
+					bool Empty() const { return Size() == 0; }
+					bool Full() const { return Size() >= Capacity; }
+
+					RingStats Stats() const
+					{
+						RingStats stats;
+						stats.pushed = _producer.pushed.load(std::memory_order_relaxed);
+						stats.popped = _consumer.popped.load(std::memory_order_relaxed);
+						stats.dropped = _dropped.count.load(std::memory_order_relaxed);
+						stats.highWater = _producer.highWater.load(std::memory_order_relaxed);
+						return stats;
+					}
+
+				private:
+					RingCore(const RingCore &) = delete;
+					RingCore & operator=(const RingCore &) = delete;
+
+					bool TryPush(const T & item)
+					{
+						uint32_t pos = _producer.tail.load(std::memory_order_relaxed);
+						for (;;) {
+							std::atomic<uint32_t> & seq = _seqs[pos & kMask];
+							int32_t diff = static_cast<int32_t>(seq.load(std::memory_order_acquire) - pos);
+							if (diff == 0) {
+								if (MultiProducer) {
+									if (_producer.tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) == false)
+										continue;
+								}
+								else {
+									_producer.tail.store(pos + 1, std::memory_order_relaxed);
+								}
+								_items[pos & kMask] = item;
+								seq.store(pos + 1, std::memory_order_release);
+								return true;
+							}
+							if (diff < 0)
+								return false;	/* slot still holds an item from the last lap, full */
+							pos = _producer.tail.load(std::memory_order_relaxed);
+						}
+					}
+
+					bool TryPop(T & item)
+					{
+						uint32_t pos = _consumer.head.load(std::memory_order_relaxed);
+						for (;;) {
+							std::atomic<uint32_t> & seq = _seqs[pos & kMask];
+							int32_t diff = static_cast<int32_t>(seq.load(std::memory_order_acquire) - (pos + 1));
+							if (diff == 0) {
+								if (kSharedHead) {
+									if (_consumer.head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) == false)
+										continue;
+								}
+								else {
+									_consumer.head.store(pos + 1, std::memory_order_relaxed);
+								}
+								item = _items[pos & kMask];
+								seq.store(pos + Capacity, std::memory_order_release);
+								return true;
+							}
+							if (diff < 0)
+								return false;	/* nothing written here yet, empty */
+							pos = _consumer.head.load(std::memory_order_relaxed);
+						}
+					}
+
+					/* each side on its own cache line so producer and consumer don't false-share,
+					 * padding rather than alignas keeps the ring usable with plain operator new */
+					struct ProducerSide {
+						std::atomic<uint32_t> tail{ 0 };
+						std::atomic<uint32_t> highWater{ 0 };
+						std::atomic<uint64_t> pushed{ 0 };
+						char pad[kRingCacheLine - 16];
+					};
+					struct ConsumerSide {
+						std::atomic<uint32_t> head{ 0 };
+						uint32_t reserved = 0;
+						std::atomic<uint64_t> popped{ 0 };
+						char pad[kRingCacheLine - 16];
+					};
+					struct DropCounter {
+						std::atomic<uint64_t> count{ 0 };
+						char pad[kRingCacheLine - 8];
+					};
+
+					ProducerSide _producer;
+					ConsumerSide _consumer;
+					DropCounter _dropped;
+					/* sequences apart from the items, so the items are contiguous and can be leased */
+					std::atomic<uint32_t> _seqs[Capacity];
+					T _items[Capacity];
+				};
+
+			} // namespace detail
+
+			/** Ring for one producer thread and one consumer thread */
+			template <typename T, uint32_t Capacity, RingOverflow Overflow = RingOverflow::DropNewest>
+			using SpscRing = detail::RingCore<T, Capacity, false, false, Overflow>;
+
+			/** Ring for any number of producer threads and one consumer thread */
+			template <typename T, uint32_t Capacity, RingOverflow Overflow = RingOverflow::DropNewest>
+			using MpscRing = detail::RingCore<T, Capacity, true, false, Overflow>;
+
+			/**
+			 * Ring with one writer and any number of readers, each reading every item at its own pace.
+			 *
+			 * The writer never waits: a reader that falls a whole ring behind loses the oldest items
+			 * (DropOldest for every reader) and skips ahead, counting what it lost.
+			 * Each slot is a seqlock; items are copied as atomic words, so T must be trivially copyable.
+			 */
+			template <typename T, uint32_t Capacity>
+			class BroadcastRing
+			{
+				static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+				static_assert(std::is_trivially_copyable<T>::value, "BroadcastRing copies items as raw words");
+
+				static const uint32_t kMask = Capacity - 1;
+				static const size_t kWords = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+			public:
+				/** One reader's position, owned by the reading thread */
+				class Reader
+				{
+				public:
+					RingStats Stats() const
+					{
+						RingStats stats = {};
+						stats.popped = _popped;
+						stats.dropped = _lost;
+						return stats;
+					}
+
+				private:
+					friend class BroadcastRing;
+					explicit Reader(uint32_t next) : _next(next) {}
+
+					uint32_t _next;
+					uint64_t _popped = 0;
+					uint64_t _lost = 0;	//!< items overwritten before this reader got to them
+				};
+
+				BroadcastRing()
+				{
+					for (uint32_t i = 0; i < Capacity; ++i)
+						_slots[i].seq.store(0, std::memory_order_relaxed);
+				}
+
+				/** @return a reader that sees every item pushed from now on */
+				Reader Subscribe() const
+				{
+					return Reader(_tail.load(std::memory_order_acquire));
+				}
+
+				void Push(const T & item)
+				{
+					PushBulk(&item, 1);
+				}
+
+				/** writer only, always accepts every item */
+				void PushBulk(const T * items, uint32_t count)
+				{
+					uint32_t pos = _tail.load(std::memory_order_relaxed);
+					for (uint32_t i = 0; i < count; ++i, ++pos) {
+						Slot & slot = _slots[pos & kMask];
+
+						uint32_t words[kWords] = {};
+						std::memcpy(words, &items[i], sizeof(T));
+
+						/* odd while writing, even once the item for pos is complete */
+						slot.seq.store(pos * 2 + 1, std::memory_order_relaxed);
+						std::atomic_thread_fence(std::memory_order_release);
+						for (size_t w = 0; w < kWords; ++w)
+							slot.words[w].store(words[w], std::memory_order_relaxed);
+						slot.seq.store(pos * 2 + 2, std::memory_order_release);
+					}
+					_tail.store(pos, std::memory_order_release);
+					_pushed.store(_pushed.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+				}
+
+				/** @return false if the reader has seen everything */
+				bool Pop(Reader & reader, T & item)
+				{
+					return PopBulk(reader, &item, 1) == 1;
+				}
+
+				/** @return number of items copied into items, never waits */
+				uint32_t PopBulk(Reader & reader, T * items, uint32_t capacity)
+				{
+					uint32_t popped = 0;
+					while (popped < capacity) {
+						const Slot & slot = _slots[reader._next & kMask];
+						const uint32_t expected = reader._next * 2 + 2;
+
+						uint32_t before = slot.seq.load(std::memory_order_acquire);
+						int32_t diff = static_cast<int32_t>(before - expected);
+						if (diff < 0)
+							break;	/* not written yet, or being written for the first time */
+
+						uint32_t words[kWords];
+						for (size_t w = 0; w < kWords; ++w)
+							words[w] = slot.words[w].load(std::memory_order_relaxed);
+						std::atomic_thread_fence(std::memory_order_acquire);
+						uint32_t after = slot.seq.load(std::memory_order_relaxed);
+
+						if (before != expected || after != expected) {
+							/* the writer lapped us, skip to the oldest item that can still be read */
+							uint32_t oldest = _tail.load(std::memory_order_acquire) - Capacity + 1;
+							if (static_cast<int32_t>(oldest - reader._next) > 0) {
+								reader._lost += oldest - reader._next;
+								reader._next = oldest;
+							}
+							else {
+								reader._lost += 1;
+								reader._next += 1;
+							}
+							continue;
+						}
+
+						std::memcpy(&items[popped], words, sizeof(T));
+						++popped;
+						++reader._next;
+					}
+					reader._popped += popped;
+					return popped;
+				}
+
+				/** writer side counters, see Reader::Stats for each reader's */
+				RingStats Stats() const
+				{
+					RingStats stats = {};
+					stats.pushed = _pushed.load(std::memory_order_relaxed);
+					return stats;
+				}
+
+			private:
+				BroadcastRing(const BroadcastRing &) = delete;
+				BroadcastRing & operator=(const BroadcastRing &) = delete;
+
+				struct Slot {
+					std::atomic<uint32_t> seq;
+					std::atomic<uint32_t> words[kWords];
+				};
+
+				std::atomic<uint32_t> _tail{ 0 };	//!< next position to write
+				std::atomic<uint64_t> _pushed{ 0 };
+				char _pad[detail::kRingCacheLine - 16];
+				Slot _slots[Capacity];
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,280 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/CoalescingQueue.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Receive queue split into priority classes, see CANbus_SetRxClasses.
+ *
+ * A rule table sorts each frame into a class and each class has its own ring, so a burst of bulk
+ * traffic fills its own ring and never queues ahead of frames in a more urgent class.
+ * Receiving drains class 0 first.
+ * A class can instead keep only the latest frame per arbID, see CoalescingQueue. That queue is only
+ * created the first time the class is switched over, and frames queued in the old mode are received first.
+ * The rules are compiled into an immutable table and swapped in whole, the same way as
+ * RxDispatchTable, so the I/O thread never locks to classify.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			template <uint32_t Capacity>
+			class RxClassQueue
+			{
+			public:
+				RxClassQueue() = default;
+				~RxClassQueue()
+				{
+					delete _current.load();
+					for (uint32_t c = 0; c < can::kRxClassCount; ++c)
+						delete _latest[c].load();
+				}
+
+				/**
+				 * Replace the rules, frames already queued stay in their class.
+				 * @return false if a class is out of range
+				 */
+				bool SetClasses(const can::canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+				{
+					if (defaultClass >= can::kRxClassCount)
+						return false;
+					for (uint32_t i = 0; i < count; ++i) {
+						if (rules[i].rxClass >= can::kRxClassCount)
+							return false;
+					}
+
+					Table * next = nullptr;
+					if (count > 0 || defaultClass != 0) {
+						next = new Table();
+						next->rules.assign(rules, rules + count);
+						next->defaultClass = defaultClass;
+					}
+
+					std::lock_guard<std::mutex> guard(_lck);
+					const Table * old = _current.exchange(next);
+					/* the I/O thread may still be classifying with the old table, wait it out */
+					while (_readers.load() != 0)
+						std::this_thread::yield();
+					delete old;
+					return true;
+				}
+
+				/** @return false if the class is out of range */
+				bool SetCoalescing(uint32_t rxClass, bool latestOnly)
+				{
+					if (rxClass >= can::kRxClassCount)
+						return false;
+
+					std::lock_guard<std::mutex> guard(_lck);
+					if (latestOnly && _latest[rxClass].load(std::memory_order_relaxed) == nullptr)
+						_latest[rxClass].store(new CoalescingQueue<Capacity>(), std::memory_order_release);
+					/* the queue is published before the flag and lives until we do, so the I/O thread can use it unlocked */
+					_coalesce[rxClass].store(latestOnly, std::memory_order_release);
+					return true;
+				}
+
+				/** I/O thread, @return false if the frame's class was full */
+				bool Push(const can::canframe_ex_t & frame)
+				{
+					return PushBulk(&frame, 1) == 1;
+				}
+
+				/** I/O thread, a full class drops the newest frames and counts them @return number of frames queued */
+				uint32_t PushBulk(const can::canframe_ex_t * frames, uint32_t count)
+				{
+					/* no rules, everything is class 0 */
+					if (_current.load(std::memory_order_relaxed) == nullptr)
+						return PushClass(0, frames, count);
+
+					_readers.fetch_add(1);
+					const Table * table = _current.load();
+					uint32_t pushed = 0;
+					for (uint32_t i = 0; i < count; ++i) {
+						uint32_t rxClass = (table != nullptr) ? table->Classify(frames[i].arbID) : 0;
+						pushed += PushClass(rxClass, &frames[i], 1);
+					}
+					_readers.fetch_sub(1, std::memory_order_release);
+					return pushed;
+				}
+
+				/** I/O thread, into rxClass whatever the rules say, for putting back frames taken with CopyClass */
+				uint32_t PushBulk(uint32_t rxClass, const can::canframe_ex_t * frames, uint32_t count)
+				{
+					return PushClass(rxClass, frames, count);
+				}
+
+				/** @return number of frames filled, class 0 first */
+				uint32_t PopBulk(can::canframe_ex_t * toFill, uint32_t capacity)
+				{
+					uint32_t filled = 0;
+					for (uint32_t c = 0; c < can::kRxClassCount && filled < capacity; ++c)
+						filled += PopBulk(c, toFill + filled, capacity - filled);
+					return filled;
+				}
+
+				/** @return number of frames filled from that class alone */
+				uint32_t PopBulk(uint32_t rxClass, can::canframe_ex_t * toFill, uint32_t capacity)
+				{
+					CoalescingQueue<Capacity> * latest = _latest[rxClass].load(std::memory_order_acquire);
+					if (latest == nullptr)
+						return _rings[rxClass].PopBulk(toFill, capacity);
+
+					/* whichever mode the class is not in now holds the older frames */
+					uint32_t filled;
+					if (_coalesce[rxClass].load(std::memory_order_acquire)) {
+						filled = _rings[rxClass].PopBulk(toFill, capacity);
+						filled += latest->PopBulk(toFill + filled, capacity - filled);
+					}
+					else {
+						filled = latest->PopBulk(toFill, capacity);
+						filled += _rings[rxClass].PopBulk(toFill + filled, capacity - filled);
+					}
+					return filled;
+				}
+
+				/**
+				 * Lend the oldest frames of the most urgent class that has any, see SpscRing::Lease.
+				 * A lease never spans classes, lease again after Release for the next one.
+				 */
+				uint32_t Lease(RingSpans<can::canframe_ex_t> & spans, uint32_t maxCount)
+				{
+					for (uint32_t c = 0; c < can::kRxClassCount; ++c) {
+						CoalescingQueue<Capacity> * latest = _latest[c].load(std::memory_order_acquire);
+						/* whichever mode the class is not in now holds the older frames, same as PopBulk */
+						bool latestFirst = latest != nullptr && _coalesce[c].load(std::memory_order_acquire) == false;
+						uint32_t count = 0;
+						if (latestFirst)
+							count = LeaseFrom(c, true, spans, maxCount);
+						if (count == 0)
+							count = LeaseFrom(c, false, spans, maxCount);
+						if (count == 0 && latest != nullptr && latestFirst == false)
+							count = LeaseFrom(c, true, spans, maxCount);
+						if (count > 0)
+							return count;
+					}
+					_leased = 0;
+					_leasedLatest = false;
+					return 0;
+				}
+
+				/** Hand back frames of the last Lease */
+				void Release(uint32_t count)
+				{
+					if (_leasedLatest)
+						_latest[_leased].load(std::memory_order_relaxed)->Release(count);
+					else
+						_rings[_leased].Release(count);
+				}
+
+				/**
+				 * Append the frames of one class to frames in the order they would be received, leaving them queued.
+				 * Consumer side, like Lease. Frames lent out and not yet released are included.
+				 */
+				void CopyClass(uint32_t rxClass, std::vector<can::canframe_ex_t> & frames)
+				{
+					CoalescingQueue<Capacity> * latest = _latest[rxClass].load(std::memory_order_acquire);
+					bool latestFirst = latest != nullptr && _coalesce[rxClass].load(std::memory_order_acquire) == false;
+					if (latestFirst)
+						latest->CopyTo(frames);
+
+					/* a lease only looks, it is the ring's one way to see queued frames without taking them */
+					RingSpans<can::canframe_ex_t> spans;
+					(void)_rings[rxClass].Lease(spans, Capacity);
+					frames.insert(frames.end(), spans.first, spans.first + spans.firstCount);
+					frames.insert(frames.end(), spans.second, spans.second + spans.secondCount);
+
+					if (latest != nullptr && latestFirst == false)
+						latest->CopyTo(frames);
+				}
+
+				/** Consumer side, drop every queued frame of every class, ending any lease. Not counted as dropped */
+				void Clear()
+				{
+					can::canframe_ex_t scratch[64];
+					while (PopBulk(scratch, 64) > 0) {}
+					_leased = 0;
+					_leasedLatest = false;
+				}
+
+				bool Empty() const
+				{
+					for (uint32_t c = 0; c < can::kRxClassCount; ++c) {
+						if (_rings[c].Empty() == false)
+							return false;
+						const CoalescingQueue<Capacity> * latest = _latest[c].load(std::memory_order_acquire);
+						if (latest != nullptr && latest->Empty() == false)
+							return false;
+					}
+					return true;
+				}
+
+				/** frames dropped by full classes */
+				uint64_t Dropped() const
+				{
+					uint64_t dropped = 0;
+					for (uint32_t c = 0; c < can::kRxClassCount; ++c) {
+						dropped += _rings[c].Stats().dropped;
+						const CoalescingQueue<Capacity> * latest = _latest[c].load(std::memory_order_acquire);
+						if (latest != nullptr)
+							dropped += latest->Dropped();
+					}
+					return dropped;
+				}
+
+			private:
+				RxClassQueue(const RxClassQueue &) = delete;
+				RxClassQueue & operator=(const RxClassQueue &) = delete;
+
+				uint32_t LeaseFrom(uint32_t rxClass, bool fromLatest, RingSpans<can::canframe_ex_t> & spans, uint32_t maxCount)
+				{
+					_leased = rxClass;
+					_leasedLatest = fromLatest;
+					if (fromLatest)
+						return _latest[rxClass].load(std::memory_order_relaxed)->Lease(spans, maxCount);
+					return _rings[rxClass].Lease(spans, maxCount);
+				}
+
+				uint32_t PushClass(uint32_t rxClass, const can::canframe_ex_t * frames, uint32_t count)
+				{
+					if (_coalesce[rxClass].load(std::memory_order_acquire))
+						return _latest[rxClass].load(std::memory_order_relaxed)->PushBulk(frames, count);
+					return _rings[rxClass].PushBulk(frames, count);
+				}
+
+				struct Table {
+					std::vector<can::canframe_class_rule_t> rules;	//!< first match wins
+					uint32_t defaultClass;
+
+					uint32_t Classify(uint32_t arbID) const
+					{
+						for (const can::canframe_class_rule_t & rule : rules) {
+							uint32_t key = arbID & rule.mask;
+							if (key >= rule.firstArbID && key <= rule.lastArbID)
+								return rule.rxClass;
+						}
+						return defaultClass;
+					}
+				};
+
+				SpscRing<can::canframe_ex_t, Capacity> _rings[can::kRxClassCount];
+				std::atomic<CoalescingQueue<Capacity> *> _latest[can::kRxClassCount] = {};	//!< created on first SetCoalescing
+				std::atomic<bool> _coalesce[can::kRxClassCount] = {};	//!< class keeps only the latest frame per arbID
+				uint32_t _leased = 0;	//!< class of the last Lease
+				bool _leasedLatest = false;	//!< and whether it came from the class's coalescing queue
+
+				std::mutex _lck;	//!< serializes SetClasses and SetCoalescing
+				std::atomic<const Table *> _current{ nullptr };	//!< null while every frame is class 0
+				std::atomic<uint32_t> _readers{ 0 };	//!< I/O threads inside PushBulk
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Receive callbacks for a platform's I/O thread, see CANbus_Subscribe.
+ *
+ * Subscriptions are compiled into an immutable table, grouped by mask and sorted by masked arbID,
+ * so matching a frame costs one binary search per distinct mask however many subscriptions there are.
+ * Subscribing or unsubscribing builds a new table and swaps it in; the old one is freed once no
+ * I/O thread is still dispatching through it, so Dispatch itself never locks.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			class RxDispatchTable
+			{
+			public:
+				RxDispatchTable() = default;
+				~RxDispatchTable() { delete _current.load(); }
+
+				/**
+				 * @param handle set to a nonzero handle for Remove
+				 * @return false if callback is null
+				 */
+				bool Add(uint32_t arbID, uint32_t mask, can::canframe_callback_t callback, void * context, uint32_t & handle)
+				{
+					if (callback == nullptr)
+						return false;
+
+					std::lock_guard<std::mutex> guard(_lck);
+					Subscription sub = { arbID & mask, mask, callback, context, _nextHandle++ };
+					if (_nextHandle == 0)
+						_nextHandle = 1;
+					_subs.push_back(sub);
+					Publish();
+					handle = sub.handle;
+					return true;
+				}
+
+				/**
+				 * Once this returns the callback is not running and will not be called again.
+				 * @return false if there is no such subscription
+				 */
+				bool Remove(uint32_t handle)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					auto found = std::find_if(_subs.begin(), _subs.end(), [handle](const Subscription & sub) { return sub.handle == handle; });
+					if (found == _subs.end())
+						return false;
+					_subs.erase(found);
+					Publish();
+					return true;
+				}
+
+				/** Call every matching subscription for each frame, from the I/O thread */
+				void Dispatch(const can::canframe_ex_t * frames, uint32_t count)
+				{
+					/* nobody subscribed, skip the reader count */
+					if (_current.load(std::memory_order_relaxed) == nullptr)
+						return;
+
+					_readers.fetch_add(1);
+					const Table * table = _current.load();
+					if (table != nullptr) {
+						for (uint32_t i = 0; i < count; ++i)
+							table->Dispatch(frames[i]);
+					}
+					_readers.fetch_sub(1, std::memory_order_release);
+				}
+
+			private:
+				RxDispatchTable(const RxDispatchTable &) = delete;
+				RxDispatchTable & operator=(const RxDispatchTable &) = delete;
+
+				struct Subscription {
+					uint32_t key;	//!< arbID & mask
+					uint32_t mask;
+					can::canframe_callback_t callback;
+					void * context;
+					uint32_t handle;
+				};
+
+				struct Table {
+					struct Group {
+						uint32_t mask;
+						std::vector<Subscription> subs;	//!< sorted by key, in subscription order within a key
+					};
+					std::vector<Group> groups;
+
+					void Dispatch(const can::canframe_ex_t & frame) const
+					{
+						for (const Group & group : groups) {
+							uint32_t key = frame.arbID & group.mask;
+							auto first = std::lower_bound(group.subs.begin(), group.subs.end(), key,
+								[](const Subscription & sub, uint32_t k) { return sub.key < k; });
+							for (; first != group.subs.end() && first->key == key; ++first)
+								first->callback(&frame, first->context);
+						}
+					}
+				};
+
+				/* expects _lck to be held */
+				void Publish()
+				{
+					Table * next = nullptr;
+					if (_subs.empty() == false) {
+						next = new Table();
+						for (const Subscription & sub : _subs) {
+							auto group = std::find_if(next->groups.begin(), next->groups.end(),
+								[&sub](const Table::Group & g) { return g.mask == sub.mask; });
+							if (group == next->groups.end()) {
+								next->groups.push_back(Table::Group());
+								group = next->groups.end() - 1;
+								group->mask = sub.mask;
+							}
+							group->subs.push_back(sub);
+						}
+						for (Table::Group & group : next->groups) {
+							std::stable_sort(group.subs.begin(), group.subs.end(),
+								[](const Subscription & a, const Subscription & b) { return a.key < b.key; });
+						}
+					}
+
+					const Table * old = _current.exchange(next);
+
+					/* a reader that got the old table bumped the count first, wait it out;
+					 * callbacks may not block, so this is short */
+					while (_readers.load() != 0)
+						std::this_thread::yield();
+					delete old;
+				}
+
+				std::mutex _lck;	//!< serializes Add and Remove
+				std::vector<Subscription> _subs;	//!< in subscription order
+				uint32_t _nextHandle = 1;
+
+				std::atomic<const Table *> _current{ nullptr };	//!< null when nothing is subscribed
+				std::atomic<uint32_t> _readers{ 0 };	//!< I/O threads inside Dispatch
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+#endif
+
+/**
+ * Pollable "frames are waiting" flag for a receive queue, see CANbus_GetRxEvent.
+ *
+ * Linux uses an eventfd, other POSIX platforms the read end of a pipe, Windows a manual-reset event.
+ * The handle is only created once someone asks for it, until then Signal and Clear cost one load.
+ *
+ * Signalling is edge-coalesced: only the first Signal after a Clear reaches the kernel,
+ * so a burst of frames wakes a poller once. The consumer clears it when it finds the queue empty
+ * and then looks at the queue again, so a frame that lands while it clears is never missed.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			class RxEvent
+			{
+			public:
+				RxEvent() = default;
+				~RxEvent() { Close(); }
+
+				/**
+				 * Create the handle if it does not exist yet.
+				 * @param handle set to the file descriptor, or the HANDLE on Windows
+				 * @return false if the handle could not be created
+				 */
+				bool Open(intptr_t & handle)
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					if (_open.load(std::memory_order_relaxed) == false) {
+						if (Create() == false)
+							return false;
+						_open.store(true, std::memory_order_release);
+					}
+					handle = _handle;
+					return true;
+				}
+
+				/** Producer side, call after frames have been queued */
+				void Signal()
+				{
+					if (_open.load(std::memory_order_acquire) == false)
+						return;
+					/* the frames must be visible before a consumer can see the flag set */
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (_signaled.exchange(true) == false)
+						Raise();
+				}
+
+				/**
+				 * Consumer side, call after a receive found the queue empty.
+				 * @param isEmpty callable that tells whether the queue is still empty
+				 */
+				template <typename IsEmpty>
+				void Clear(IsEmpty isEmpty)
+				{
+					if (_open.load(std::memory_order_acquire) == false || _signaled.load(std::memory_order_relaxed) == false)
+						return;
+					/* lower the handle before the flag, a producer racing with us then either sees the
+					 * flag still set and leaves it to our second look, or sees it clear and raises again */
+					Lower();
+					_signaled.store(false);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (isEmpty() == false)
+						Signal();
+				}
+
+				/** Destroy the handle, only once no other thread uses the event */
+				void Close()
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					if (_open.load(std::memory_order_relaxed) == false)
+						return;
+					_open.store(false, std::memory_order_relaxed);
+					_signaled.store(false, std::memory_order_relaxed);
+#if defined(_WIN32)
+					CloseHandle(reinterpret_cast<HANDLE>(_handle));
+#else
+					if (_writeFd != static_cast<int>(_handle))
+						close(_writeFd);
+					close(static_cast<int>(_handle));
+#endif
+				}
+
+			private:
+				RxEvent(const RxEvent &) = delete;
+				RxEvent & operator=(const RxEvent &) = delete;
+
+#if defined(_WIN32)
+				bool Create()
+				{
+					HANDLE event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+					if (event == nullptr)
+						return false;
+					_handle = reinterpret_cast<intptr_t>(event);
+					return true;
+				}
+				void Raise() { SetEvent(reinterpret_cast<HANDLE>(_handle)); }
+				void Lower() { ResetEvent(reinterpret_cast<HANDLE>(_handle)); }
+#elif defined(__linux__)
+				bool Create()
+				{
+					int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+					if (fd < 0)
+						return false;
+					_handle = fd;
+					_writeFd = fd;
+					return true;
+				}
+				void Raise()
+				{
+					uint64_t one = 1;
+					while (write(_writeFd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+				}
+				void Lower()
+				{
+					uint64_t count;
+					while (read(static_cast<int>(_handle), &count, sizeof(count)) < 0 && errno == EINTR) {}
+				}
+#else
+				bool Create()
+				{
+					int fds[2];
+					if (pipe(fds) != 0)
+						return false;
+					for (int fd : fds) {
+						fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+						fcntl(fd, F_SETFD, FD_CLOEXEC);
+					}
+					_handle = fds[0];
+					_writeFd = fds[1];
+					return true;
+				}
+				void Raise()
+				{
+					char one = 1;
+					while (write(_writeFd, &one, 1) < 0 && errno == EINTR) {}
+				}
+				void Lower()
+				{
+					char buffer[64];
+					for (;;) {
+						ssize_t got = read(static_cast<int>(_handle), buffer, sizeof(buffer));
+						if (got < 0 && errno != EINTR)
+							break;
+						if (got == 0)
+							break;
+					}
+				}
+#endif
+
+				std::mutex _lck;	//!< only guards creating and destroying the handle
+				std::atomic<bool> _open{ false };
+				std::atomic<bool> _signaled{ false };
+				intptr_t _handle = 0;
+#if !defined(_WIN32)
+				int _writeFd = -1;
+#endif
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
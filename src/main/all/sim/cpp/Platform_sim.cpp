@@ -2,6 +2,7 @@
 #include "ctre/phoenix/ErrorCode.h"
 #include "ctre/phoenix/runtime/LibLoader.h" // useful for plugin strategy
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 #include <iostream> // std::cout
@@ -12,21 +13,75 @@
 #include <fstream>
 #include <mutex>
 
-#define CTRE_CREATE_EXPORTS // we need typedefs, not proto's
-#include "SimulationAdapter.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "SimWorld.h"
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+#include <process.h>
+#define SIM_GETPID() _getpid()
+#else
+#include <unistd.h>
+#define SIM_GETPID() getpid()
+#endif
 
 namespace ctre {
 	namespace phoenix {
 		namespace platform {
 
-			std::map<std::pair<DeviceType, int>, std::unique_ptr<ctre::phoenix::runtime::LibLoader>> libMap;
+			/* every world in the process */
+			struct SimWorldRegistry {
+				std::mutex lck;
+				std::map<uint32_t, std::unique_ptr<SimWorld>> worlds;
+				uint32_t nextId = 1;
+			};
 
-			std::mutex simCreateLock;
+			/* never destroyed, exit handlers still need it after static destructors have run */
+			static SimWorldRegistry & GetWorldRegistry()
+			{
+				static SimWorldRegistry * registry = new SimWorldRegistry();
+				return *registry;
+			}
+
+			/* world used by threads that never bound one, always ID 0 */
+			static SimWorld & GetDefaultWorld()
+			{
+				static SimWorld * world = [] {
+					SimWorldRegistry & registry = GetWorldRegistry();
+					std::lock_guard<std::mutex> guard(registry.lck);
+					auto & entry = registry.worlds[0];
+					entry.reset(new SimWorld(0));
+					return entry.get();
+				}();
+				return *world;
+			}
+
+			/* world the calling thread bound with SimWorldSetCurrent, nullptr for the default one */
+			static thread_local SimWorld * simCurrentWorld = nullptr;
+
+			static SimWorld & GetCurrentWorld()
+			{
+				if (simCurrentWorld)
+					return *simCurrentWorld;
+				return GetDefaultWorld();
+			}
+
+			/* makes temp library names unique across creates running at the same time */
+			std::atomic<uint32_t> simTempLibCount{ 0 };
 
             static void ClearAll(){
-                std::lock_guard<std::mutex> guard(simCreateLock);
-				
-                libMap.clear();
+                SimWorldRegistry & registry = GetWorldRegistry();
+                std::vector<std::shared_ptr<SimDevice>> devices;
+                {
+                    std::lock_guard<std::mutex> guard(registry.lck);
+                    for (auto &world : registry.worlds) {
+                        auto taken = world.second->TakeAllDevices();
+                        for (auto &device : taken) { devices.push_back(std::move(device)); }
+                    }
+                }
+
+                /* torn down outside the registry lock, stopping workers can take a while */
+                devices.clear();
 			}
 
             #if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
@@ -37,12 +92,179 @@ namespace ctre {
             
             #endif
 
+			SimWorld * SimWorldCreate()
+			{
+				SimWorldRegistry & registry = GetWorldRegistry();
+				std::lock_guard<std::mutex> guard(registry.lck);
+
+				uint32_t id = registry.nextId++;
+				auto & entry = registry.worlds[id];
+				entry.reset(new SimWorld(id));
+				return entry.get();
+			}
+
+			int32_t SimWorldDestroy(SimWorld * world)
+			{
+				std::unique_ptr<SimWorld> toDestroy;
+				{
+					SimWorldRegistry & registry = GetWorldRegistry();
+					std::lock_guard<std::mutex> guard(registry.lck);
+
+					/* don't trust the handle until we find it, the default world lives as long as the process */
+					auto iter = registry.worlds.begin();
+					while (iter != registry.worlds.end() && iter->second.get() != world) { ++iter; }
+					if (iter == registry.worlds.end() || iter->first == 0)
+						return ErrorCode::InvalidParamValue;
+
+					toDestroy = std::move(iter->second);
+					registry.worlds.erase(iter);
+				}
+
+				if (simCurrentWorld == world)
+					simCurrentWorld = nullptr;
+
+				/* devices are torn down outside the registry lock, stopping workers can take a while */
+				toDestroy.reset();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimWorldSetCurrent(SimWorld * world)
+			{
+				if (world != nullptr) {
+					SimWorldRegistry & registry = GetWorldRegistry();
+					std::lock_guard<std::mutex> guard(registry.lck);
+
+					/* don't trust the handle until we find it, same as SimWorldDestroy */
+					auto iter = registry.worlds.begin();
+					while (iter != registry.worlds.end() && iter->second.get() != world) { ++iter; }
+					if (iter == registry.worlds.end())
+						return ErrorCode::InvalidParamValue;
+				}
+
+				simCurrentWorld = world;
+				return ErrorCode::OK;
+			}
+
+			SimWorld * SimWorldGetCurrent()
+			{
+				return &GetCurrentWorld();
+			}
+
+			int32_t SimSnapshotTake(SimSnapshot ** snapshot)
+			{
+				if (snapshot == nullptr)
+					return ErrorCode::InvalidParamValue;
+				*snapshot = nullptr;
+
+				std::unique_ptr<SimSnapshot> taken(new SimSnapshot());
+				int32_t retval = GetCurrentWorld().TakeSnapshot(*taken);
+				if (retval == 0) {
+					*snapshot = taken.release();
+				}
+				return retval;
+			}
+
+			int32_t SimSnapshotRestore(const SimSnapshot * snapshot)
+			{
+				if (snapshot == nullptr)
+					return ErrorCode::InvalidParamValue;
+				return GetCurrentWorld().RestoreSnapshot(*snapshot);
+			}
+
+			int32_t SimSnapshotRelease(SimSnapshot * snapshot)
+			{
+				delete snapshot;
+				return ErrorCode::OK;
+			}
+
+			int32_t SimGetDeviceStats(SimDeviceStats * stats, uint32_t capacity, uint32_t * numberFilled)
+			{
+				if (numberFilled == nullptr || (stats == nullptr && capacity > 0))
+					return ErrorCode::InvalidParamValue;
+
+				GetCurrentWorld().GetDeviceStats(stats, capacity, *numberFilled);
+				return ErrorCode::OK;
+			}
+
+			int32_t SimResetDeviceStats()
+			{
+				GetCurrentWorld().ResetDeviceStats();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimSetProfileSummaryPeriod(uint32_t periodMs)
+			{
+				GetCurrentWorld().SetProfileSummaryPeriod(periodMs);
+				return ErrorCode::OK;
+			}
+
+			int32_t SimStartRecording(const char * path)
+			{
+				if (path == nullptr)
+					return ErrorCode::InvalidParamValue;
+				return GetCurrentWorld().StartRecording(path);
+			}
+
+			int32_t SimStopRecording()
+			{
+				GetCurrentWorld().StopRecording();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimStartReplay(const char * path)
+			{
+				if (path == nullptr)
+					return ErrorCode::InvalidParamValue;
+				return GetCurrentWorld().StartReplay(path);
+			}
+
+			int32_t SimStopReplay()
+			{
+				GetCurrentWorld().StopReplay();
+				return ErrorCode::OK;
+			}
+
 			void SleepUs(int timeUs)
 			{
-				std::this_thread::sleep_for(std::chrono::microseconds(timeUs));
+				GetCurrentWorld().Clock().SleepUs(timeUs);
 			}
 
-			ErrorCode SimGetDeviceCharacteristics(DeviceType type, int id, std::string & envVarName, std::string & tempDllName)
+			int32_t SimSetVirtualTime(bool enable)
+			{
+				GetCurrentWorld().Clock().SetVirtual(enable);
+				return ErrorCode::OK;
+			}
+
+			uint64_t SimGetTimeUs()
+			{
+				return GetCurrentWorld().Clock().NowUs();
+			}
+
+			int32_t SimClockAttach()
+			{
+				GetCurrentWorld().Clock().Attach();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimClockDetach()
+			{
+				GetCurrentWorld().Clock().Detach();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimSetTransport(SimTransport transport)
+			{
+				GetCurrentWorld().SetTransport(transport);
+				return ErrorCode::OK;
+			}
+
+			int32_t SimSetBusBitrate(uint32_t bitsPerSecond)
+			{
+				GetCurrentWorld().SetBusBitrate(bitsPerSecond);
+				return ErrorCode::OK;
+			}
+
+			ErrorCode SimGetDeviceCharacteristics(DeviceType type, int id, uint32_t worldId, std::string & envVarName, std::string & tempDllName)
 			{
 				std::stringstream work; //!< temp for temp dll name
 				ErrorCode retval = ErrorCode::OK;
@@ -74,6 +296,8 @@ namespace ctre {
 
 				/* finish temp Dll Name*/
 				if (retval == ErrorCode::OK) {
+					/* keep copies from other worlds, other creates and other processes in this directory apart */
+					work << "_" << SIM_GETPID() << "_" << worldId << "_" << simTempLibCount++;
 					/* suffix .dll in windows */
 #if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
 					work << ".dll";
@@ -93,13 +317,14 @@ namespace ctre {
 
 			int32_t SimCreate(DeviceType type, int id)
 			{
-				/* lock out the rest of the function */
-				std::lock_guard<std::mutex> guard(simCreateLock);
+				SimWorld & world = GetCurrentWorld();
+
+				/* the log stands in for every device, there is nothing to load */
+				if (world.IsReplaying())
+					return 0;
 
 				/* did we already create this device? */
-				std::pair<DeviceType, int> identifier(type, id);
-				auto iter = libMap.find(identifier);
-				if (iter != libMap.end()) {
+				if (world.HasDevice(type, id)) {
 					/* replace with error code after header repos is created */
 					return -1;
 
@@ -109,16 +334,14 @@ namespace ctre {
 				int retval = 0;
 
 				/* create a lib entry */
-				libMap.insert(std::make_pair(identifier, std::make_unique<ctre::phoenix::runtime::LibLoader>()));
-				iter = libMap.find(identifier);
-				auto &lib = iter->second;
+				std::unique_ptr<runtime::LibLoader> lib = std::make_unique<runtime::LibLoader>();
 
 				/* check type and get device specific characteristics */
 				std::string envVarName;
 				std::string tempDllName;
 				if (retval == 0)
 				{
-					retval = SimGetDeviceCharacteristics(type, id, envVarName, tempDllName);
+					retval = SimGetDeviceCharacteristics(type, id, world.GetId(), envVarName, tempDllName);
 				}
 
 				/* attempt to retrieve env var telling us the DLL/SO location. */
@@ -136,9 +359,13 @@ namespace ctre {
 					}
 				}
 
+				/* a process-hosted device loads the lib in its own host, this process must never load it */
+				SimTransport transport = world.GetTransport();
+				bool loadHere = (transport != SimTransport::Process);
+
 				/* attempt to load the lib*/
 				std::ifstream src;
-				if (retval == 0) {
+				if (retval == 0 && loadHere) {
 					src.open(srcLibPath, std::ios::binary);
 					if (false == src.is_open())
 					{
@@ -150,7 +377,7 @@ namespace ctre {
 
 				/* attempt to create destination file */
 				std::ofstream dst;
-				if (retval == 0) {
+				if (retval == 0 && loadHere) {
 					/* attempt to write destination file */
 					dst.open(tempDllName.c_str(), std::ios::binary);
 					if (false == dst.is_open())
@@ -160,7 +387,7 @@ namespace ctre {
 					}
 				}
 				/* attempt to copy from source to dest file */
-				if (retval == 0) {
+				if (retval == 0 && loadHere) {
 					/* copy the contents */
 					dst << src.rdbuf();
 					/* all done with file, this ensures file IO complete before we attempt to system-load */
@@ -184,7 +411,7 @@ namespace ctre {
 				//}
 
 				/* load the lib as a system resource */
-				if (retval == 0) {
+				if (retval == 0 && loadHere) {
 					try
 					{
 						lib->Open(tempDllName.c_str());
@@ -197,33 +424,54 @@ namespace ctre {
 				}
 
 				/* no need to keep the copy, remove it from the file sys regardless of success. */
-				(void)remove(tempDllName.c_str()); /* this will fail in Windows, ignore for now */
+				if (loadHere) {
+					(void)remove(tempDllName.c_str()); /* this will fail in Windows, ignore for now */
+				}
 
-				/* call the start routine */
+				/* host and start the device, fails if another thread created it meanwhile */
 				if (retval == 0) {
-					try
-					{
-						/* call our first routine from the loaded resource*/
-						retval = LIBLOADER_LOOKUP(*lib, ctre_phoenix_simulation_adapter_Start)(id);
-					}
-					catch (const runtime::LibLoaderException & excep)
-					{
-						/* DLL was good but func is missing? */
-						retval = excep.GetPhoenixErrorCode();
-					}
+					retval = world.AddDevice(type, id, transport, std::move(lib), srcLibPath);
+				}
+
+				if (retval == 0) {
+					/* exit handlers run in reverse order, registering after the first adapter is up means
+					 * worker threads are stopped before its statics are torn down, once is enough */
+					static std::once_flag exitHandlerOnce;
+					std::call_once(exitHandlerOnce, [] { (void)std::atexit(ClearAll); });
 				}
 
 				return retval;
 			}
 
-			int32_t SimConfigGet(DeviceType /*type*/, uint32_t /*param*/, uint32_t /*valueToSend*/, uint32_t & /*outValueReceived*/, uint32_t & /*outSubvalue*/, uint32_t /*ordinal*/, uint32_t /*id*/) {
-				std::lock_guard<std::mutex> guard(simCreateLock);
-				return 0;
+			int32_t SimGetDropCounts(uint32_t * deviceTxDropCount, uint32_t * rxDropCount)
+			{
+				GetCurrentWorld().GetStatus(nullptr, nullptr, deviceTxDropCount, rxDropCount);
+				return ErrorCode::OK;
+			}
+
+			int32_t SimConfigSetBatch(DeviceType type, int id, const SimConfigParam * params, uint32_t count)
+			{
+				if (params == nullptr && count > 0)
+					return ErrorCode::InvalidParamValue;
+
+				return GetCurrentWorld().ConfigSetBatch(type, id, params, count);
+			}
+
+			int32_t SimConfigGet(DeviceType type, uint32_t param, uint32_t valueToSend, uint32_t & outValueReceived, uint32_t & outSubvalue, uint32_t ordinal, uint32_t id) {
+				/* init outputs */
+				outValueReceived = 0;
+				outSubvalue = 0;
+
+				return GetCurrentWorld().ConfigGet(type, static_cast<int>(id), param, valueToSend, outValueReceived, outSubvalue, ordinal);
 			}
 
-			int32_t SimConfigSet(DeviceType /*type*/, uint32_t /*param*/, uint32_t /*value*/, uint32_t /*subValue*/, uint32_t /*ordinal*/, uint32_t /*id*/) {
-				std::lock_guard<std::mutex> guard(simCreateLock);
-				return 0;
+			int32_t SimConfigSet(DeviceType type, uint32_t param, uint32_t value, uint32_t subValue, uint32_t ordinal, uint32_t id) {
+				SimConfigParam toSet;
+				toSet.param = param;
+				toSet.value = value;
+				toSet.subValue = subValue;
+				toSet.ordinal = ordinal;
+				return SimConfigSetBatch(type, static_cast<int>(id), &toSet, 1);
 			}
 
 			/**
@@ -242,13 +490,11 @@ namespace ctre {
 				std::cout << details << std::endl << "\t" << location << std::endl;
 			}
 			int32_t SimDestroy(DeviceType type, int id) {
-                std::lock_guard<std::mutex> guard(simCreateLock);
-                
-                libMap.erase(std::make_pair(type, id));
+                GetCurrentWorld().DestroyDevice(type, id);
                 return 0;
             }
 			int32_t SimDestroyAll() {
-                ClearAll();
+                GetCurrentWorld().DestroyAllDevices();
 			    return 0;
             }
 
@@ -268,29 +514,20 @@ namespace ctre {
 		namespace platform {
 			namespace can {
 
-				void CANbus_GetStatus(float * /*percentBusUtilization*/, uint32_t * /*busOffCount*/, uint32_t * /*txFullCount*/, uint32_t * /*receiveErrorCount*/,
-					uint32_t * /*transmitErrorCount*/, int32_t * /*status*/)
+				void CANbus_GetStatus(float * percentBusUtilization, uint32_t * busOffCount, uint32_t * txFullCount, uint32_t * receiveErrorCount,
+					uint32_t * transmitErrorCount, int32_t * status)
 				{
-					std::lock_guard<std::mutex> guard(simCreateLock);
+					/* the sim bus never errors, frames the model drops are not bus errors, see SimGetDropCounts */
+					GetCurrentWorld().GetStatus(percentBusUtilization, txFullCount, nullptr, nullptr);
+
+					if (busOffCount) { *busOffCount = 0; }
+					if (receiveErrorCount) { *receiveErrorCount = 0; }
+					if (transmitErrorCount) { *transmitErrorCount = 0; }
+					if (status) { *status = 0; }
 				}
 				int32_t CANbus_SendFrame(uint32_t messageID, const uint8_t * data, uint8_t dataSize)
 				{
-					int32_t retval = 0;
-					std::lock_guard<std::mutex> guard(simCreateLock);
-
-					for (auto &identifiedLib : libMap) {
-						auto &lib = identifiedLib.second;
-						int err = 0;
-						try {
-							err = LIBLOADER_LOOKUP(*lib, ctre_phoenix_simulation_adapter_SendCANFrame)(messageID, data, dataSize);
-						}
-						catch (const runtime::LibLoaderException & excep) {
-							err = excep.GetPhoenixErrorCode();
-						}
-						if (retval == 0) { retval = err; }
-					}
-
-					return retval;
+					return GetCurrentWorld().SendFrame(messageID, data, dataSize);
 				}
 				int32_t CANbus_ReceiveFrame(canframe_t * toFillArray, uint32_t capacity, uint32_t *numberFilled)
 				{
@@ -301,46 +538,91 @@ namespace ctre {
 					if (capacity < 1)
 						return ErrorCode::InvalidParamValue;
 
-					int32_t retval = 0;
-					std::lock_guard<std::mutex> guard(simCreateLock);
-
-					for (auto &identifiedLib : libMap) {
-						auto &lib = identifiedLib.second;
-						uint32_t messageID = 0;
-						uint8_t dataToFill[8];
-						uint8_t dataSizeFilled = 0;
-
-						int err = 0;
-
-						try
-						{
-							err = LIBLOADER_LOOKUP(*lib, ctre_phoenix_simulation_adapter_ReceiveCANFrame)(&messageID, dataToFill, &dataSizeFilled);
-						}
-						catch (const runtime::LibLoaderException & excep)
-						{
-							err = excep.GetPhoenixErrorCode();
-						}
-
-						if (err == 0)
-						{
-							/* filler caller's outputs, just one frame */
-							canframe_t & toFill = toFillArray[0];
-							toFill.arbID = messageID;
-							toFill.dlc = dataSizeFilled;
-							toFill.timeStampUs = 0;
-							toFill.flags = 0;
-							std::memcpy(toFill.data, dataToFill, 8);
-							*numberFilled = 1;
-							
-                            //std::cout << std::hex << "rec: " << toFill.arbID << std::endl    
-        
-                            return 0;
-						}
-						/* save first bad one */
-						if (retval == 0) { retval = err; }
-					}
+					return GetCurrentWorld().ReceiveFrame(toFillArray, capacity, *numberFilled);
+				}
+				int32_t CANbus_ReceiveFrameEx(canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+				{
+					/* init outputs */
+					*numberFilled = 0;
+
+					/* scrutinize inputs */
+					if (capacity < 1)
+						return ErrorCode::InvalidParamValue;
+
+					/* stamped when the frame finished on the simulated bus */
+					return GetCurrentWorld().ReceiveFrameEx(toFillArray, capacity, *numberFilled);
+				}
+				uint64_t CANbus_GetTimeNs()
+				{
+					/* frames are stamped on the sim clock, virtual time included */
+					return GetCurrentWorld().Clock().NowUs() * 1000;
+				}
+				int32_t CANbus_LeaseFrames(canframe_lease_t * lease, uint32_t maxFrames)
+				{
+					/* scrutinize inputs */
+					if (lease == nullptr)
+						return ErrorCode::InvalidParamValue;
+
+					/* lent out of the current world's receive ring */
+					RingSpans<canframe_ex_t> spans = {};
+					(void)GetCurrentWorld().LeaseFrames(spans, maxFrames);
+					lease->first = spans.first;
+					lease->firstCount = spans.firstCount;
+					lease->second = spans.second;
+					lease->secondCount = spans.secondCount;
+					return ErrorCode::OK;
+				}
+				int32_t CANbus_ReleaseFrames(uint32_t count)
+				{
+					GetCurrentWorld().ReleaseFrames(count);
+					return ErrorCode::OK;
+				}
+				int32_t CANbus_SetRxClasses(const canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+				{
+					/* scrutinize inputs */
+					if (rules == nullptr && count > 0)
+						return ErrorCode::InvalidParamValue;
 
-					return retval;
+					/* each world has its own classes, snapshots keep every class's frames */
+					if (GetCurrentWorld().SetRxClasses(rules, count, defaultClass) == false)
+						return ErrorCode::InvalidParamValue;
+					return ErrorCode::OK;
+				}
+				int32_t CANbus_SetRxCoalescing(uint32_t rxClass, bool latestOnly)
+				{
+					/* a snapshot copies a coalescing class's frames like any other */
+					if (GetCurrentWorld().SetRxCoalescing(rxClass, latestOnly) == false)
+						return ErrorCode::InvalidParamValue;
+					return ErrorCode::OK;
+				}
+				int32_t CANbus_ReceiveClassEx(uint32_t rxClass, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+				{
+					/* init outputs */
+					*numberFilled = 0;
+
+					/* scrutinize inputs */
+					if (rxClass >= kRxClassCount || capacity < 1)
+						return ErrorCode::InvalidParamValue;
+
+					return GetCurrentWorld().ReceiveClassEx(rxClass, toFillArray, capacity, *numberFilled);
+				}
+				int32_t CANbus_Subscribe(uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle)
+				{
+					if (handle == nullptr)
+						return ErrorCode::InvalidParamValue;
+					/* callbacks run on whichever thread pumps the current world's bus, with the world locked */
+					return GetCurrentWorld().Subscribe(arbID, mask, callback, context, *handle);
+				}
+				int32_t CANbus_Unsubscribe(uint32_t handle)
+				{
+					return GetCurrentWorld().Unsubscribe(handle);
+				}
+				int32_t CANbus_GetRxEvent(intptr_t * handle)
+				{
+					if (handle == nullptr)
+						return ErrorCode::InvalidParamValue;
+					/* each world has its own, this is the current world's */
+					return GetCurrentWorld().GetRxEvent(*handle);
 				}
 
 				int32_t SetCANInterface(const char * /*interface*/)
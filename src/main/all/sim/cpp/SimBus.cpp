@@ -0,0 +1,155 @@
+#include "SimBus.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			SimBus::SimBus() : _bitrate(1000000)
+			{
+				/* default is the FRC bus rate, 0 selects an ideal bus */
+				const char * env = std::getenv("CTRE_SIM_CAN_BITRATE");
+				if (env != nullptr) {
+					_bitrate = static_cast<uint32_t>(std::strtoul(env, nullptr, 10));
+				}
+			}
+
+			void SimBus::SetBitrate(uint32_t bitsPerSecond)
+			{
+				_bitrate = bitsPerSecond;
+			}
+
+			uint32_t SimBus::FrameBits(uint8_t dlc)
+			{
+				/* 29-bit ID frame: 54 stuffable header/data-length bits, 8 per data byte, 13 bits of
+				 * CRC delimiter, ACK, EOF and interframe space, plus one stuff bit per 4 stuffable bits (worst case) */
+				uint32_t stuffable = 54u + 8u * dlc;
+				return stuffable + 13u + (stuffable - 1u) / 4u;
+			}
+
+			uint64_t SimBus::FrameTimeNs(uint8_t dlc) const
+			{
+				if (_bitrate == 0)
+					return 0;
+				return static_cast<uint64_t>(FrameBits(dlc)) * 1000000000ull / _bitrate;
+			}
+
+			void SimBus::Queue(SimBusFrame & frame, uint64_t nowNs)
+			{
+				frame.queuedNs = nowNs;
+				frame.seq = _seq++;
+				_pending.insert(frame);
+				_queuedTimes.insert(nowNs);
+			}
+
+			int32_t SimBus::TransmitFromRobot(uint32_t arbID, const uint8_t * data, uint8_t dlc, uint64_t nowNs)
+			{
+				if (_pendingFromRobot >= kTxQueueCapacity) {
+					/* same as a full tx fifo on real hardware */
+					++_txFullCount;
+					return ErrorCode::BufferFull;
+				}
+
+				SimBusFrame frame;
+				frame.arbID = arbID;
+				frame.dlc = std::min<uint8_t>(dlc, 8);
+				std::memcpy(frame.data, data, frame.dlc);
+				frame.fromRobot = true;
+				Queue(frame, nowNs);
+				++_pendingFromRobot;
+
+				return ErrorCode::OK;
+			}
+
+			int32_t SimBus::TransmitFromDevice(uint64_t source, uint32_t arbID, const uint8_t * data, uint8_t dlc, uint64_t nowNs)
+			{
+				size_t & pending = _pendingFromDevice[source];
+				if (pending >= kDeviceTxQueueCapacity) {
+					/* the device's own tx fifo overflows, nobody is told but we count it */
+					++_deviceTxDropCount;
+					return ErrorCode::BufferFull;
+				}
+
+				SimBusFrame frame;
+				frame.arbID = arbID;
+				frame.dlc = std::min<uint8_t>(dlc, 8);
+				std::memcpy(frame.data, data, frame.dlc);
+				frame.fromRobot = false;
+				frame.source = source;
+				Queue(frame, nowNs);
+				++pending;
+
+				return ErrorCode::OK;
+			}
+
+			void SimBus::AccumulateBusy(uint64_t startNs, uint64_t endNs)
+			{
+				_windowBusyNs += endNs - startNs;
+			}
+
+			void SimBus::Advance(uint64_t nowNs, const DeliverHandler & deliver)
+			{
+				while (_pending.empty() == false) {
+					/* the bus goes busy when it is free and somebody is waiting */
+					uint64_t earliest = *_queuedTimes.begin();
+					uint64_t start = std::max(_busFreeNs, earliest);
+					if (start > nowNs)
+						break;
+
+					/* arbitration: lowest ID among the frames waiting at that moment */
+					auto winner = _pending.begin();
+					while (winner->queuedNs > start) {
+						++winner;
+					}
+
+					/* leave it on the bus until its last bit is out */
+					uint64_t end = start + FrameTimeNs(winner->dlc);
+					if (end > nowNs)
+						break;
+
+					SimBusFrame frame = *winner;
+					_pending.erase(winner);
+					_queuedTimes.erase(_queuedTimes.find(frame.queuedNs));
+					if (frame.fromRobot) {
+						--_pendingFromRobot;
+					}
+					else {
+						auto source = _pendingFromDevice.find(frame.source);
+						if (--source->second == 0) { _pendingFromDevice.erase(source); }
+					}
+
+					AccumulateBusy(start, end);
+					_busFreeNs = end;
+
+					frame.deliveredNs = end;
+					deliver(frame);
+				}
+
+				/* roll the utilization window */
+				if (_windowStarted == false || nowNs < _windowStartNs) {
+					_windowStarted = true;
+					_windowStartNs = nowNs;
+					_windowBusyNs = 0;
+				}
+				else if (nowNs - _windowStartNs >= kUtilizationWindowNs) {
+					_utilization = static_cast<float>(static_cast<double>(_windowBusyNs) / static_cast<double>(nowNs - _windowStartNs));
+					_utilization = std::min(_utilization, 1.0f);
+					_windowStartNs = nowNs;
+					_windowBusyNs = 0;
+				}
+			}
+
+			void SimBus::GetStatus(float * percentBusUtilization, uint32_t * txFullCount, uint32_t * deviceTxDropCount) const
+			{
+				if (percentBusUtilization) { *percentBusUtilization = _utilization; }
+				if (txFullCount) { *txFullCount = _txFullCount; }
+				if (deviceTxDropCount) { *deviceTxDropCount = _deviceTxDropCount; }
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
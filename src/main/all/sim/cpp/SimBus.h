@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** a frame while it is on the simulated bus */
+			struct SimBusFrame {
+				uint32_t arbID = 0;
+				uint8_t data[8] = {};
+				uint8_t dlc = 0;
+				bool fromRobot = false;
+				uint64_t source = 0;	//!< sending device, see TransmitFromDevice
+				uint64_t queuedNs = 0;	//!< when the sender handed it over
+				uint64_t deliveredNs = 0;	//!< when the last bit left the bus
+				uint64_t seq = 0;	//!< tie-breaker so equal IDs stay FIFO
+			};
+
+			/**
+			 * Bandwidth-limited CAN bus model.
+			 *
+			 * Frames from the robot and from the devices are queued here and leave the bus one at a time,
+			 * each taking its worst-case bit length at the configured bitrate. When several frames are waiting
+			 * as the bus goes idle, the lowest arbitration ID wins, like on real CAN.
+			 * A bitrate of 0 models an ideal bus where frames go through instantly.
+			 * Each sender has a bounded transmit queue, so a device that floods the bus loses its own frames
+			 * instead of growing the queue without limit.
+			 *
+			 * Not thread safe, the caller serializes access.
+			 */
+			class SimBus
+			{
+			public:
+				typedef std::function<void(const SimBusFrame &)> DeliverHandler;
+
+				/* depth of the robot's transmit queue, frames beyond this are refused */
+				static const size_t kTxQueueCapacity = 128;
+				/* depth of each device's transmit queue, frames beyond this are dropped and counted */
+				static const size_t kDeviceTxQueueCapacity = 128;
+				/* utilization is averaged over this window */
+				static const uint64_t kUtilizationWindowNs = 100000000ull;
+
+				SimBus();
+
+				void SetBitrate(uint32_t bitsPerSecond);
+				uint32_t GetBitrate() const { return _bitrate; }
+
+				/**
+				 * Queue a frame from the robot.
+				 * @return 0 on success, BufferFull if the transmit queue is full
+				 */
+				int32_t TransmitFromRobot(uint32_t arbID, const uint8_t * data, uint8_t dlc, uint64_t nowNs);
+				/**
+				 * Queue a frame produced by a device.
+				 * @param source identifies the device, each source has its own transmit queue
+				 * @return 0 on success, BufferFull if that device's transmit queue is full
+				 */
+				int32_t TransmitFromDevice(uint64_t source, uint32_t arbID, const uint8_t * data, uint8_t dlc, uint64_t nowNs);
+
+				/** Run the bus up to nowNs, calling deliver for each frame as it completes. */
+				void Advance(uint64_t nowNs, const DeliverHandler & deliver);
+
+				/** @param deviceTxDropCount frames devices lost to a full transmit queue */
+				void GetStatus(float * percentBusUtilization, uint32_t * txFullCount, uint32_t * deviceTxDropCount) const;
+
+				/** Bits a frame occupies on the bus, extended ID and worst-case bit stuffing. */
+				static uint32_t FrameBits(uint8_t dlc);
+
+			private:
+				struct ByPriority {
+					bool operator()(const SimBusFrame & a, const SimBusFrame & b) const
+					{
+						if (a.arbID != b.arbID)
+							return a.arbID < b.arbID;
+						return a.seq < b.seq;
+					}
+				};
+
+				void Queue(SimBusFrame & frame, uint64_t nowNs);
+				uint64_t FrameTimeNs(uint8_t dlc) const;
+				void AccumulateBusy(uint64_t startNs, uint64_t endNs);
+
+				uint32_t _bitrate;
+				std::multiset<SimBusFrame, ByPriority> _pending;
+				std::multiset<uint64_t> _queuedTimes;	//!< queuedNs of every pending frame, so the earliest is the first
+				size_t _pendingFromRobot = 0;
+				std::map<uint64_t, size_t> _pendingFromDevice;	//!< pending frames per source
+				uint64_t _seq = 0;
+				uint64_t _busFreeNs = 0;
+
+				/* statistics */
+				uint32_t _txFullCount = 0;
+				uint32_t _deviceTxDropCount = 0;
+				bool _windowStarted = false;
+				uint64_t _windowStartNs = 0;
+				uint64_t _windowBusyNs = 0;
+				float _utilization = 0;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,171 @@
+#include "SimClock.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			SimClock::SimClock(AdvanceHandler onAdvance) :
+				_realBase(std::chrono::steady_clock::now()),
+				_realOffsetUs(0),
+				_state(std::make_shared<State>())
+			{
+				_state->onAdvance = onAdvance;
+
+				/* opt-in through the environment so CI can switch without rebuilding robot code */
+				const char * env = std::getenv("CTRE_SIM_VIRTUAL_TIME");
+				if (env != nullptr && std::strcmp(env, "0") != 0) {
+					_state->virtualNowUs = 0;
+					_state->isVirtual = true;
+				}
+			}
+
+			SimClock::~SimClock()
+			{
+				/* participants may still leave later, make sure they don't call back into our owner */
+				std::lock_guard<std::mutex> lock(_state->lck);
+				_state->onAdvance = nullptr;
+				_state->isVirtual = false;
+				_state->cv.notify_all();
+			}
+
+			uint64_t SimClock::RealNowUs() const
+			{
+				auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _realBase).count();
+				return static_cast<uint64_t>(elapsed + _realOffsetUs.load());
+			}
+
+			uint64_t SimClock::NowUs() const
+			{
+				if (_state->isVirtual)
+					return _state->virtualNowUs;
+				return RealNowUs();
+			}
+
+			void SimClock::SetVirtual(bool enable)
+			{
+				State & state = *_state;
+				std::lock_guard<std::mutex> lock(state.lck);
+
+				if (enable == state.isVirtual)
+					return;
+
+				if (enable) {
+					/* continue from the current real time so the clock stays monotonic */
+					state.virtualNowUs = RealNowUs();
+					state.isVirtual = true;
+				}
+				else {
+					/* re-base real time on the virtual time reached */
+					auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _realBase).count();
+					_realOffsetUs = static_cast<int64_t>(state.virtualNowUs.load()) - elapsed;
+					state.isVirtual = false;
+					/* release anyone waiting on virtual time */
+					state.cv.notify_all();
+				}
+			}
+
+			void SimClock::RestoreVirtual(uint64_t nowUs)
+			{
+				State & state = *_state;
+				std::lock_guard<std::mutex> lock(state.lck);
+
+				state.virtualNowUs = nowUs;
+				state.isVirtual = true;
+				state.cv.notify_all();
+			}
+
+			void SimClock::SleepUs(int timeUs)
+			{
+				State & state = *_state;
+				if (state.isVirtual == false) {
+					std::this_thread::sleep_for(std::chrono::microseconds(timeUs));
+					return;
+				}
+
+				std::unique_lock<std::mutex> lock(state.lck);
+
+				/* a thread that never attached joins on its first sleep */
+				AttachLocked();
+
+				uint64_t wake = state.virtualNowUs + static_cast<uint64_t>(timeUs > 0 ? timeUs : 0);
+				auto entry = state.wakeTimes.insert(wake);
+
+				AdvanceLocked(state);
+				state.cv.wait(lock, [&] { return state.virtualNowUs >= wake || state.isVirtual == false; });
+
+				state.wakeTimes.erase(entry);
+			}
+
+			SimClock::Participant & SimClock::ThisThread()
+			{
+				static thread_local Participant participant;
+				return participant;
+			}
+
+			void SimClock::Attach()
+			{
+				std::lock_guard<std::mutex> lock(_state->lck);
+				AttachLocked();
+			}
+
+			void SimClock::AttachLocked()
+			{
+				auto & clocks = ThisThread().clocks;
+				if (std::find(clocks.begin(), clocks.end(), _state) == clocks.end()) {
+					clocks.push_back(_state);
+					++_state->participants;
+				}
+			}
+
+			void SimClock::Detach()
+			{
+				State & state = *_state;
+				std::lock_guard<std::mutex> lock(state.lck);
+
+				auto & clocks = ThisThread().clocks;
+				auto iter = std::find(clocks.begin(), clocks.end(), _state);
+				if (iter != clocks.end()) {
+					clocks.erase(iter);
+					--state.participants;
+					/* the others may only have been waiting on us */
+					AdvanceLocked(state);
+				}
+			}
+
+			SimClock::Participant::~Participant()
+			{
+				for (auto & state : clocks) {
+					std::lock_guard<std::mutex> lock(state->lck);
+					--state->participants;
+					AdvanceLocked(*state);
+				}
+			}
+
+			void SimClock::AdvanceLocked(State & state)
+			{
+				if (state.isVirtual == false || state.wakeTimes.empty())
+					return;
+
+				/* only advance once every participant is asleep and none is already due */
+				if (static_cast<int>(state.wakeTimes.size()) < state.participants)
+					return;
+				uint64_t next = *state.wakeTimes.begin();
+				if (next <= state.virtualNowUs)
+					return;
+
+				state.virtualNowUs = next;
+
+				if (state.onAdvance)
+					state.onAdvance(next);
+
+				state.cv.notify_all();
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
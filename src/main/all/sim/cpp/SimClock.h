@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/**
+			 * Monotonic clock owned by the sim backend.
+			 *
+			 * In real-time mode (default) it follows the host's steady clock and SleepUs really sleeps.
+			 * In virtual mode the time only moves when threads call SleepUs. Threads that Attach, or failing
+			 * that sleep in virtual mode, are participants, and the clock jumps to the earliest wake time once
+			 * every participant is asleep (lockstep), never while one of them is still running.
+			 * A single-threaded caller therefore never waits at all.
+			 * Only the participants are in lockstep, devices hosted on their own thread or process are not.
+			 */
+			class SimClock
+			{
+			public:
+				/* invoked with the new time, under the clock lock, each time virtual time advances */
+				typedef std::function<void(uint64_t nowUs)> AdvanceHandler;
+
+				explicit SimClock(AdvanceHandler onAdvance);
+				~SimClock();
+
+				void SetVirtual(bool enable);
+				bool IsVirtual() const { return _state->isVirtual; }
+
+				uint64_t NowUs() const;
+				void SleepUs(int timeUs);
+
+				/**
+				 * Make the calling thread a participant until Detach or until it exits.
+				 * Attach every thread before any of them sleeps, one not attached yet doesn't hold the clock back.
+				 */
+				void Attach();
+				void Detach();
+
+				/**
+				 * Switch to virtual time and jump to nowUs, even backwards.
+				 * Sleepers keep their wake times, so callers restore while the robot threads are quiet.
+				 */
+				void RestoreVirtual(uint64_t nowUs);
+
+			private:
+				SimClock(const SimClock &) = delete;
+				SimClock & operator=(const SimClock &) = delete;
+
+				/* shared with the participating threads, which may outlive the clock */
+				struct State {
+					std::atomic<bool> isVirtual{ false };
+					std::atomic<uint64_t> virtualNowUs{ 0 };
+
+					/* lockstep state */
+					std::mutex lck;
+					std::condition_variable cv;
+					std::multiset<uint64_t> wakeTimes;
+					int participants = 0;
+					AdvanceHandler onAdvance;	//!< cleared when the clock is destroyed
+				};
+
+				/* deregisters the owning thread from every clock it is attached to when it exits */
+				struct Participant {
+					std::vector<std::shared_ptr<State>> clocks;
+					~Participant();
+				};
+				static Participant & ThisThread();
+
+				uint64_t RealNowUs() const;
+				void AttachLocked();
+				static void AdvanceLocked(State & state);
+
+				/* real-time mode reports time since _realBase plus _realOffsetUs */
+				const std::chrono::steady_clock::time_point _realBase;
+				std::atomic<int64_t> _realOffsetUs;
+
+				const std::shared_ptr<State> _state;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
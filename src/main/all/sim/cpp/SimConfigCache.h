@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/**
+			 * Last known configuration of one device, keyed by (param, ordinal).
+			 * Only used to skip sets that would not change anything, reads always go to the adapter.
+			 * Not thread safe, the caller serializes access.
+			 */
+			class SimConfigCache
+			{
+			public:
+				/** @return true if the parameter is known to already hold this value */
+				bool Holds(uint32_t param, uint32_t ordinal, uint32_t value, uint32_t subValue) const
+				{
+					auto iter = _values.find(Key(param, ordinal));
+					return iter != _values.end() && iter->second.value == value && iter->second.subValue == subValue;
+				}
+
+				void Store(uint32_t param, uint32_t ordinal, uint32_t value, uint32_t subValue)
+				{
+					Entry & entry = _values[Key(param, ordinal)];
+					entry.value = value;
+					entry.subValue = subValue;
+				}
+
+				/** Forget everything, e.g. after the device was configured behind our back. */
+				void Clear() { _values.clear(); }
+
+			private:
+				struct Entry {
+					uint32_t value;
+					uint32_t subValue;
+				};
+
+				static uint64_t Key(uint32_t param, uint32_t ordinal)
+				{
+					return (static_cast<uint64_t>(param) << 32) | ordinal;
+				}
+
+				std::unordered_map<uint64_t, Entry> _values;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
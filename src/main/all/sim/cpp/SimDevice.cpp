@@ -0,0 +1,255 @@
+#include "SimDevice.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#include <utility>
+#include <vector>
+
+#define CTRE_CREATE_EXPORTS // we need typedefs, not proto's
+#include "SimulationAdapter.h"
+#include "ctre/phoenix/platform/SimulationAdapterExt.h"
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			class LocalSimDevice : public SimDevice
+			{
+			public:
+				LocalSimDevice(std::unique_ptr<runtime::LibLoader> lib, SimDeviceProfile * profile) :
+					_lib(std::move(lib)),
+					_profile(profile ? profile : &_ownProfile)
+				{
+				}
+
+				int32_t Start(int id) override
+				{
+					try
+					{
+						/* resolve everything once, not per frame */
+						_start = LIBLOADER_LOOKUP(*_lib, ctre_phoenix_simulation_adapter_Start);
+						_sendV1 = LIBLOADER_LOOKUP(*_lib, ctre_phoenix_simulation_adapter_SendCANFrame);
+						_receiveV1 = LIBLOADER_LOOKUP(*_lib, ctre_phoenix_simulation_adapter_ReceiveCANFrame);
+					}
+					catch (const runtime::LibLoaderException & excep)
+					{
+						/* DLL was good but func is missing? */
+						return excep.GetPhoenixErrorCode();
+					}
+
+					/* optional entry points, older adapters won't have them */
+					_setTime = LookupOptional<ctre_phoenix_simulation_adapter_SetTime_t>("ctre_phoenix_simulation_adapter_SetTime");
+					_sendV2 = LookupOptional<ctre_phoenix_simulation_adapter_SendCANFrames_t>("ctre_phoenix_simulation_adapter_SendCANFrames");
+					_receiveV2 = LookupOptional<ctre_phoenix_simulation_adapter_ReceiveCANFrames_t>("ctre_phoenix_simulation_adapter_ReceiveCANFrames");
+					_pending = LookupOptional<ctre_phoenix_simulation_adapter_GetPendingFrameCount_t>("ctre_phoenix_simulation_adapter_GetPendingFrameCount");
+					_configSet = LookupOptional<ctre_phoenix_simulation_adapter_ConfigSet_t>("ctre_phoenix_simulation_adapter_ConfigSet");
+					_configGet = LookupOptional<ctre_phoenix_simulation_adapter_ConfigGet_t>("ctre_phoenix_simulation_adapter_ConfigGet");
+					_configSetBatch = LookupOptional<ctre_phoenix_simulation_adapter_ConfigSetBatch_t>("ctre_phoenix_simulation_adapter_ConfigSetBatch");
+					_saveState = LookupOptional<ctre_phoenix_simulation_adapter_SaveState_t>("ctre_phoenix_simulation_adapter_SaveState");
+					_loadState = LookupOptional<ctre_phoenix_simulation_adapter_LoadState_t>("ctre_phoenix_simulation_adapter_LoadState");
+					_reset = LookupOptional<ctre_phoenix_simulation_adapter_Reset_t>("ctre_phoenix_simulation_adapter_Reset");
+
+					/* state hooks are only useful as a pair */
+					if (_saveState == nullptr || _loadState == nullptr) {
+						_saveState = nullptr;
+						_loadState = nullptr;
+					}
+
+					/* v2 is all or nothing for the batch calls */
+					if (_sendV2 == nullptr || _receiveV2 == nullptr) {
+						_sendV2 = nullptr;
+						_receiveV2 = nullptr;
+					}
+
+					/* call our first routine from the loaded resource*/
+					SimCallTimer timer(_profile->other);
+					return _start(id);
+				}
+
+				void Send(const SimFrame * frames, uint32_t count) override
+				{
+					SimCallTimer timer(_profile->send);
+					_profile->framesToDevice.store(_profile->framesToDevice.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+
+					/* nothing to report errors to, the sender has moved on */
+					if (_sendV2) {
+						(void)_sendV2(frames, count);
+						return;
+					}
+					for (uint32_t i = 0; i < count; ++i) {
+						(void)_sendV1(frames[i].arbID, frames[i].data, frames[i].dlc);
+					}
+				}
+
+				int32_t Receive(SimFrame * frames, uint32_t capacity, uint32_t & numberFilled) override
+				{
+					SimCallTimer timer(_profile->receive);
+					numberFilled = 0;
+					int32_t err = ReceiveFromAdapter(frames, capacity, numberFilled);
+					_profile->framesFromDevice.store(_profile->framesFromDevice.load(std::memory_order_relaxed) + numberFilled, std::memory_order_relaxed);
+					return err;
+				}
+
+				void SetTime(uint64_t nowUs) override
+				{
+					if (_setTime) {
+						SimCallTimer timer(_profile->setTime);
+						(void)_setTime(nowUs);
+					}
+				}
+
+				int32_t ConfigSet(const SimConfigParam * params, uint32_t count) override
+				{
+					if (_configSetBatch == nullptr && _configSet == nullptr)
+						return ErrorCode::FeatureNotSupported;
+					SimCallTimer timer(_profile->other);
+
+					if (_configSetBatch) {
+						std::vector<ctre_phoenix_simulation_config_t> batch(count);
+						for (uint32_t i = 0; i < count; ++i) {
+							batch[i].param = params[i].param;
+							batch[i].value = params[i].value;
+							batch[i].subValue = params[i].subValue;
+							batch[i].ordinal = params[i].ordinal;
+						}
+						return _configSetBatch(batch.data(), count);
+					}
+
+					for (uint32_t i = 0; i < count; ++i) {
+						int32_t err = _configSet(params[i].param, params[i].value, params[i].subValue, params[i].ordinal);
+						if (err != 0)
+							return err;
+					}
+					return ErrorCode::OK;
+				}
+
+				int32_t ConfigGet(SimConfigParam & param, uint32_t valueToSend) override
+				{
+					if (_configGet == nullptr)
+						return ErrorCode::FeatureNotSupported;
+					SimCallTimer timer(_profile->other);
+					return _configGet(param.param, valueToSend, &param.value, &param.subValue, param.ordinal);
+				}
+
+				int32_t SaveState(std::vector<uint8_t> & state) override
+				{
+					state.clear();
+					if (_saveState == nullptr)
+						return ErrorCode::FeatureNotSupported;
+					SimCallTimer timer(_profile->other);
+
+					/* ask for the size first, then fill */
+					uint32_t size = 0;
+					int32_t err = _saveState(nullptr, 0, &size);
+					if (err != 0)
+						return err;
+					state.resize(size);
+
+					uint32_t filled = 0;
+					err = _saveState(state.data(), size, &filled);
+					if (err == 0 && filled > size)
+						err = ErrorCode::BufferFull;
+					if (err != 0) {
+						state.clear();
+						return err;
+					}
+					state.resize(filled);
+					return ErrorCode::OK;
+				}
+
+				int32_t LoadState(const std::vector<uint8_t> & state) override
+				{
+					if (_loadState == nullptr)
+						return ErrorCode::FeatureNotSupported;
+					SimCallTimer timer(_profile->other);
+					return _loadState(state.data(), static_cast<uint32_t>(state.size()));
+				}
+
+				int32_t Reset(int id) override
+				{
+					SimCallTimer timer(_profile->other);
+					if (_reset)
+						return _reset();
+					return _start(id);
+				}
+
+				SimDeviceProfile & Profile() override { return *_profile; }
+
+			private:
+				/* numberFilled starts at 0 */
+				int32_t ReceiveFromAdapter(SimFrame * frames, uint32_t capacity, uint32_t & numberFilled)
+				{
+					/* skip devices that have nothing, and don't ask for more than they have */
+					if (_pending) {
+						uint32_t pending = 0;
+						int32_t err = _pending(&pending);
+						if (err != 0)
+							return err;
+						if (pending == 0)
+							return ErrorCode::RxTimeout;
+						if (pending < capacity)
+							capacity = pending;
+					}
+
+					if (_receiveV2) {
+						int32_t err = _receiveV2(frames, capacity, &numberFilled);
+						if (numberFilled > capacity) { numberFilled = capacity; }
+						if (err != 0)
+							return err;
+						return numberFilled > 0 ? ErrorCode::OK : ErrorCode::RxTimeout;
+					}
+
+					int32_t err = 0;
+					while (numberFilled < capacity) {
+						SimFrame & frame = frames[numberFilled];
+						err = _receiveV1(&frame.arbID, frame.data, &frame.dlc);
+						if (err != 0)
+							break;
+						++numberFilled;
+					}
+					return numberFilled > 0 ? ErrorCode::OK : err;
+				}
+
+				template <typename T>
+				T LookupOptional(const char * name)
+				{
+					try
+					{
+						return _lib->LookupFunc<T>(name);
+					}
+					catch (const runtime::LibLoaderException &)
+					{
+						return nullptr;
+					}
+				}
+
+				std::unique_ptr<runtime::LibLoader> _lib;
+
+				SimDeviceProfile _ownProfile;
+				SimDeviceProfile * const _profile;	//!< _ownProfile unless the host keeps the counters elsewhere
+
+				/* v1 entry points, required */
+				decltype(LIBLOADER_LOOKUP(std::declval<runtime::LibLoader &>(), ctre_phoenix_simulation_adapter_Start)) _start = nullptr;
+				decltype(LIBLOADER_LOOKUP(std::declval<runtime::LibLoader &>(), ctre_phoenix_simulation_adapter_SendCANFrame)) _sendV1 = nullptr;
+				decltype(LIBLOADER_LOOKUP(std::declval<runtime::LibLoader &>(), ctre_phoenix_simulation_adapter_ReceiveCANFrame)) _receiveV1 = nullptr;
+
+				/* optional entry points */
+				ctre_phoenix_simulation_adapter_SetTime_t _setTime = nullptr;
+				ctre_phoenix_simulation_adapter_SendCANFrames_t _sendV2 = nullptr;
+				ctre_phoenix_simulation_adapter_ReceiveCANFrames_t _receiveV2 = nullptr;
+				ctre_phoenix_simulation_adapter_GetPendingFrameCount_t _pending = nullptr;
+				ctre_phoenix_simulation_adapter_ConfigSet_t _configSet = nullptr;
+				ctre_phoenix_simulation_adapter_ConfigGet_t _configGet = nullptr;
+				ctre_phoenix_simulation_adapter_ConfigSetBatch_t _configSetBatch = nullptr;
+				ctre_phoenix_simulation_adapter_SaveState_t _saveState = nullptr;
+				ctre_phoenix_simulation_adapter_LoadState_t _loadState = nullptr;
+				ctre_phoenix_simulation_adapter_Reset_t _reset = nullptr;
+			};
+
+			std::unique_ptr<SimDevice> CreateLocalSimDevice(std::unique_ptr<runtime::LibLoader> lib, SimDeviceProfile * profile)
+			{
+				return std::unique_ptr<SimDevice>(new LocalSimDevice(std::move(lib), profile));
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "ctre/phoenix/runtime/LibLoader.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "ctre/phoenix/platform/SimulationAdapterExt.h"
+#include "SimConfigCache.h"
+#include "SimProfile.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			typedef ctre_phoenix_simulation_frame_t SimFrame;
+
+			/**
+			 * One simulated device, i.e. one loaded adapter library.
+			 * The sim serializes all calls into a device, config calls excepted if SerializesConfig says so.
+			 */
+			class SimDevice
+			{
+			public:
+				virtual ~SimDevice() {}
+
+				/** Run the adapter's start routine. @return 0 on success */
+				virtual int32_t Start(int id) = 0;
+				/** Hand frames from the robot to the device. */
+				virtual void Send(const SimFrame * frames, uint32_t count) = 0;
+				/**
+				 * Take the frames the device has ready.
+				 * @return 0 if at least one frame was filled, otherwise the adapter's reason for having none
+				 */
+				virtual int32_t Receive(SimFrame * frames, uint32_t capacity, uint32_t & numberFilled) = 0;
+				/** Tell the device the virtual clock moved. */
+				virtual void SetTime(uint64_t nowUs) = 0;
+				/**
+				 * Apply configuration parameters through the adapter.
+				 * @return 0 on success, FeatureNotSupported if the adapter has no config exports
+				 */
+				virtual int32_t ConfigSet(const SimConfigParam * params, uint32_t count) = 0;
+				/**
+				 * Read one configuration parameter through the adapter.
+				 * param.param and param.ordinal select it, value and subValue are filled.
+				 * @return 0 on success, FeatureNotSupported if the adapter has no config exports
+				 */
+				virtual int32_t ConfigGet(SimConfigParam & param, uint32_t valueToSend) = 0;
+				/**
+				 * @return true if the device serializes config calls with its other calls itself,
+				 * so the world need not hold its lock while one waits for the adapter
+				 */
+				virtual bool SerializesConfig() const { return false; }
+
+				/**
+				 * Serialize the adapter's state.
+				 * @return 0 on success, FeatureNotSupported if the adapter has no state hooks
+				 */
+				virtual int32_t SaveState(std::vector<uint8_t> & state) = 0;
+				/** Restore state from SaveState, dropping frames still in flight. @return 0 on success */
+				virtual int32_t LoadState(const std::vector<uint8_t> & state) = 0;
+				/**
+				 * Put the adapter back in its just-started state, dropping frames still in flight.
+				 * Uses the adapter's reset hook if it has one, otherwise runs its start routine again.
+				 * @return 0 on success
+				 */
+				virtual int32_t Reset(int id) = 0;
+
+				/** Time spent in this device's adapter, wherever it runs. */
+				virtual SimDeviceProfile & Profile() = 0;
+
+				/** Configuration last applied to or read from this device. */
+				SimConfigCache & ConfigCache() { return _configCache; }
+
+				/** Set once by the world that adds the device, tells a re-created device with the same type and ID apart. */
+				uint64_t Generation() const { return _generation; }
+				void SetGeneration(uint64_t generation) { _generation = generation; }
+
+				/** Collect a frame for the next FlushSends, so a device gets one Send per pump. */
+				void QueueSend(const SimFrame & frame) { _pendingSend.push_back(frame); }
+				void FlushSends()
+				{
+					if (_pendingSend.empty() == false) {
+						Send(_pendingSend.data(), static_cast<uint32_t>(_pendingSend.size()));
+						_pendingSend.clear();
+					}
+				}
+
+			private:
+				std::vector<SimFrame> _pendingSend;
+				SimConfigCache _configCache;
+				uint64_t _generation = 0;
+			};
+
+			/**
+			 * Device whose adapter is called directly on the caller's thread.
+			 * Entry points are resolved once at start, and v2 batch exports are used when present.
+			 *
+			 * @param profile where to count adapter calls, nullptr to keep the counters in the device
+			 */
+			std::unique_ptr<SimDevice> CreateLocalSimDevice(std::unique_ptr<runtime::LibLoader> lib, SimDeviceProfile * profile = nullptr);
+
+			/**
+			 * Device whose adapter runs on its own worker thread, fed through lock-free mailboxes.
+			 * Send and receive only touch the mailboxes, so devices run concurrently on multiple cores.
+			 */
+			std::unique_ptr<SimDevice> CreateThreadSimDevice(std::unique_ptr<runtime::LibLoader> lib);
+
+			/**
+			 * Device whose adapter runs in its own host process, exchanging frames through
+			 * shared-memory rings. A crash or hang in the adapter cannot take the robot process down.
+			 * Start execs the host executable, which loads the library itself, the robot process never does.
+			 *
+			 * @param libPath adapter library for the host to load
+			 * @return nullptr if the OS does not support it
+			 */
+			std::unique_ptr<SimDevice> CreateProcessSimDevice(const std::string & libPath);
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
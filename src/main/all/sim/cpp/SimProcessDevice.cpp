@@ -0,0 +1,324 @@
+#include "SimDevice.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#if defined(__linux__)
+
+#include "SimShm.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream> // std::cout
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			namespace {
+				/* how long SimCreate waits for the host's start routine */
+				const auto kStartTimeout = std::chrono::seconds(5);
+				/* how often the robot side checks the host is still alive */
+				const auto kLivenessPeriod = std::chrono::milliseconds(100);
+				/* how long a config call waits for the host */
+				const auto kConfigTimeout = std::chrono::seconds(1);
+
+				const char * const kHostName = "CTRE_PhoenixPlatform_simhost";
+
+				/* CTRE_SIM_HOST_PATH if set, otherwise the host next to this library */
+				std::string GetHostPath()
+				{
+					const char * env = std::getenv("CTRE_SIM_HOST_PATH");
+					if (env != nullptr)
+						return env;
+
+					std::string path = kHostName;
+					Dl_info info;
+					if (dladdr(reinterpret_cast<void *>(&CreateProcessSimDevice), &info) != 0 && info.dli_fname != nullptr) {
+						std::string self = info.dli_fname;
+						size_t slash = self.find_last_of('/');
+						if (slash != std::string::npos)
+							path = self.substr(0, slash + 1) + kHostName;
+					}
+					return path;
+				}
+			}
+
+			class ProcessSimDevice : public SimDevice
+			{
+			public:
+				explicit ProcessSimDevice(const std::string & libPath) :
+					_libPath(libPath)
+				{
+					/* a memfd rather than an anonymous mapping, so the host can map it after exec */
+					_shmFd = memfd_create("ctre_sim_device", MFD_CLOEXEC);
+					if (_shmFd >= 0 && ftruncate(_shmFd, sizeof(SimShmChannel)) == 0) {
+						void * mem = mmap(nullptr, sizeof(SimShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, _shmFd, 0);
+						if (mem != MAP_FAILED) {
+							_shm = new (mem) SimShmChannel();
+						}
+					}
+					_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+					_configDoneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				}
+
+				~ProcessSimDevice()
+				{
+					if (_pid > 0) {
+						/* ask nicely, then insist */
+						_shm->stop = 1;
+						Wake();
+						auto deadline = std::chrono::steady_clock::now() + kLivenessPeriod;
+						while (waitpid(_pid, nullptr, WNOHANG) == 0) {
+							if (std::chrono::steady_clock::now() > deadline) {
+								kill(_pid, SIGKILL);
+								(void)waitpid(_pid, nullptr, 0);
+								break;
+							}
+							std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						}
+					}
+					if (_shm) {
+						_shm->~SimShmChannel();
+						munmap(_shm, sizeof(SimShmChannel));
+					}
+					if (_shmFd >= 0) { close(_shmFd); }
+					if (_wakeFd >= 0) { close(_wakeFd); }
+					if (_configDoneFd >= 0) { close(_configDoneFd); }
+				}
+
+				int32_t Start(int id) override
+				{
+					if (_shm == nullptr || _wakeFd < 0 || _configDoneFd < 0)
+						return ErrorCode::ResourceNotAvailable;
+
+					/* everything the child needs is built before fork, it may only make async-signal-safe calls */
+					std::string hostPath = GetHostPath();
+					std::string args[] = { hostPath, _libPath, std::to_string(id), std::to_string(_shmFd), std::to_string(_wakeFd), std::to_string(_configDoneFd) };
+					std::vector<char *> argv;
+					for (std::string & arg : args) { argv.push_back(&arg[0]); }
+					argv.push_back(nullptr);
+					pid_t parent = getpid();
+
+					_pid = fork();
+					if (_pid < 0)
+						return ErrorCode::ResourceNotAvailable;
+
+					if (_pid == 0) {
+						/* don't outlive the robot process, and make sure it didn't die before we asked */
+						(void)prctl(PR_SET_PDEATHSIG, SIGKILL);
+						if (getppid() != parent) { _exit(0); }
+						/* the host inherits the channel and the two wake-up fds, nothing else */
+						(void)fcntl(_shmFd, F_SETFD, 0);
+						(void)fcntl(_wakeFd, F_SETFD, 0);
+						(void)fcntl(_configDoneFd, F_SETFD, 0);
+						execv(argv[0], argv.data());
+						_exit(127);
+					}
+
+					/* wait for the host to report how its start routine went */
+					auto deadline = std::chrono::steady_clock::now() + kStartTimeout;
+					while (_shm->startResult == SimShmChannel::kStartPending) {
+						if (CheckAlive() == false || std::chrono::steady_clock::now() > deadline) {
+							return ErrorCode::GeneralError;
+						}
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+					}
+					return _shm->startResult;
+				}
+
+				void Send(const SimFrame * frames, uint32_t count) override
+				{
+					/* a host that can't keep up loses frames, like a device with a full rx fifo */
+					(void)_shm->toDevice.PushBulk(frames, count);
+					/* pairs with the fence in the host's loop, either we see it asleep or it sees the frames */
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (_shm->workerSleeping) { Wake(); }
+				}
+
+				int32_t Receive(SimFrame * frames, uint32_t capacity, uint32_t & numberFilled) override
+				{
+					numberFilled = _shm->fromDevice.PopBulk(frames, capacity);
+					if (numberFilled > 0)
+						return ErrorCode::OK;
+
+					/* nothing waiting, make sure that's not because the host died */
+					auto now = std::chrono::steady_clock::now();
+					if (now - _lastLivenessCheck >= kLivenessPeriod) {
+						_lastLivenessCheck = now;
+						(void)CheckAlive();
+					}
+					return _pid > 0 ? ErrorCode::RxTimeout : ErrorCode::ResourceNotAvailable;
+				}
+
+				void SetTime(uint64_t nowUs) override
+				{
+					_shm->timeUs = nowUs;
+					Wake();
+				}
+
+				int32_t ConfigSet(const SimConfigParam * params, uint32_t count) override
+				{
+					/* large sets go over in slot-sized chunks */
+					while (count > 0) {
+						uint32_t chunk = count < SimShmConfigCall::kMaxParams ? count : SimShmConfigCall::kMaxParams;
+						int32_t err = CallConfig(params, chunk, 0, nullptr);
+						if (err != 0)
+							return err;
+						params += chunk;
+						count -= chunk;
+					}
+					return ErrorCode::OK;
+				}
+
+				int32_t ConfigGet(SimConfigParam & param, uint32_t valueToSend) override
+				{
+					return CallConfig(&param, 1, valueToSend, &param);
+				}
+
+				/* the host runs config between its own frame batches, and the call slot has its own lock */
+				bool SerializesConfig() const override { return true; }
+
+				/* adapter state lives in the host process, snapshots are not supported there yet */
+				int32_t SaveState(std::vector<uint8_t> & state) override
+				{
+					state.clear();
+					return ErrorCode::FeatureNotSupported;
+				}
+
+				int32_t LoadState(const std::vector<uint8_t> & /*state*/) override
+				{
+					return ErrorCode::FeatureNotSupported;
+				}
+
+				int32_t Reset(int /*id*/) override
+				{
+					return ErrorCode::FeatureNotSupported;
+				}
+
+				SimDeviceProfile & Profile() override { return _shm->profile; }
+
+			private:
+				void Wake()
+				{
+					uint64_t one = 1;
+					(void)write(_wakeFd, &one, sizeof(one));
+				}
+
+				/* hand a config request to the host and wait for its answer, a get fills readBack */
+				int32_t CallConfig(const SimConfigParam * params, uint32_t count, uint32_t valueToSend, SimConfigParam * readBack)
+				{
+					std::lock_guard<std::mutex> lock(_configLck);
+					SimShmConfigCall & call = _shm->config;
+
+					/* the answer to a call we gave up on, nobody wants it */
+					uint32_t done = SimShmConfigCall::kDone;
+					(void)call.state.compare_exchange_strong(done, SimShmConfigCall::kIdle);
+					/* still running one we gave up on, the adapter is stuck */
+					if (_pid <= 0 || call.state != SimShmConfigCall::kIdle)
+						return ErrorCode::ResourceNotAvailable;
+
+					uint64_t drained;
+					(void)read(_configDoneFd, &drained, sizeof(drained));
+
+					call.isGet = readBack ? 1 : 0;
+					call.valueToSend = valueToSend;
+					call.count = count;
+					for (uint32_t i = 0; i < count; ++i) {
+						call.params[i] = params[i];
+					}
+					call.state = SimShmConfigCall::kPending;
+					Wake();
+
+					/* the host signals _configDoneFd once it is done, look in on it while we wait */
+					auto deadline = std::chrono::steady_clock::now() + kConfigTimeout;
+					while (call.state != SimShmConfigCall::kDone) {
+						if (CheckAlive() == false)
+							return ErrorCode::ResourceNotAvailable;
+						auto now = std::chrono::steady_clock::now();
+						if (now > deadline) {
+							/* take the call back if the host never picked it up, otherwise it finishes unobserved */
+							uint32_t pending = SimShmConfigCall::kPending;
+							(void)call.state.compare_exchange_strong(pending, SimShmConfigCall::kIdle);
+							return ErrorCode::RxTimeout;
+						}
+						auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now) + std::chrono::milliseconds(1);
+						if (wait > kLivenessPeriod) { wait = kLivenessPeriod; }
+						struct pollfd pfd = { _configDoneFd, POLLIN, 0 };
+						(void)poll(&pfd, 1, static_cast<int>(wait.count()));
+						(void)read(_configDoneFd, &drained, sizeof(drained));
+					}
+
+					if (readBack) { *readBack = call.params[0]; }
+					int32_t result = call.result;
+					call.state = SimShmConfigCall::kIdle;
+					return result;
+				}
+
+				bool CheckAlive()
+				{
+					if (_pid <= 0)
+						return false;
+					int status = 0;
+					if (waitpid(_pid, &status, WNOHANG) == _pid) {
+						std::cout << "Simulated device host " << _pid << " exited";
+						if (WIFSIGNALED(status)) { std::cout << " on signal " << WTERMSIG(status); }
+						/* 127 is the host executable not being found, see CTRE_SIM_HOST_PATH */
+						if (WIFEXITED(status)) { std::cout << " with status " << WEXITSTATUS(status); }
+						std::cout << std::endl;
+						_pid = -1;
+						return false;
+					}
+					return true;
+				}
+
+				std::string _libPath;	//!< adapter library, loaded by the host only
+				SimShmChannel * _shm = nullptr;
+				int _shmFd = -1;
+				int _wakeFd = -1;
+				int _configDoneFd = -1;	//!< signalled by the host when a config call is done
+				std::mutex _configLck;	//!< one config call in the slot at a time
+				pid_t _pid = -1;
+				std::chrono::steady_clock::time_point _lastLivenessCheck;
+			};
+
+			std::unique_ptr<SimDevice> CreateProcessSimDevice(const std::string & libPath)
+			{
+				return std::unique_ptr<SimDevice>(new ProcessSimDevice(libPath));
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
+
+#else
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			std::unique_ptr<SimDevice> CreateProcessSimDevice(const std::string & /*libPath*/)
+			{
+				/* needs memfd and eventfd, only done for Linux so far */
+				return nullptr;
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
+
+#endif
@@ -0,0 +1,41 @@
+#include "SimProfile.h"
+
+#include <thread>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+#if defined(SIM_HAS_TSC)
+			namespace {
+				/* TSC ticks per ns, measured against the steady clock over a short window */
+				double CalibrateTicksPerNs()
+				{
+					auto wallStart = std::chrono::steady_clock::now();
+					uint64_t tickStart = SimReadTicks();
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					uint64_t tickEnd = SimReadTicks();
+					auto wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wallStart).count();
+
+					if (wallNs <= 0 || tickEnd <= tickStart)
+						return 1.0;
+					return static_cast<double>(tickEnd - tickStart) / static_cast<double>(wallNs);
+				}
+			}
+
+			uint64_t SimTicksToNs(uint64_t ticks)
+			{
+				static const double ticksPerNs = CalibrateTicksPerNs();
+				return static_cast<uint64_t>(static_cast<double>(ticks) / ticksPerNs);
+			}
+#else
+			uint64_t SimTicksToNs(uint64_t ticks)
+			{
+				/* ticks are already steady clock ns */
+				return ticks;
+			}
+#endif
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SIM_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define SIM_HAS_TSC 1
+#endif
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** Cheap timestamp for profiling, the TSC where there is one, otherwise steady clock ns. */
+			inline uint64_t SimReadTicks()
+			{
+#if defined(SIM_HAS_TSC)
+				return __rdtsc();
+#else
+				return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+			}
+
+			/** Convert a SimReadTicks difference to ns, the TSC rate is calibrated on first use. */
+			uint64_t SimTicksToNs(uint64_t ticks);
+
+			/**
+			 * Counters for one kind of adapter call.
+			 * Each device has one writer at a time, so updates are plain relaxed loads and stores.
+			 * Lock free, so it can live in memory shared with a worker process.
+			 */
+			struct SimCallCounters {
+				std::atomic<uint64_t> calls{ 0 };
+				std::atomic<uint64_t> ticks{ 0 };
+				std::atomic<uint64_t> maxTicks{ 0 };
+
+				void Add(uint64_t elapsed)
+				{
+					calls.store(calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					ticks.store(ticks.load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+					if (elapsed > maxTicks.load(std::memory_order_relaxed))
+						maxTicks.store(elapsed, std::memory_order_relaxed);
+				}
+				void Reset()
+				{
+					calls = 0;
+					ticks = 0;
+					maxTicks = 0;
+				}
+			};
+
+			/** Where one device's adapter spends its time */
+			struct SimDeviceProfile {
+				SimCallCounters send;	//!< frames handed to the adapter
+				SimCallCounters receive;	//!< adapter polled for frames
+				SimCallCounters setTime;	//!< virtual clock updates
+				SimCallCounters other;	//!< start, config, state and reset calls
+				std::atomic<uint64_t> framesToDevice{ 0 };
+				std::atomic<uint64_t> framesFromDevice{ 0 };
+
+				void Reset()
+				{
+					send.Reset();
+					receive.Reset();
+					setTime.Reset();
+					other.Reset();
+					framesToDevice = 0;
+					framesFromDevice = 0;
+				}
+			};
+
+			/** Times one adapter call into a set of counters. */
+			class SimCallTimer
+			{
+			public:
+				explicit SimCallTimer(SimCallCounters & counters) : _counters(counters), _start(SimReadTicks()) {}
+				~SimCallTimer() { _counters.Add(SimReadTicks() - _start); }
+
+			private:
+				SimCallTimer(const SimCallTimer &) = delete;
+				SimCallTimer & operator=(const SimCallTimer &) = delete;
+
+				SimCallCounters & _counters;
+				const uint64_t _start;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
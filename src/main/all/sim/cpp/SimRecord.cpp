@@ -0,0 +1,88 @@
+#include "SimRecord.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#include <cstring>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			namespace {
+				const char kMagic[8] = { 'C', 'T', 'R', 'E', 'S', 'I', 'M', 'R' };
+				const uint32_t kVersion = 1;
+
+				struct SimRecordHeader {
+					char magic[8];
+					uint32_t version;
+					uint32_t reserved;
+					uint64_t startNs;
+				};
+				static_assert(sizeof(SimRecordHeader) == 24, "SimRecordHeader is a file format");
+			}
+
+			int32_t SimRecordWriter::Open(const std::string & path, uint64_t startNs)
+			{
+				Close();
+
+				_file.open(path, std::ios::binary | std::ios::trunc);
+				if (false == _file.is_open())
+					return ErrorCode::GeneralError;
+
+				SimRecordHeader header = {};
+				std::memcpy(header.magic, kMagic, sizeof(kMagic));
+				header.version = kVersion;
+				header.startNs = startNs;
+				_file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+				return ErrorCode::OK;
+			}
+
+			void SimRecordWriter::Close()
+			{
+				if (_file.is_open()) {
+					_file.close();
+				}
+			}
+
+			void SimRecordWriter::Write(const SimRecord & record)
+			{
+				/* ofstream buffers, so this is a memcpy most of the time */
+				_file.write(reinterpret_cast<const char *>(&record), sizeof(record));
+			}
+
+			int32_t SimRecordReader::Open(const std::string & path)
+			{
+				Close();
+
+				std::ifstream file(path, std::ios::binary);
+				if (false == file.is_open())
+					return ErrorCode::GeneralError;
+
+				SimRecordHeader header = {};
+				file.read(reinterpret_cast<char *>(&header), sizeof(header));
+				if (file.gcount() != sizeof(header) || std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion)
+					return ErrorCode::InvalidParamValue;
+				_startNs = header.startNs;
+
+				/* read in chunks, a truncated last record is dropped */
+				SimRecord chunk[256];
+				while (file) {
+					file.read(reinterpret_cast<char *>(chunk), sizeof(chunk));
+					size_t count = static_cast<size_t>(file.gcount()) / sizeof(SimRecord);
+					_records.insert(_records.end(), chunk, chunk + count);
+				}
+
+				_open = true;
+				return ErrorCode::OK;
+			}
+
+			void SimRecordReader::Close()
+			{
+				_open = false;
+				_startNs = 0;
+				_records.clear();
+				_next = 0;
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
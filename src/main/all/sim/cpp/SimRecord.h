@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/**
+			 * One frame in a sim bus log.
+			 *
+			 * A log is a 24-byte header (the magic "CTRESIMR", a uint32 version, a reserved uint32 and the
+			 * uint64 sim time recording started at in ns) followed by these 24-byte records in delivery order,
+			 * all in host byte order.
+			 */
+			struct SimRecord {
+				static const uint8_t kToDevice = 0;	//!< sent by the robot
+				static const uint8_t kToRobot = 1;	//!< sent by a device
+
+				uint64_t timeNs;	//!< when the frame came off the bus, sim time
+				uint32_t arbID;
+				uint8_t dlc;
+				uint8_t direction;
+				uint8_t reserved[2];
+				uint8_t data[8];
+			};
+			static_assert(sizeof(SimRecord) == 24, "SimRecord is a file format");
+
+			/** Appends records to a log file. */
+			class SimRecordWriter
+			{
+			public:
+				/** @return 0 on success, GeneralError if the file can't be created */
+				int32_t Open(const std::string & path, uint64_t startNs);
+				void Close();
+				bool IsOpen() const { return _file.is_open(); }
+
+				void Write(const SimRecord & record);
+
+			private:
+				std::ofstream _file;
+			};
+
+			/** Reads a whole log into memory and hands out its records in order. */
+			class SimRecordReader
+			{
+			public:
+				/** @return 0 on success, GeneralError if the file can't be read, InvalidParamValue if it is not a log */
+				int32_t Open(const std::string & path);
+				void Close();
+				bool IsOpen() const { return _open; }
+				/** sim time the recording started at */
+				uint64_t StartNs() const { return _startNs; }
+
+				/** @return next record without consuming it, nullptr at the end of the log */
+				const SimRecord * Peek() const { return _next < _records.size() ? &_records[_next] : nullptr; }
+				void Pop() { ++_next; }
+
+			private:
+				bool _open = false;
+				uint64_t _startNs = 0;
+				std::vector<SimRecord> _records;
+				size_t _next = 0;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
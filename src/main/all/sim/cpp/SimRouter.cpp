@@ -0,0 +1,52 @@
+#include "SimRouter.h"
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			bool SimRouter::IsBroadcast(uint32_t arbID)
+			{
+				/* device number 63 addresses every device of a type, device type 0 is the FRC broadcast class */
+				if ((arbID & kDeviceNumberMask) == kDeviceNumberMask)
+					return true;
+				if ((arbID & kDeviceTypeMask) == 0)
+					return true;
+				return false;
+			}
+
+			void SimRouter::Learn(uint32_t arbID, SimDevice * device)
+			{
+				if (IsBroadcast(arbID))
+					return;
+
+				auto result = _index.insert(std::make_pair(AddressOf(arbID), device));
+				if (result.second == false && result.first->second != device) {
+					/* two devices share an address, fall back to broadcast for it */
+					result.first->second = nullptr;
+				}
+			}
+
+			SimDevice * SimRouter::Route(uint32_t arbID) const
+			{
+				if (IsBroadcast(arbID))
+					return nullptr;
+
+				auto iter = _index.find(AddressOf(arbID));
+				if (iter == _index.end())
+					return nullptr;
+				return iter->second;
+			}
+
+			void SimRouter::Forget(SimDevice * device)
+			{
+				for (auto iter = _index.begin(); iter != _index.end();) {
+					if (iter->second == device)
+						iter = _index.erase(iter);
+					else
+						++iter;
+				}
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			class SimDevice;
+
+			/**
+			 * Routes robot frames to the one sim device they are addressed to.
+			 *
+			 * A CTRE arbitration ID carries the device type (bits 28:24), manufacturer (bits 23:16)
+			 * and device number (bits 5:0). The router learns which device owns an address from the
+			 * frames each device sends, so no per-product ID table is needed. Frames to device number 63,
+			 * to the broadcast device type, or to an address not learned yet go to every device.
+			 *
+			 * Not thread safe, the caller serializes access.
+			 */
+			class SimRouter
+			{
+			public:
+				static const uint32_t kAddressMask = 0x1FFF003F;
+				static const uint32_t kDeviceNumberMask = 0x3F;
+				static const uint32_t kDeviceTypeMask = 0x1F000000;
+
+				/** device type, manufacturer and device number of an arbitration ID */
+				static uint32_t AddressOf(uint32_t arbID) { return arbID & kAddressMask; }
+				static bool IsBroadcast(uint32_t arbID);
+
+				/** Record that device sent a frame with this arbitration ID. */
+				void Learn(uint32_t arbID, SimDevice * device);
+				/** @return the device the frame is addressed to, or nullptr to deliver to all */
+				SimDevice * Route(uint32_t arbID) const;
+
+				void Forget(SimDevice * device);
+				void Clear() { _index.clear(); }
+
+			private:
+				/* address -> owner, nullptr marks an address claimed by more than one device */
+				std::unordered_map<uint32_t, SimDevice *> _index;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "SimDevice.h"
+#include "SimProfile.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Layout of the memory a process-hosted device shares with the robot, see CreateProcessSimDevice.
+ * The robot creates it, the host executable maps the same fd, so both sides must be built from this header.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared-memory atomics must be lock free");
+
+			/*
+			 * one config request from the robot, run by the host between frame batches.
+			 * The host takes a pending call by moving it to running, so a robot that gives up can
+			 * take back a call the host never saw. A call finished after the robot gave up stays done
+			 * until the next call discards it.
+			 */
+			struct SimShmConfigCall {
+				static const uint32_t kIdle = 0;
+				static const uint32_t kPending = 1;
+				static const uint32_t kRunning = 2;
+				static const uint32_t kDone = 3;
+				static const uint32_t kMaxParams = 64;
+
+				std::atomic<uint32_t> state{ kIdle };
+				uint32_t isGet = 0;
+				uint32_t valueToSend = 0;
+				uint32_t count = 0;
+				int32_t result = 0;
+				SimConfigParam params[kMaxParams];
+			};
+
+			/* everything the robot process and the host share, lives in one shared mapping */
+			struct SimShmChannel {
+				static const int32_t kStartPending = 0x7FFFFFFF;
+				static const uint32_t kRingCapacity = 256;
+
+				SpscRing<SimFrame, kRingCapacity> toDevice;	//!< robot -> host
+				SpscRing<SimFrame, kRingCapacity> fromDevice;	//!< host -> robot
+				std::atomic<uint64_t> timeUs{ 0 };	//!< latest virtual time, 0 if never set
+				std::atomic<int32_t> startResult{ kStartPending };
+				std::atomic<uint32_t> stop{ 0 };
+				std::atomic<uint32_t> workerSleeping{ 0 };
+				SimShmConfigCall config;
+				SimDeviceProfile profile;	//!< written by the host, read by the robot
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
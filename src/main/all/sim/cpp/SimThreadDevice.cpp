@@ -0,0 +1,197 @@
+#include "SimDevice.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			namespace {
+				/* worker waits this long for inbound frames before polling the adapter again */
+				const auto kWorkerIdle = std::chrono::milliseconds(1);
+				/* same cap as the in-process pump */
+				const uint32_t kMaxFramesPerPoll = 16;
+				/* depth of each mailbox */
+				const uint32_t kMailboxCapacity = 256;
+			}
+
+			/**
+			 * Device driven by its own worker thread.
+			 * The sim only enqueues to and dequeues from the mailboxes, the adapter runs on the worker.
+			 */
+			class ThreadSimDevice : public SimDevice
+			{
+			public:
+				explicit ThreadSimDevice(std::unique_ptr<runtime::LibLoader> lib) :
+					_local(CreateLocalSimDevice(std::move(lib)))
+				{
+				}
+
+				~ThreadSimDevice()
+				{
+					if (_worker.joinable()) {
+						_stop = true;
+						Wake();
+						_worker.join();
+					}
+				}
+
+				int32_t Start(int id) override
+				{
+					/* start routine runs on the caller so its result can be returned */
+					int32_t err = _local->Start(id);
+					if (err == 0) {
+						_worker = std::thread(&ThreadSimDevice::RunWorker, this);
+					}
+					return err;
+				}
+
+				void Send(const SimFrame * frames, uint32_t count) override
+				{
+					/* a worker that can't keep up loses frames, like a device with a full rx fifo */
+					(void)_inbound.PushBulk(frames, count);
+					WakeIfSleeping();
+				}
+
+				int32_t Receive(SimFrame * frames, uint32_t capacity, uint32_t & numberFilled) override
+				{
+					numberFilled = _outbound.PopBulk(frames, capacity);
+					return numberFilled > 0 ? ErrorCode::OK : ErrorCode::RxTimeout;
+				}
+
+				void SetTime(uint64_t nowUs) override
+				{
+					_timeUs = nowUs;
+					WakeIfSleeping();
+				}
+
+				int32_t ConfigSet(const SimConfigParam * params, uint32_t count) override
+				{
+					/* config is rare, call the adapter directly between worker iterations */
+					std::lock_guard<std::mutex> lock(_adapterLck);
+					return _local->ConfigSet(params, count);
+				}
+
+				int32_t ConfigGet(SimConfigParam & param, uint32_t valueToSend) override
+				{
+					std::lock_guard<std::mutex> lock(_adapterLck);
+					return _local->ConfigGet(param, valueToSend);
+				}
+
+				bool SerializesConfig() const override { return true; }
+
+				int32_t SaveState(std::vector<uint8_t> & state) override
+				{
+					std::lock_guard<std::mutex> lock(_adapterLck);
+					return _local->SaveState(state);
+				}
+
+				int32_t LoadState(const std::vector<uint8_t> & state) override
+				{
+					std::lock_guard<std::mutex> lock(_adapterLck);
+					DropInFlight();
+					return _local->LoadState(state);
+				}
+
+				int32_t Reset(int id) override
+				{
+					std::lock_guard<std::mutex> lock(_adapterLck);
+					DropInFlight();
+					return _local->Reset(id);
+				}
+
+				SimDeviceProfile & Profile() override { return _local->Profile(); }
+
+			private:
+				/* caller holds _adapterLck, so the worker is not using the inbound side */
+				void DropInFlight()
+				{
+					SimFrame frame;
+					while (_inbound.Pop(frame)) {}
+					while (_outbound.Pop(frame)) {}
+				}
+
+				void Wake()
+				{
+					std::lock_guard<std::mutex> lock(_lck);
+					_cv.notify_one();
+				}
+
+				void WakeIfSleeping()
+				{
+					/* pairs with the fence in RunWorker, either we see it asleep or it sees our work */
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if (_sleeping) { Wake(); }
+				}
+
+				void RunWorker()
+				{
+					uint64_t lastTimeUs = 0;
+					while (_stop == false) {
+						bool idle = true;
+
+						{
+							std::lock_guard<std::mutex> adapterLock(_adapterLck);
+
+							uint64_t timeUs = _timeUs;
+							if (timeUs != lastTimeUs) {
+								lastTimeUs = timeUs;
+								_local->SetTime(timeUs);
+								idle = false;
+							}
+
+							SimFrame batch[kMaxFramesPerPoll];
+							uint32_t count = _inbound.PopBulk(batch, kMaxFramesPerPoll);
+							if (count > 0) {
+								_local->Send(batch, count);
+								idle = false;
+							}
+
+							/* only take what the mailbox has room for, the rest stays queued in the adapter */
+							uint32_t room = kMailboxCapacity - _outbound.Size();
+							if (room > kMaxFramesPerPoll) { room = kMaxFramesPerPoll; }
+							if (room > 0) {
+								(void)_local->Receive(batch, room, count);
+								(void)_outbound.PushBulk(batch, count);
+								if (count > 0) { idle = false; }
+							}
+						}
+
+						if (idle) {
+							std::unique_lock<std::mutex> lock(_lck);
+							_sleeping = true;
+							std::atomic_thread_fence(std::memory_order_seq_cst);
+							if (_inbound.Empty() && _timeUs == lastTimeUs && _stop == false) {
+								_cv.wait_for(lock, kWorkerIdle);
+							}
+							_sleeping = false;
+						}
+					}
+				}
+
+				std::unique_ptr<SimDevice> _local;	//!< adapter calls, made under _adapterLck once started
+				std::mutex _adapterLck;	//!< held by the worker while it is in the adapter
+				SpscRing<SimFrame, kMailboxCapacity> _inbound;	//!< robot -> worker
+				SpscRing<SimFrame, kMailboxCapacity> _outbound;	//!< worker -> robot
+				std::atomic<uint64_t> _timeUs{ 0 };
+				std::atomic<bool> _stop{ false };
+				std::atomic<bool> _sleeping{ false };
+				std::mutex _lck;
+				std::condition_variable _cv;
+				std::thread _worker;
+			};
+
+			std::unique_ptr<SimDevice> CreateThreadSimDevice(std::unique_ptr<runtime::LibLoader> lib)
+			{
+				return std::unique_ptr<SimDevice>(new ThreadSimDevice(std::move(lib)));
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
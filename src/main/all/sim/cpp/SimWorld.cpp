@@ -0,0 +1,816 @@
+#include "SimWorld.h"
+#include "ctre/phoenix/ErrorCode.h"
+#include "ctre/phoenix/platform/FrameTime.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream> // std::cout
+#include <sstream>
+#include <vector>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			namespace {
+				/* hand a queued frame to the caller in the shape they asked for */
+				template <typename Queue>
+				uint32_t PopFrames(Queue & queue, can::canframe_t * toFillArray, uint32_t capacity) { return ReceiveAsCanframes(queue, toFillArray, capacity); }
+				template <typename Queue>
+				uint32_t PopFrames(Queue & queue, can::canframe_ex_t * toFillArray, uint32_t capacity) { return queue.PopBulk(toFillArray, capacity); }
+
+				/* how devices are hosted until SimSetTransport says otherwise */
+				SimTransport GetDefaultTransport()
+				{
+					const char * env = std::getenv("CTRE_SIM_TRANSPORT");
+					if (env != nullptr && std::strcmp(env, "thread") == 0)
+						return SimTransport::Thread;
+					if (env != nullptr && std::strcmp(env, "process") == 0)
+						return SimTransport::Process;
+					return SimTransport::InProcess;
+				}
+
+				/* max frames taken from one device per pump, protects against a device that never runs dry */
+				const uint32_t kMaxFramesPerPoll = 16;
+
+				/* how often the pump thread moves the bus along while someone waits on the rx event */
+				const std::chrono::milliseconds kPumpPeriod(1);
+
+				/* periodic profile summary, off unless asked for */
+				std::chrono::steady_clock::duration GetDefaultSummaryPeriod()
+				{
+					const char * env = std::getenv("CTRE_SIM_PROFILE_PERIOD_MS");
+					if (env == nullptr)
+						return std::chrono::steady_clock::duration::zero();
+					return std::chrono::milliseconds(std::strtoul(env, nullptr, 10));
+				}
+
+				void FillCallStats(SimCallStats & stats, const SimCallCounters & counters)
+				{
+					stats.calls = counters.calls;
+					stats.totalNs = SimTicksToNs(counters.ticks);
+					stats.maxNs = SimTicksToNs(counters.maxTicks);
+				}
+
+				void FillDeviceStats(SimDeviceStats & stats, const std::pair<DeviceType, int> & identifier, const SimDeviceProfile & profile)
+				{
+					stats.type = identifier.first;
+					stats.id = identifier.second;
+					FillCallStats(stats.send, profile.send);
+					FillCallStats(stats.receive, profile.receive);
+					FillCallStats(stats.setTime, profile.setTime);
+					FillCallStats(stats.other, profile.other);
+					stats.framesToDevice = profile.framesToDevice;
+					stats.framesFromDevice = profile.framesFromDevice;
+				}
+
+				const char * DeviceTypeName(DeviceType type)
+				{
+					switch (type) {
+					case TalonSRXType: return "TalonSRX";
+					case VictorSPXType: return "VictorSPX";
+					case CANifierType: return "CANifier";
+					case PigeonIMUType: return "PigeonIMU";
+					default: return "Device";
+					}
+				}
+
+				/* a device's transmit queue on the bus, the same for every device with that type and ID */
+				uint64_t BusSource(const std::pair<DeviceType, int> & identifier)
+				{
+					return (static_cast<uint64_t>(static_cast<uint32_t>(identifier.first)) << 32) | static_cast<uint32_t>(identifier.second);
+				}
+
+				/* API bits of a parameter-set frame, the robot configured a device over the bus */
+				const uint32_t kParamSetApiMask = 0x0000FFC0;
+				const uint32_t kParamSetApi = 0x00001880;
+			}
+
+			SimWorld::SimWorld(uint32_t id) :
+				_id(id),
+				_transport(GetDefaultTransport()),
+				_summaryPeriod(GetDefaultSummaryPeriod()),
+				_nextSummary(std::chrono::steady_clock::now() + _summaryPeriod),
+				_clock([this](uint64_t nowUs) { OnTimeAdvanced(nowUs); })
+			{
+				/* the environment can only speak for the default world, others would share the file */
+				if (_id == 0) {
+					const char * record = std::getenv("CTRE_SIM_RECORD");
+					if (record != nullptr) {
+						(void)StartRecording(record);
+					}
+					const char * replay = std::getenv("CTRE_SIM_REPLAY");
+					if (replay != nullptr) {
+						(void)StartReplay(replay);
+					}
+				}
+			}
+
+			SimWorld::~SimWorld()
+			{
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					_pumpRun = false;
+				}
+				_pumpCv.notify_all();
+				if (_pumpThread.joinable())
+					_pumpThread.join();
+
+				DestroyAllDevices();
+			}
+
+			void SimWorld::SetTransport(SimTransport transport)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_transport = transport;
+			}
+
+			SimTransport SimWorld::GetTransport()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				return _transport;
+			}
+
+			void SimWorld::SetBusBitrate(uint32_t bitsPerSecond)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_bus.SetBitrate(bitsPerSecond);
+			}
+
+			bool SimWorld::HasDevice(DeviceType type, int id)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				return _devices.find(std::make_pair(type, id)) != _devices.end();
+			}
+
+			int32_t SimWorld::AddDevice(DeviceType type, int id, SimTransport transport, std::unique_ptr<runtime::LibLoader> lib, const std::string & libPath)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				/* did we already create this device? */
+				std::pair<DeviceType, int> identifier(type, id);
+				if (_devices.find(identifier) != _devices.end()) {
+					/* replace with error code after header repos is created */
+					return -1;
+				}
+
+				/* host the adapter the selected way */
+				std::unique_ptr<SimDevice> device;
+				if (transport == SimTransport::Process)
+					device = CreateProcessSimDevice(libPath);
+				else if (transport == SimTransport::Thread)
+					device = CreateThreadSimDevice(std::move(lib));
+				else
+					device = CreateLocalSimDevice(std::move(lib));
+
+				if (device == nullptr)
+					return ErrorCode::FeatureNotSupported;
+
+				/* call the start routine */
+				int32_t retval = device->Start(id);
+
+				/* start the device at the current sim time */
+				if (retval == 0) {
+					if (_clock.IsVirtual()) {
+						device->SetTime(_clock.NowUs());
+					}
+					device->SetGeneration(++_lastGeneration);
+					_devices.insert(std::make_pair(identifier, std::move(device)));
+				}
+				return retval;
+			}
+
+			void SimWorld::DestroyDevice(DeviceType type, int id)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				auto iter = _devices.find(std::make_pair(type, id));
+				if (iter != _devices.end()) {
+					_router.Forget(iter->second.get());
+					_devices.erase(iter);
+				}
+			}
+
+			void SimWorld::DestroyAllDevices()
+			{
+				/* stopping hosted devices can take a while, don't hold our lock through it */
+				(void)TakeAllDevices();
+			}
+
+			std::vector<std::shared_ptr<SimDevice>> SimWorld::TakeAllDevices()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				std::vector<std::shared_ptr<SimDevice>> taken;
+				taken.reserve(_devices.size());
+				for (auto &identifiedLib : _devices) {
+					taken.push_back(std::move(identifiedLib.second));
+				}
+				_router.Clear();
+				_devices.clear();
+				return taken;
+			}
+
+			void SimWorld::DeliverFrame(const SimBusFrame & frame)
+			{
+				if (_recorder.IsOpen()) {
+					SimRecord record = {};
+					record.timeNs = frame.deliveredNs;
+					record.arbID = frame.arbID;
+					record.dlc = frame.dlc;
+					record.direction = frame.fromRobot ? SimRecord::kToDevice : SimRecord::kToRobot;
+					std::memcpy(record.data, frame.data, 8);
+					_recorder.Write(record);
+				}
+
+				if (frame.fromRobot) {
+					SimFrame toSend = {};
+					toSend.arbID = frame.arbID;
+					toSend.dlc = frame.dlc;
+					std::memcpy(toSend.data, frame.data, 8);
+
+					/* config changed without going through SimConfigSet, cached values can't be trusted */
+					bool paramSet = (frame.arbID & kParamSetApiMask) == kParamSetApi;
+
+					/* queued per device and flushed once the bus has run, so each device gets one batch */
+					SimDevice * target = _router.Route(frame.arbID);
+					if (target) {
+						/* addressed to a single device we know */
+						target->QueueSend(toSend);
+						if (paramSet) { target->ConfigCache().Clear(); }
+					}
+					else {
+						/* broadcast or unknown address, every device sees it */
+						for (auto &identifiedLib : _devices) {
+							identifiedLib.second->QueueSend(toSend);
+							if (paramSet) { identifiedLib.second->ConfigCache().Clear(); }
+						}
+					}
+				}
+				else {
+					can::canframe_ex_t toFill = {};
+					toFill.arbID = frame.arbID;
+					toFill.dlc = frame.dlc;
+					toFill.timeStampNs = frame.deliveredNs;
+					toFill.flags = 0;
+					std::memcpy(toFill.data, frame.data, 8);
+					QueueForRobot(toFill);
+				}
+			}
+
+			void SimWorld::QueueForRobot(const can::canframe_ex_t & frame)
+			{
+				/* subscribers see every frame, even one the full queue drops */
+				_rxDispatch.Dispatch(&frame, 1);
+				/* a full class drops the frame and counts it */
+				(void)_rxFrames.Push(frame);
+			}
+
+			/* logged device frames go straight to the robot, they already saw bus timing when recorded */
+			void SimWorld::ReplayDueFrames(uint64_t nowNs)
+			{
+				const SimRecord * record;
+				while ((record = _replay.Peek()) != nullptr) {
+					if (record->direction != SimRecord::kToRobot) {
+						/* there is no device to hand robot frames to */
+						_replay.Pop();
+						continue;
+					}
+
+					uint64_t dueNs = _replayBaseNs + (record->timeNs - _replay.StartNs());
+					if (dueNs > nowNs)
+						break;
+
+					can::canframe_ex_t toFill = {};
+					toFill.arbID = record->arbID;
+					toFill.dlc = record->dlc > 8 ? 8 : record->dlc;
+					toFill.timeStampNs = dueNs;
+					toFill.flags = 0;
+					std::memcpy(toFill.data, record->data, 8);
+					QueueForRobot(toFill);
+					_replay.Pop();
+				}
+			}
+
+			/**
+			 * Collect whatever the devices have to send and run the bus up to now.
+			 *
+			 * @return first adapter error seen while polling, 0 if none
+			 */
+			int32_t SimWorld::PumpBus(uint64_t nowUs)
+			{
+				int32_t retval = 0;
+
+				for (auto &identifiedLib : _devices) {
+					auto &device = identifiedLib.second;
+
+					SimFrame frames[kMaxFramesPerPoll];
+					uint32_t numberFilled = 0;
+					int32_t err = device->Receive(frames, kMaxFramesPerPoll, numberFilled);
+					if (err != 0) {
+						/* save first bad one */
+						if (retval == 0) { retval = err; }
+					}
+					for (uint32_t i = 0; i < numberFilled; ++i) {
+						_router.Learn(frames[i].arbID, device.get());
+						(void)_bus.TransmitFromDevice(BusSource(identifiedLib.first), frames[i].arbID, frames[i].data, frames[i].dlc, nowUs * 1000);
+					}
+				}
+
+				_bus.Advance(nowUs * 1000, [this](const SimBusFrame & frame) { DeliverFrame(frame); });
+
+				if (_replay.IsOpen()) {
+					ReplayDueFrames(nowUs * 1000);
+				}
+
+				for (auto &identifiedLib : _devices) {
+					identifiedLib.second->FlushSends();
+				}
+
+				if (_summaryPeriod != std::chrono::steady_clock::duration::zero()) {
+					auto now = std::chrono::steady_clock::now();
+					if (now >= _nextSummary) {
+						_nextSummary = now + _summaryPeriod;
+						PrintProfileSummary();
+					}
+				}
+
+				if (_rxFrames.Empty() == false)
+					_rxEvent.Signal();
+
+				return retval;
+			}
+
+			void SimWorld::OnTimeAdvanced(uint64_t nowUs)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				for (auto &identifiedLib : _devices) {
+					identifiedLib.second->SetTime(nowUs);
+				}
+
+				/* let frames that finished during the jump come off the bus */
+				(void)PumpBus(nowUs);
+			}
+
+			void SimWorld::PumpLoop()
+			{
+				std::unique_lock<std::mutex> lock(_lck);
+				while (_pumpRun) {
+					/* clock before world, same order as everyone else */
+					lock.unlock();
+					uint64_t nowUs = _clock.NowUs();
+					lock.lock();
+					if (_pumpRun == false)
+						break;
+
+					/* in virtual time the bus moves with the clock, see OnTimeAdvanced, not with the wall */
+					if (_clock.IsVirtual() == false)
+						(void)PumpBus(nowUs);
+					_pumpCv.wait_for(lock, kPumpPeriod, [this] { return _pumpRun == false; });
+				}
+			}
+
+			template <typename Call>
+			int32_t SimWorld::CallConfig(std::unique_lock<std::mutex> & lock, SimDevice & device, Call call)
+			{
+				if (device.SerializesConfig() == false)
+					return call();
+
+				/* a hosted device can take a while to answer, keep the bus moving meanwhile */
+				lock.unlock();
+				int32_t retval = call();
+				lock.lock();
+				return retval;
+			}
+
+			int32_t SimWorld::ConfigSetBatch(DeviceType type, int id, const SimConfigParam * params, uint32_t count)
+			{
+				std::unique_lock<std::mutex> lock(_lck);
+
+				auto iter = _devices.find(std::make_pair(type, id));
+				if (iter == _devices.end())
+					return ErrorCode::ResourceNotAvailable;
+				std::shared_ptr<SimDevice> device = iter->second;
+
+				/* skip params the cache says are already set */
+				std::vector<SimConfigParam> changed;
+				changed.reserve(count);
+				for (uint32_t i = 0; i < count; ++i) {
+					const SimConfigParam & p = params[i];
+					if (device->ConfigCache().Holds(p.param, p.ordinal, p.value, p.subValue) == false)
+						changed.push_back(p);
+				}
+				if (changed.empty())
+					return ErrorCode::OK;
+
+				int32_t retval = CallConfig(lock, *device, [&] {
+					return device->ConfigSet(changed.data(), static_cast<uint32_t>(changed.size()));
+				});
+
+				SimConfigCache & cache = device->ConfigCache();
+				if (retval == 0) {
+					for (const SimConfigParam & p : changed) {
+						cache.Store(p.param, p.ordinal, p.value, p.subValue);
+					}
+				}
+				else {
+					/* don't know how far the adapter got */
+					cache.Clear();
+				}
+				return retval;
+			}
+
+			int32_t SimWorld::ConfigGet(DeviceType type, int id, uint32_t param, uint32_t valueToSend, uint32_t & outValue, uint32_t & outSubValue, uint32_t ordinal)
+			{
+				std::unique_lock<std::mutex> lock(_lck);
+
+				auto iter = _devices.find(std::make_pair(type, id));
+				if (iter == _devices.end())
+					return ErrorCode::ResourceNotAvailable;
+				std::shared_ptr<SimDevice> device = iter->second;
+
+				/* always ask the adapter, the value may have moved on and valueToSend may select what is read */
+				SimConfigParam toFill = {};
+				toFill.param = param;
+				toFill.ordinal = ordinal;
+				int32_t retval = CallConfig(lock, *device, [&] { return device->ConfigGet(toFill, valueToSend); });
+				if (retval == 0) {
+					device->ConfigCache().Store(param, ordinal, toFill.value, toFill.subValue);
+					outValue = toFill.value;
+					outSubValue = toFill.subValue;
+				}
+				return retval;
+			}
+
+			int32_t SimWorld::TakeSnapshot(SimSnapshot & snapshot)
+			{
+				/* time first, the clock lock is taken before ours when time advances */
+				snapshot.isVirtual = _clock.IsVirtual();
+				snapshot.nowUs = _clock.NowUs();
+
+				std::lock_guard<std::mutex> guard(_lck);
+
+				snapshot.worldId = _id;
+				snapshot.bus = _bus;
+				snapshot.router = _router;
+				for (uint32_t c = 0; c < can::kRxClassCount; ++c) {
+					snapshot.rxFrames[c].clear();
+					_rxFrames.CopyClass(c, snapshot.rxFrames[c]);
+				}
+				snapshot.devices.clear();
+				snapshot.devices.reserve(_devices.size());
+
+				for (auto &identifiedLib : _devices) {
+					SimSnapshot::Device saved;
+					saved.type = identifiedLib.first.first;
+					saved.id = identifiedLib.first.second;
+					saved.generation = identifiedLib.second->Generation();
+					saved.config = identifiedLib.second->ConfigCache();
+
+					int32_t err = identifiedLib.second->SaveState(saved.state);
+					if (err == ErrorCode::FeatureNotSupported) {
+						saved.hasState = false;
+					}
+					else if (err != 0) {
+						return err;
+					}
+					else {
+						saved.hasState = true;
+					}
+					snapshot.devices.push_back(std::move(saved));
+				}
+				return ErrorCode::OK;
+			}
+
+			int32_t SimWorld::RestoreSnapshot(const SimSnapshot & snapshot)
+			{
+				if (snapshot.worldId != _id)
+					return ErrorCode::InvalidParamValue;
+
+				/* every device in the snapshot must still be the one we saved, not one re-created since */
+				auto stillThere = [&]() {
+					for (const SimSnapshot::Device & saved : snapshot.devices) {
+						auto iter = _devices.find(std::make_pair(saved.type, saved.id));
+						if (iter == _devices.end() || iter->second->Generation() != saved.generation)
+							return false;
+					}
+					return true;
+				};
+				{
+					std::lock_guard<std::mutex> guard(_lck);
+					if (stillThere() == false)
+						return ErrorCode::ResourceNotAvailable;
+				}
+
+				/* outside our lock, the clock lock is taken before ours when time advances.
+				 * A snapshot taken in real time has nothing to rewind, real time only moves forward */
+				if (snapshot.isVirtual) {
+					_clock.RestoreVirtual(snapshot.nowUs);
+				}
+
+				std::lock_guard<std::mutex> guard(_lck);
+
+				/* check again, a device may have gone while the lock was released */
+				if (stillThere() == false)
+					return ErrorCode::ResourceNotAvailable;
+
+				/* drop anything created after the snapshot */
+				if (_devices.size() != snapshot.devices.size()) {
+					auto iter = _devices.begin();
+					while (iter != _devices.end()) {
+						bool saved = false;
+						for (const SimSnapshot::Device & entry : snapshot.devices) {
+							if (entry.type == iter->first.first && entry.id == iter->first.second) { saved = true; break; }
+						}
+						if (saved) {
+							++iter;
+						}
+						else {
+							iter = _devices.erase(iter);
+						}
+					}
+				}
+
+				_bus = snapshot.bus;
+				_router = snapshot.router;
+				_rxFrames.Clear();
+				_leasedCount = 0;
+				for (uint32_t c = 0; c < can::kRxClassCount; ++c) {
+					const std::vector<can::canframe_ex_t> & frames = snapshot.rxFrames[c];
+					(void)_rxFrames.PushBulk(c, frames.data(), static_cast<uint32_t>(frames.size()));
+				}
+				if (_rxFrames.Empty() == false)
+					_rxEvent.Signal();
+
+				int32_t retval = 0;
+				for (const SimSnapshot::Device & saved : snapshot.devices) {
+					SimDevice & device = *_devices.find(std::make_pair(saved.type, saved.id))->second;
+
+					/* serialized state if we have it, otherwise the cheapest reset the adapter offers */
+					int32_t err = ErrorCode::FeatureNotSupported;
+					if (saved.hasState) {
+						err = device.LoadState(saved.state);
+					}
+					if (err == 0) {
+						device.ConfigCache() = saved.config;
+					}
+					else {
+						err = device.Reset(saved.id);
+						device.ConfigCache().Clear();
+					}
+
+					if (snapshot.isVirtual) {
+						device.SetTime(snapshot.nowUs);
+					}
+
+					/* save first bad one */
+					if (err != 0 && retval == 0) { retval = err; }
+				}
+				return retval;
+			}
+
+			void SimWorld::GetDeviceStats(SimDeviceStats * stats, uint32_t capacity, uint32_t & numberFilled)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				numberFilled = 0;
+				for (auto &identifiedLib : _devices) {
+					if (numberFilled >= capacity)
+						break;
+					FillDeviceStats(stats[numberFilled++], identifiedLib.first, identifiedLib.second->Profile());
+				}
+			}
+
+			void SimWorld::ResetDeviceStats()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				/* a hosted device may be mid-call, its next update can land on top of the reset */
+				for (auto &identifiedLib : _devices) {
+					identifiedLib.second->Profile().Reset();
+				}
+			}
+
+			void SimWorld::SetProfileSummaryPeriod(uint32_t periodMs)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_summaryPeriod = std::chrono::milliseconds(periodMs);
+				_nextSummary = std::chrono::steady_clock::now() + _summaryPeriod;
+			}
+
+			/* one line per device, busiest first */
+			void SimWorld::PrintProfileSummary()
+			{
+				std::vector<SimDeviceStats> stats(_devices.size());
+				uint32_t i = 0;
+				for (auto &identifiedLib : _devices) {
+					FillDeviceStats(stats[i++], identifiedLib.first, identifiedLib.second->Profile());
+				}
+
+				auto totalNs = [](const SimDeviceStats & d) {
+					return d.send.totalNs + d.receive.totalNs + d.setTime.totalNs + d.other.totalNs;
+				};
+				std::sort(stats.begin(), stats.end(), [&](const SimDeviceStats & a, const SimDeviceStats & b) {
+					return totalNs(a) > totalNs(b);
+				});
+
+				std::ostringstream work;
+				work << "Sim profile, world " << _id << ":" << std::endl;
+				for (const SimDeviceStats & d : stats) {
+					uint64_t calls = d.send.calls + d.receive.calls + d.setTime.calls + d.other.calls;
+					uint64_t maxNs = std::max(std::max(d.send.maxNs, d.receive.maxNs), std::max(d.setTime.maxNs, d.other.maxNs));
+					work << "\t" << DeviceTypeName(d.type) << " " << d.id
+						<< ": " << totalNs(d) / 1000 << "us in " << calls << " calls (max " << maxNs / 1000 << "us)"
+						<< ", send " << d.send.totalNs / 1000 << "us"
+						<< ", receive " << d.receive.totalNs / 1000 << "us"
+						<< ", setTime " << d.setTime.totalNs / 1000 << "us"
+						<< ", frames in/out " << d.framesToDevice << "/" << d.framesFromDevice << std::endl;
+				}
+				std::cout << work.str();
+			}
+
+			int32_t SimWorld::StartRecording(const std::string & path)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+				return _recorder.Open(path, nowUs * 1000);
+			}
+
+			void SimWorld::StopRecording()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_recorder.Close();
+			}
+
+			int32_t SimWorld::StartReplay(const std::string & path)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+
+				int32_t retval = _replay.Open(path);
+				if (retval == 0) {
+					/* the start of the recording lines up with now */
+					_replayBaseNs = nowUs * 1000;
+				}
+				return retval;
+			}
+
+			void SimWorld::StopReplay()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_replay.Close();
+			}
+
+			bool SimWorld::IsReplaying()
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				return _replay.IsOpen();
+			}
+
+			void SimWorld::GetStatus(float * percentBusUtilization, uint32_t * txFullCount, uint32_t * deviceTxDropCount, uint32_t * rxDropCount)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_bus.GetStatus(percentBusUtilization, txFullCount, deviceTxDropCount);
+				if (rxDropCount) { *rxDropCount = static_cast<uint32_t>(_rxFrames.Dropped()); }
+			}
+
+			int32_t SimWorld::SendFrame(uint32_t messageID, const uint8_t * data, uint8_t dataSize)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+
+				/* frame reaches the devices once it has been on the bus long enough */
+				int32_t retval = _bus.TransmitFromRobot(messageID, data, dataSize, nowUs * 1000);
+
+				(void)PumpBus(nowUs);
+
+				return retval;
+			}
+
+			int32_t SimWorld::ReceiveFrame(can::canframe_t * toFillArray, uint32_t capacity, uint32_t & numberFilled)
+			{
+				return Receive(toFillArray, capacity, numberFilled);
+			}
+
+			int32_t SimWorld::ReceiveFrameEx(can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t & numberFilled)
+			{
+				return Receive(toFillArray, capacity, numberFilled);
+			}
+
+			template <typename Frame>
+			int32_t SimWorld::Receive(Frame * toFillArray, uint32_t capacity, uint32_t & numberFilled)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+
+				int32_t retval = PumpBus(nowUs);
+
+				/* taking frames takes any lent ones with them, a late release must not free others */
+				_leasedCount = 0;
+
+				/* filler caller's outputs with what came off the bus */
+				numberFilled = PopFrames(_rxFrames, toFillArray, capacity);
+				if (numberFilled < capacity)
+					_rxEvent.Clear([this] { return _rxFrames.Empty(); });
+
+				if (numberFilled > 0)
+					return 0;
+				return retval;
+			}
+
+			int32_t SimWorld::ReceiveClassEx(uint32_t rxClass, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t & numberFilled)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+
+				int32_t retval = PumpBus(nowUs);
+
+				_leasedCount = 0;
+				numberFilled = _rxFrames.PopBulk(rxClass, toFillArray, capacity);
+				/* stays ready while another class still holds frames */
+				if (numberFilled < capacity)
+					_rxEvent.Clear([this] { return _rxFrames.Empty(); });
+
+				if (numberFilled > 0)
+					return 0;
+				return retval;
+			}
+
+			bool SimWorld::SetRxClasses(const can::canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+			{
+				/* frames are only queued with our lock held, so the swap never waits on a push in progress */
+				std::lock_guard<std::mutex> guard(_lck);
+				return _rxFrames.SetClasses(rules, count, defaultClass);
+			}
+
+			bool SimWorld::SetRxCoalescing(uint32_t rxClass, bool latestOnly)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				return _rxFrames.SetCoalescing(rxClass, latestOnly);
+			}
+
+			uint32_t SimWorld::LeaseFrames(RingSpans<can::canframe_ex_t> & spans, uint32_t maxCount)
+			{
+				uint64_t nowUs = _clock.NowUs();
+				std::lock_guard<std::mutex> guard(_lck);
+
+				/* unlike a receive, an empty lease is success, so a device with nothing to send is not reported */
+				(void)PumpBus(nowUs);
+
+				/* lent straight out of the class ring, the frames stay put while the bus keeps queueing behind them */
+				_leasedCount = _rxFrames.Lease(spans, maxCount);
+				if (_leasedCount < maxCount)
+					_rxEvent.Clear([this] { return _rxFrames.Empty(); });
+				return _leasedCount;
+			}
+
+			void SimWorld::ReleaseFrames(uint32_t count)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+				_rxFrames.Release((count < _leasedCount) ? count : _leasedCount);
+				_leasedCount = 0;
+			}
+
+			int32_t SimWorld::GetRxEvent(intptr_t & handle)
+			{
+				std::lock_guard<std::mutex> guard(_lck);
+
+				if (_rxEvent.Open(handle) == false)
+					return ErrorCode::ResourceNotAvailable;
+
+				StartPump();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimWorld::Subscribe(uint32_t arbID, uint32_t mask, can::canframe_callback_t callback, void * context, uint32_t & handle)
+			{
+				if (_rxDispatch.Add(arbID, mask, callback, context, handle) == false)
+					return ErrorCode::InvalidParamValue;
+
+				/* callbacks should fire whether or not the robot is receiving */
+				std::lock_guard<std::mutex> guard(_lck);
+				StartPump();
+				return ErrorCode::OK;
+			}
+
+			int32_t SimWorld::Unsubscribe(uint32_t handle)
+			{
+				/* not under _lck, a pump may be dispatching and has to be allowed to finish */
+				if (_rxDispatch.Remove(handle) == false)
+					return ErrorCode::InvalidParamValue;
+				return ErrorCode::OK;
+			}
+
+			void SimWorld::StartPump()
+			{
+				if (_pumpThread.joinable() == false) {
+					_pumpRun = true;
+					_pumpThread = std::thread(&SimWorld::PumpLoop, this);
+				}
+			}
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -0,0 +1,193 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "ctre/phoenix/platform/RxClass.h"
+#include "ctre/phoenix/platform/RxDispatch.h"
+#include "ctre/phoenix/platform/RxEvent.h"
+#include "ctre/phoenix/runtime/LibLoader.h"
+
+#include "SimBus.h"
+#include "SimClock.h"
+#include "SimDevice.h"
+#include "SimRecord.h"
+#include "SimRouter.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** Saved state of a world, see SimWorld::TakeSnapshot */
+			class SimSnapshot
+			{
+			public:
+				struct Device {
+					DeviceType type;
+					int id;
+					uint64_t generation;	//!< only used to check it is still the same device, see SimDevice::Generation
+					bool hasState;	//!< false if the adapter has no state hooks, restore resets it instead
+					std::vector<uint8_t> state;
+					SimConfigCache config;
+				};
+
+				uint32_t worldId = 0;
+				bool isVirtual = false;
+				uint64_t nowUs = 0;
+				SimBus bus;
+				SimRouter router;
+				std::vector<can::canframe_ex_t> rxFrames[can::kRxClassCount];	//!< each receive class in receive order
+				std::vector<Device> devices;
+			};
+
+			/**
+			 * One simulated robot: its devices, the bus between them and the robot, and its clock.
+			 * Worlds share nothing, so several can run side by side in one process.
+			 * All public calls are thread safe.
+			 */
+			class SimWorld
+			{
+			public:
+				explicit SimWorld(uint32_t id);
+				~SimWorld();
+
+				uint32_t GetId() const { return _id; }
+				SimClock & Clock() { return _clock; }
+
+				void SetTransport(SimTransport transport);
+				SimTransport GetTransport();
+				void SetBusBitrate(uint32_t bitsPerSecond);
+
+				bool HasDevice(DeviceType type, int id);
+				/**
+				 * Host an adapter library as a device and run its start routine.
+				 * A process-hosted device loads libPath in its host, the others use the already loaded lib.
+				 * @return 0 on success, -1 if the device already exists
+				 */
+				int32_t AddDevice(DeviceType type, int id, SimTransport transport, std::unique_ptr<runtime::LibLoader> lib, const std::string & libPath);
+				void DestroyDevice(DeviceType type, int id);
+				void DestroyAllDevices();
+				/** Hand every device over to the caller, who tears them down without holding any of our locks. */
+				std::vector<std::shared_ptr<SimDevice>> TakeAllDevices();
+
+				int32_t ConfigSetBatch(DeviceType type, int id, const SimConfigParam * params, uint32_t count);
+				int32_t ConfigGet(DeviceType type, int id, uint32_t param, uint32_t valueToSend, uint32_t & outValue, uint32_t & outSubValue, uint32_t ordinal);
+
+				/**
+				 * Save the bus, the queued frames, the clock and every device's state.
+				 * @return 0 on success
+				 */
+				int32_t TakeSnapshot(SimSnapshot & snapshot);
+				/**
+				 * Return to a snapshot of this world. Devices created since are destroyed.
+				 * @return 0 on success, ResourceNotAvailable if a device in the snapshot has been destroyed since
+				 */
+				int32_t RestoreSnapshot(const SimSnapshot & snapshot);
+
+				void GetDeviceStats(SimDeviceStats * stats, uint32_t capacity, uint32_t & numberFilled);
+				void ResetDeviceStats();
+				void SetProfileSummaryPeriod(uint32_t periodMs);
+
+				/** Log every frame delivered on the bus. @return 0 on success */
+				int32_t StartRecording(const std::string & path);
+				void StopRecording();
+				/**
+				 * Feed the device frames of a log to the robot, paced by this world's clock.
+				 * @return 0 on success
+				 */
+				int32_t StartReplay(const std::string & path);
+				void StopReplay();
+				bool IsReplaying();
+
+				/**
+				 * @param deviceTxDropCount frames devices lost to a full transmit queue on the bus
+				 * @param rxDropCount frames the robot lost to a full receive queue
+				 */
+				void GetStatus(float * percentBusUtilization, uint32_t * txFullCount, uint32_t * deviceTxDropCount, uint32_t * rxDropCount);
+				int32_t SendFrame(uint32_t messageID, const uint8_t * data, uint8_t dataSize);
+				int32_t ReceiveFrame(can::canframe_t * toFillArray, uint32_t capacity, uint32_t & numberFilled);
+				int32_t ReceiveFrameEx(can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t & numberFilled);
+				/** Same as ReceiveFrameEx, from one receive class only, see CANbus_ReceiveClassEx */
+				int32_t ReceiveClassEx(uint32_t rxClass, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t & numberFilled);
+				/** @return false if a class is out of range, see CANbus_SetRxClasses */
+				bool SetRxClasses(const can::canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass);
+				/** @return false if the class is out of range, see CANbus_SetRxCoalescing */
+				bool SetRxCoalescing(uint32_t rxClass, bool latestOnly);
+				/**
+				 * Lend the oldest received frames in place, see CANbus_LeaseFrames.
+				 * They stay valid until ReleaseFrames, any other receive, a snapshot restore, or the world going away.
+				 * @return number of frames lent, nothing waiting is not an error
+				 */
+				uint32_t LeaseFrames(RingSpans<can::canframe_ex_t> & spans, uint32_t maxCount);
+				/** Hand back the first count frames of the last lease, more than it lent is clamped */
+				void ReleaseFrames(uint32_t count);
+				int32_t GetRxEvent(intptr_t & handle);
+				int32_t Subscribe(uint32_t arbID, uint32_t mask, can::canframe_callback_t callback, void * context, uint32_t & handle);
+				int32_t Unsubscribe(uint32_t handle);
+
+			private:
+				SimWorld(const SimWorld &) = delete;
+				SimWorld & operator=(const SimWorld &) = delete;
+
+				/* all of these expect _lck to be held */
+				void DeliverFrame(const SimBusFrame & frame);
+				void QueueForRobot(const can::canframe_ex_t & frame);
+				void ReplayDueFrames(uint64_t nowNs);
+				int32_t PumpBus(uint64_t nowUs);
+				/* makes a config call, without our lock if the device serializes config itself, see SimDevice::SerializesConfig */
+				template <typename Call>
+				int32_t CallConfig(std::unique_lock<std::mutex> & lock, SimDevice & device, Call call);
+
+				void OnTimeAdvanced(uint64_t nowUs);
+				void PumpLoop();
+				template <typename Frame>
+				int32_t Receive(Frame * toFillArray, uint32_t capacity, uint32_t & numberFilled);
+				void StartPump();	//!< expects _lck to be held
+				void PrintProfileSummary();
+
+				const uint32_t _id;
+
+				std::mutex _lck;
+				/* shared so a config call can keep its device alive while it waits without our lock */
+				std::map<std::pair<DeviceType, int>, std::shared_ptr<SimDevice>> _devices;
+				uint64_t _lastGeneration = 0;	//!< handed to each device as it is added
+				SimTransport _transport;	//!< how devices created from now on are hosted
+				SimBus _bus;
+				SimRouter _router;	//!< device addresses learned from device frames
+				/* depth of each receive class, frames beyond this are dropped */
+				static const uint32_t kRxQueueCapacity = 1024;
+				RxClassQueue<kRxQueueCapacity> _rxFrames;	//!< frames that came off the bus for the robot, pushed and popped under _lck
+				uint32_t _leasedCount = 0;	//!< frames lent by the last LeaseFrames and not yet released
+				RxEvent _rxEvent;	//!< ready while _rxFrames has frames
+				RxDispatchTable _rxDispatch;	//!< subscriptions, called by whoever pumps the bus
+
+				/* frames only come off the bus when someone pumps it, so a poller or subscriber
+				 * needs this thread to pump for it in real time; started by the first GetRxEvent or Subscribe */
+				std::thread _pumpThread;
+				std::condition_variable _pumpCv;
+				bool _pumpRun = false;
+
+				SimRecordWriter _recorder;
+				SimRecordReader _replay;
+				uint64_t _replayBaseNs = 0;	//!< sim time the replay started at
+
+				/* periodic profile summary, off when the period is zero */
+				std::chrono::steady_clock::duration _summaryPeriod;
+				std::chrono::steady_clock::time_point _nextSummary;
+
+				/* declared last so it goes first, nothing calls back into a half-destroyed world */
+				SimClock _clock;
+			};
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
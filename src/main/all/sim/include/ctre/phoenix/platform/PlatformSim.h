@@ -0,0 +1,274 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+
+#include <cstdint>
+
+/**
+ * Simulation-only extensions to the platform API.
+ * These are exported by the sim platform only.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** How a simulated device's adapter library is hosted */
+			enum class SimTransport {
+				/** adapter is called directly from the robot's send/receive calls */
+				InProcess,
+				/** adapter runs on its own worker thread, send/receive only enqueue and dequeue */
+				Thread,
+				/**
+				 * adapter runs in its own host process and exchanges frames through shared memory (Linux only).
+				 * The host is the CTRE_PhoenixPlatform_simhost executable next to the sim library,
+				 * or the one named by the environment variable CTRE_SIM_HOST_PATH.
+				 */
+				Process,
+			};
+
+			/** Handle to an isolated simulated robot, see SimWorldCreate */
+			class SimWorld;
+
+			/** Saved state of a sim world, see SimSnapshotTake */
+			class SimSnapshot;
+
+			/** One configuration parameter for SimConfigSetBatch */
+			struct SimConfigParam {
+				uint32_t param;
+				uint32_t value;
+				uint32_t subValue;
+				uint32_t ordinal;
+			};
+
+			/** Counters for one kind of call into a device's adapter */
+			struct SimCallStats {
+				uint64_t calls;
+				uint64_t totalNs;	//!< time spent in the adapter
+				uint64_t maxNs;	//!< longest single call
+			};
+
+			/** Where one simulated device's adapter spends its time, see SimGetDeviceStats */
+			struct SimDeviceStats {
+				DeviceType type;
+				int id;
+				SimCallStats send;	//!< frames handed to the adapter
+				SimCallStats receive;	//!< adapter polled for frames
+				SimCallStats setTime;	//!< virtual clock updates
+				SimCallStats other;	//!< start, config, state and reset calls
+				uint64_t framesToDevice;
+				uint64_t framesFromDevice;
+			};
+
+			/**
+			 * Switch the sim clock between real time and virtual (lockstep) time.
+			 * In virtual time SleepUs does not sleep; the clock advances to the earliest wake time
+			 * once every thread in the lockstep is asleep, so simulations run as fast as the CPU allows.
+			 * A thread joins the lockstep with SimClockAttach, or the first time it calls SleepUs if it
+			 * never attached, and leaves with SimClockDetach or when it exits.
+			 * Devices are only polled as the clock advances or when the robot sends or receives.
+			 * Can also be enabled by setting the environment variable CTRE_SIM_VIRTUAL_TIME=1.
+			 *
+			 * Runs are only repeatable with in-process devices (SimTransport::InProcess).
+			 * Thread- and process-hosted devices get the new time and their frames through mailboxes
+			 * and the clock does not wait for them to catch up, so how many frames they have answered by
+			 * a given virtual time depends on the host's scheduling.
+			 *
+			 * @param enable true for virtual time, false for real time
+			 * @return 0 on success
+			 */
+			int32_t SimSetVirtualTime(bool enable);
+
+			/**
+			 * @return current sim time in microseconds, on the clock used for frame timestamps.
+			 */
+			uint64_t SimGetTimeUs();
+
+			/**
+			 * Put the calling thread in the lockstep of its world's virtual clock, see SimSetVirtualTime.
+			 * The clock then never advances while this thread is running, only once it sleeps.
+			 * Attach every robot thread before any of them sleeps, a thread that has not attached
+			 * yet does not hold the clock back.
+			 *
+			 * @return 0 on success
+			 */
+			int32_t SimClockAttach();
+
+			/**
+			 * Take the calling thread out of the lockstep, e.g. before it blocks on something other than SleepUs.
+			 *
+			 * @return 0 on success
+			 */
+			int32_t SimClockDetach();
+
+			/**
+			 * Select how devices created after this call are hosted.
+			 * Can also be selected with the environment variable CTRE_SIM_TRANSPORT=thread or CTRE_SIM_TRANSPORT=process.
+			 *
+			 * @param transport hosting model for new devices
+			 * @return 0 on success
+			 */
+			int32_t SimSetTransport(SimTransport transport);
+
+			/**
+			 * Set the bitrate of the simulated CAN bus.
+			 * Frames queue on the bus and arbitrate by ID, each taking its worst-case bit length at this rate.
+			 * Defaults to 1Mbps, or the environment variable CTRE_SIM_CAN_BITRATE if set.
+			 * A device that produces frames faster than the bus carries them loses the excess, and frames
+			 * that arrive while the robot's receive queue is full are dropped, see SimGetDropCounts.
+			 *
+			 * @param bitsPerSecond bus bitrate, 0 for an ideal bus that delivers instantly
+			 * @return 0 on success
+			 */
+			int32_t SimSetBusBitrate(uint32_t bitsPerSecond);
+
+			/**
+			 * Frames the calling thread's world's bus model dropped.
+			 * These are not bus errors, CANbus_GetStatus does not count them.
+			 *
+			 * @param deviceTxDropCount set to the frames devices lost to a full transmit queue, may be nullptr
+			 * @param rxDropCount set to the frames the robot lost to a full receive queue, may be nullptr
+			 * @return 0 on success
+			 */
+			int32_t SimGetDropCounts(uint32_t * deviceTxDropCount, uint32_t * rxDropCount);
+
+			/**
+			 * Apply a set of configuration parameters to one simulated device in a single call.
+			 * Parameters already known to hold the requested value are skipped, the rest reach the
+			 * adapter in one batch. SimConfigGet always reads from the adapter.
+			 *
+			 * @param type device type
+			 * @param id device ID
+			 * @param params parameters to apply
+			 * @param count number of parameters
+			 * @return 0 on success, ResourceNotAvailable if the device was not created,
+			 *         FeatureNotSupported if its adapter has no config exports
+			 */
+			int32_t SimConfigSetBatch(DeviceType type, int id, const SimConfigParam * params, uint32_t count);
+
+			/**
+			 * Create a new simulated robot with its own devices, CAN bus and clock.
+			 * Nothing is shared between worlds, so independent scenarios can run in parallel in one process.
+			 * Bind it to a thread with SimWorldSetCurrent before using the rest of the platform API.
+			 *
+			 * @return the new world, owned by the platform until SimWorldDestroy
+			 */
+			SimWorld * SimWorldCreate();
+
+			/**
+			 * Destroy a world created with SimWorldCreate and every device in it.
+			 * No other thread may still be bound to it.
+			 *
+			 * @param world world to destroy
+			 * @return 0 on success, InvalidParamValue for the default world or an unknown handle
+			 */
+			int32_t SimWorldDestroy(SimWorld * world);
+
+			/**
+			 * Bind the calling thread to a world.
+			 * Every Sim* call and every CANbus_* call made on this thread then acts on that world,
+			 * including SleepUs, which uses the world's clock. Threads start out in the default world.
+			 *
+			 * @param world world to bind to, nullptr for the default world
+			 * @return 0 on success, InvalidParamValue for a handle that is not a live world
+			 */
+			int32_t SimWorldSetCurrent(SimWorld * world);
+
+			/**
+			 * @return the world the calling thread is bound to
+			 */
+			SimWorld * SimWorldGetCurrent();
+
+			/**
+			 * Save the state of the calling thread's world: frames queued on the bus and for the robot,
+			 * the bus model, the virtual clock, cached configuration and each device's adapter state.
+			 * Adapters that export SaveState/LoadState are serialized; the rest are reset on restore.
+			 * Not supported for process-hosted devices.
+			 *
+			 * @param snapshot set to the new snapshot, free it with SimSnapshotRelease
+			 * @return 0 on success
+			 */
+			int32_t SimSnapshotTake(SimSnapshot ** snapshot);
+
+			/**
+			 * Return the calling thread's world to a snapshot taken in it, without reloading any library.
+			 * Devices created after the snapshot are destroyed. Call while no robot thread is using the world.
+			 *
+			 * @param snapshot snapshot from SimSnapshotTake
+			 * @return 0 on success, ResourceNotAvailable if a device in the snapshot was destroyed since
+			 */
+			int32_t SimSnapshotRestore(const SimSnapshot * snapshot);
+
+			/**
+			 * Free a snapshot.
+			 *
+			 * @param snapshot snapshot from SimSnapshotTake, may be nullptr
+			 * @return 0 on success
+			 */
+			int32_t SimSnapshotRelease(SimSnapshot * snapshot);
+
+			/**
+			 * Read the adapter call counters of every device in the calling thread's world.
+			 * Time is measured inside the adapter, on whichever thread or process hosts it.
+			 *
+			 * @param stats array to fill, one entry per device
+			 * @param capacity size of stats
+			 * @param numberFilled set to the number of entries filled
+			 * @return 0 on success
+			 */
+			int32_t SimGetDeviceStats(SimDeviceStats * stats, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * Zero the adapter call counters of every device in the calling thread's world.
+			 *
+			 * @return 0 on success
+			 */
+			int32_t SimResetDeviceStats();
+
+			/**
+			 * Print a per-device profile of the calling thread's world to stdout at a fixed period of wall time.
+			 * Can also be enabled with the environment variable CTRE_SIM_PROFILE_PERIOD_MS.
+			 *
+			 * @param periodMs time between summaries, 0 to stop
+			 * @return 0 on success
+			 */
+			int32_t SimSetProfileSummaryPeriod(uint32_t periodMs);
+
+			/**
+			 * Log every frame delivered on the calling thread's world's bus, in both directions,
+			 * to a compact binary file with sim timestamps. Replaces the file if it exists.
+			 * The default world can also be recorded by setting the environment variable CTRE_SIM_RECORD=path.
+			 *
+			 * @param path file to write
+			 * @return 0 on success
+			 */
+			int32_t SimStartRecording(const char * path);
+
+			/**
+			 * Stop recording and close the log.
+			 *
+			 * @return 0 on success
+			 */
+			int32_t SimStopRecording();
+
+			/**
+			 * Replay a log made with SimStartRecording into the calling thread's world.
+			 * The devices' frames are handed to CANbus_ReceiveFrame as the world's clock reaches their
+			 * recorded offset from the start of the log; use virtual time to replay as fast as possible.
+			 * While replaying, SimCreate succeeds without loading any adapter library.
+			 * The default world can also replay by setting the environment variable CTRE_SIM_REPLAY=path.
+			 *
+			 * @param path log to read
+			 * @return 0 on success, InvalidParamValue if the file is not a sim log
+			 */
+			int32_t SimStartReplay(const char * path);
+
+			/**
+			 * Stop replaying.
+			 *
+			 * @return 0 on success
+			 */
+			int32_t SimStopReplay();
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
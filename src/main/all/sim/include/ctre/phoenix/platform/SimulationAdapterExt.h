@@ -0,0 +1,160 @@
+/* no pragma once, the platform includes this with and without CTRE_CREATE_EXPORTS */
+#include <cstdint>
+
+/**
+ * Optional exports a simulation adapter library may provide on top of SimulationAdapter.h.
+ * The sim platform looks each one up when the device is created and skips it if absent.
+ *
+ * Adapter ABI v2 is the batched frame interface: an adapter that exports both
+ * ctre_phoenix_simulation_adapter_SendCANFrames and ctre_phoenix_simulation_adapter_ReceiveCANFrames
+ * is driven through them, otherwise the platform falls back to the one-frame v1 calls.
+ */
+
+#ifndef CTRE_SIM_ADAPTER_EXT_COMMON
+#define CTRE_SIM_ADAPTER_EXT_COMMON
+
+#if defined(WIN32) || defined(_WIN32) || defined(_WIN64)
+#define CTRE_SIM_ADAPTER_EXPORT extern "C" __declspec(dllexport)
+#else
+#define CTRE_SIM_ADAPTER_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+/** one CAN frame crossing the adapter boundary, fixed 16-byte layout */
+typedef struct {
+	uint32_t arbID;
+	uint8_t data[8];
+	uint8_t dlc;
+	uint8_t reserved[3];
+} ctre_phoenix_simulation_frame_t;
+
+/** one configuration parameter crossing the adapter boundary */
+typedef struct {
+	uint32_t param;
+	uint32_t value;
+	uint32_t subValue;
+	uint32_t ordinal;
+} ctre_phoenix_simulation_config_t;
+
+#endif
+
+#if defined(CTRE_CREATE_EXPORTS) && !defined(CTRE_SIM_ADAPTER_EXT_TYPEDEFS)
+#define CTRE_SIM_ADAPTER_EXT_TYPEDEFS
+
+/* typedefs for the platform side */
+typedef int32_t (*ctre_phoenix_simulation_adapter_SetTime_t)(uint64_t timeUs);
+typedef int32_t (*ctre_phoenix_simulation_adapter_SendCANFrames_t)(const ctre_phoenix_simulation_frame_t * frames, uint32_t count);
+typedef int32_t (*ctre_phoenix_simulation_adapter_ReceiveCANFrames_t)(ctre_phoenix_simulation_frame_t * frames, uint32_t capacity, uint32_t * numberFilled);
+typedef int32_t (*ctre_phoenix_simulation_adapter_GetPendingFrameCount_t)(uint32_t * count);
+typedef int32_t (*ctre_phoenix_simulation_adapter_ConfigSet_t)(uint32_t param, uint32_t value, uint32_t subValue, uint32_t ordinal);
+typedef int32_t (*ctre_phoenix_simulation_adapter_ConfigGet_t)(uint32_t param, uint32_t valueToSend, uint32_t * outValue, uint32_t * outSubValue, uint32_t ordinal);
+typedef int32_t (*ctre_phoenix_simulation_adapter_ConfigSetBatch_t)(const ctre_phoenix_simulation_config_t * params, uint32_t count);
+typedef int32_t (*ctre_phoenix_simulation_adapter_SaveState_t)(uint8_t * buffer, uint32_t capacity, uint32_t * size);
+typedef int32_t (*ctre_phoenix_simulation_adapter_LoadState_t)(const uint8_t * buffer, uint32_t size);
+typedef int32_t (*ctre_phoenix_simulation_adapter_Reset_t)(void);
+
+#elif !defined(CTRE_CREATE_EXPORTS) && !defined(CTRE_SIM_ADAPTER_EXT_PROTOTYPES)
+#define CTRE_SIM_ADAPTER_EXT_PROTOTYPES
+
+/* prototypes for the adapter side */
+
+/**
+ * Called each time the sim's virtual clock advances.
+ * Adapters should run their periodic work against this time instead of wall-clock time.
+ *
+ * @param timeUs new sim time in microseconds
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_SetTime(uint64_t timeUs);
+
+/**
+ * [v2] Hand several frames from the robot to the device in one call.
+ *
+ * @param frames frames in bus order
+ * @param count number of frames
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_SendCANFrames(const ctre_phoenix_simulation_frame_t * frames, uint32_t count);
+
+/**
+ * [v2] Take every frame the device has ready, up to capacity.
+ *
+ * @param frames array to fill
+ * @param capacity size of frames
+ * @param numberFilled set to the number of frames written, 0 if none are ready
+ * @return 0 on success, including when nothing was ready
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_ReceiveCANFrames(ctre_phoenix_simulation_frame_t * frames, uint32_t capacity, uint32_t * numberFilled);
+
+/**
+ * [v2, optional] Number of frames ReceiveCANFrames would return right now.
+ * Lets the platform skip devices with nothing to send.
+ *
+ * @param count set to the number of ready frames
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_GetPendingFrameCount(uint32_t * count);
+
+/**
+ * [optional] Set one configuration parameter.
+ * Without config exports SimConfigSet and SimConfigGet return FeatureNotSupported for the device.
+ *
+ * @param param parameter enum value
+ * @param value parameter value
+ * @param subValue parameter sub-value
+ * @param ordinal parameter ordinal
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_ConfigSet(uint32_t param, uint32_t value, uint32_t subValue, uint32_t ordinal);
+
+/**
+ * [optional] Read one configuration parameter.
+ *
+ * @param param parameter enum value
+ * @param valueToSend value sent with the request
+ * @param outValue set to the parameter value
+ * @param outSubValue set to the parameter sub-value
+ * @param ordinal parameter ordinal
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_ConfigGet(uint32_t param, uint32_t valueToSend, uint32_t * outValue, uint32_t * outSubValue, uint32_t ordinal);
+
+/**
+ * [optional] Set several configuration parameters in one call.
+ * Used in preference to ConfigSet when present.
+ *
+ * @param params parameters in the order they should be applied
+ * @param count number of parameters
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_ConfigSetBatch(const ctre_phoenix_simulation_config_t * params, uint32_t count);
+
+/**
+ * [optional] Serialize the device's state for a sim snapshot.
+ * Must be exported together with LoadState. Call with a null buffer to query the size needed.
+ *
+ * @param buffer where to write the state, may be null
+ * @param capacity size of buffer
+ * @param size set to the number of bytes the state takes
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_SaveState(uint8_t * buffer, uint32_t capacity, uint32_t * size);
+
+/**
+ * [optional] Restore state produced by SaveState.
+ *
+ * @param buffer serialized state
+ * @param size number of bytes in buffer
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_LoadState(const uint8_t * buffer, uint32_t size);
+
+/**
+ * [optional] Put the device back in its just-started state.
+ * Used on snapshot restore when the adapter can't serialize its state.
+ * Without it the platform runs the start routine again.
+ *
+ * @return 0 on success
+ */
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_Reset(void);
+
+#endif
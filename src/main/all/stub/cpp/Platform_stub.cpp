@@ -1,4 +1,8 @@
 #include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/FrameTime.h"
+#include "ctre/phoenix/platform/RxDispatch.h"
+#include "ctre/phoenix/platform/RxEvent.h"
 #include "ctre/phoenix/ErrorCode.h"
 
 #include <chrono>
@@ -22,6 +26,58 @@ namespace can {
 	{
 		return 0;
 	}
+	int32_t CANbus_ReceiveFrameEx(canframe_ex_t * /*toFillArray*/, uint32_t /*capacity*/, uint32_t * /*numberFilled*/)
+	{
+		return 0;
+	}
+	uint64_t CANbus_GetTimeNs()
+	{
+		return SteadyNowNs();
+	}
+	int32_t CANbus_LeaseFrames(canframe_lease_t * /*lease*/, uint32_t /*maxFrames*/)
+	{
+		return phoenix::ErrorCode::FeatureNotSupported;
+	}
+	int32_t CANbus_ReleaseFrames(uint32_t /*count*/)
+	{
+		return phoenix::ErrorCode::FeatureNotSupported;
+	}
+	int32_t CANbus_SetRxClasses(const canframe_class_rule_t * /*rules*/, uint32_t /*count*/, uint32_t /*defaultClass*/)
+	{
+		return phoenix::ErrorCode::FeatureNotSupported;
+	}
+	int32_t CANbus_SetRxCoalescing(uint32_t /*rxClass*/, bool /*latestOnly*/)
+	{
+		return phoenix::ErrorCode::FeatureNotSupported;
+	}
+	int32_t CANbus_ReceiveClassEx(uint32_t /*rxClass*/, canframe_ex_t * /*toFillArray*/, uint32_t /*capacity*/, uint32_t * /*numberFilled*/)
+	{
+		return phoenix::ErrorCode::FeatureNotSupported;
+	}
+	/* nothing is ever received, so subscriptions are only kept for their handles */
+	static RxDispatchTable rxDispatch;
+	int32_t CANbus_Subscribe(uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle)
+	{
+		if (handle == nullptr || rxDispatch.Add(arbID, mask, callback, context, *handle) == false)
+			return phoenix::ErrorCode::InvalidParamValue;
+		return 0;
+	}
+	int32_t CANbus_Unsubscribe(uint32_t handle)
+	{
+		if (rxDispatch.Remove(handle) == false)
+			return phoenix::ErrorCode::InvalidParamValue;
+		return 0;
+	}
+	int32_t CANbus_GetRxEvent(intptr_t * handle)
+	{
+		if (handle == nullptr)
+			return phoenix::ErrorCode::InvalidParamValue;
+		/* nothing is ever received, so it never becomes ready, but pollers can still register it */
+		static RxEvent rxEvent;
+		if (rxEvent.Open(*handle) == false)
+			return phoenix::ErrorCode::ResourceNotAvailable;
+		return 0;
+	}
     int32_t SetCANInterface(const char * /*interface*/) 
     {
         return 0;
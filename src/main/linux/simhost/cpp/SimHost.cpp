@@ -0,0 +1,141 @@
+/**
+ * Host for one process-hosted simulated device, see CreateProcessSimDevice.
+ * The sim platform starts this with the adapter library's path and the fds of the channel it shares
+ * with the robot process. The adapter is only ever loaded here, never in the robot process.
+ *
+ * usage: CTRE_PhoenixPlatform_simhost <library> <device id> <channel fd> <wake fd> <config done fd>
+ */
+#include "SimShm.h"
+#include "ctre/phoenix/runtime/LibLoader.h"
+
+#include <cstdlib>
+#include <iostream> // std::cout
+#include <memory>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace ctre::phoenix;
+using namespace ctre::phoenix::platform;
+
+namespace {
+	/* wait this long for inbound frames before polling the adapter again */
+	const int kIdleMs = 1;
+	/* same cap as the in-process pump */
+	const uint32_t kMaxFramesPerPoll = 16;
+
+	bool ParseFd(const char * text, int & fd)
+	{
+		char * end = nullptr;
+		long value = std::strtol(text, &end, 10);
+		if (end == text || *end != '\0' || value < 0 || value > 0xFFFF)
+			return false;
+		fd = static_cast<int>(value);
+		return true;
+	}
+
+	/* run the device until the robot says stop, @return the process exit code */
+	int Serve(SimDevice & device, SimShmChannel & shm, int wakeFd, int configDoneFd)
+	{
+		uint64_t lastTimeUs = 0;
+		while (shm.stop == 0) {
+			bool idle = true;
+
+			uint64_t timeUs = shm.timeUs;
+			if (timeUs != lastTimeUs) {
+				lastTimeUs = timeUs;
+				device.SetTime(timeUs);
+				idle = false;
+			}
+
+			SimFrame batch[kMaxFramesPerPoll];
+			uint32_t count = shm.toDevice.PopBulk(batch, kMaxFramesPerPoll);
+			if (count > 0) {
+				device.Send(batch, count);
+				idle = false;
+			}
+
+			/* only take what the ring has room for, the rest stays queued in the adapter */
+			uint32_t room = SimShmChannel::kRingCapacity - shm.fromDevice.Size();
+			if (room > kMaxFramesPerPoll) { room = kMaxFramesPerPoll; }
+			if (room > 0) {
+				(void)device.Receive(batch, room, count);
+				(void)shm.fromDevice.PushBulk(batch, count);
+				if (count > 0) { idle = false; }
+			}
+
+			/* take the call first, the robot may withdraw one it gave up waiting for */
+			SimShmConfigCall & call = shm.config;
+			uint32_t pending = SimShmConfigCall::kPending;
+			if (call.state.compare_exchange_strong(pending, SimShmConfigCall::kRunning)) {
+				if (call.isGet)
+					call.result = device.ConfigGet(call.params[0], call.valueToSend);
+				else
+					call.result = device.ConfigSet(call.params, call.count);
+				call.state = SimShmConfigCall::kDone;
+
+				uint64_t one = 1;
+				(void)write(configDoneFd, &one, sizeof(one));
+				idle = false;
+			}
+
+			if (idle) {
+				/* announce we are going to sleep, then re-check so a wake-up can't be missed */
+				shm.workerSleeping = 1;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (shm.toDevice.Empty() && shm.timeUs == lastTimeUs && shm.stop == 0 &&
+					call.state != SimShmConfigCall::kPending) {
+					struct pollfd pfd = { wakeFd, POLLIN, 0 };
+					(void)poll(&pfd, 1, kIdleMs);
+				}
+				shm.workerSleeping = 0;
+
+				uint64_t drained;
+				(void)read(wakeFd, &drained, sizeof(drained));
+			}
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	int shmFd = -1;
+	int wakeFd = -1;
+	int configDoneFd = -1;
+	if (argc != 6 || ParseFd(argv[3], shmFd) == false || ParseFd(argv[4], wakeFd) == false || ParseFd(argv[5], configDoneFd) == false) {
+		std::cout << "usage: " << argv[0] << " <library> <device id> <channel fd> <wake fd> <config done fd>" << std::endl;
+		return 2;
+	}
+	int id = std::atoi(argv[2]);
+
+	void * mem = mmap(nullptr, sizeof(SimShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+	if (mem == MAP_FAILED) {
+		std::cout << "Simulated device host could not map its channel" << std::endl;
+		return 1;
+	}
+	/* the robot constructed it, we only use it */
+	SimShmChannel & shm = *static_cast<SimShmChannel *>(mem);
+
+	std::unique_ptr<runtime::LibLoader> lib(new runtime::LibLoader());
+	try
+	{
+		lib->Open(argv[1]);
+	}
+	catch (const runtime::LibLoaderException & excep)
+	{
+		/* library contents must not be good */
+		shm.startResult = excep.GetPhoenixErrorCode();
+		return 1;
+	}
+
+	/* counters go in the channel so the robot side can read them */
+	std::unique_ptr<SimDevice> device = CreateLocalSimDevice(std::move(lib), &shm.profile);
+	int32_t err = device->Start(id);
+	shm.startResult = err;
+	if (err != 0)
+		return 1;
+
+	return Serve(*device, shm, wakeFd, configDoneFd);
+}
@@ -1,10 +1,18 @@
 #include "ctre/phoenix/platform/Platform.h"
 #include "ctre/phoenix/ErrorCode.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSocketCAN.h"
+#include "ctre/phoenix/platform/FrameTime.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+#include "ctre/phoenix/platform/RxClass.h"
+#include "ctre/phoenix/platform/RxDispatch.h"
+#include "ctre/phoenix/platform/RxEvent.h"
 #include <linux/can.h> //Probably doesn't exist in cross build tools (also can lib)
 #include <ifaddrs.h>
 
 #include <linux/can/raw.h>
 #include <net/if.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
@@ -13,11 +21,15 @@
 #include <stdio.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <cerrno>
 #include <cstring>
 #include <chrono>
 #include <thread>
 #include <iostream> // std::cout
+#include <queue>
 #include <string>
+#include <vector>
 
 namespace ctre {
 namespace phoenix {
@@ -25,6 +37,222 @@ namespace platform {
 namespace can {
 
     static int socket = -1;
+
+    /* rx thread reads the socket into rxFrames, so CANbus_ReceiveFrame never blocks */
+    static RxClassQueue<4096> rxFrames; //a ring per priority class
+    static RxEvent rxEvent; //declared before rxThread so the thread is gone before the event
+    static RxDispatchTable rxDispatch; //subscriptions, called by the rx thread
+    static std::atomic<bool> rxRun{false};
+    void StopRx();
+    static struct RxThread {
+        std::thread thread;
+        ~RxThread() { StopRx(); } //don't let a running thread terminate the process at exit
+    } rxThread;
+
+    /* senders queue into txQueue from any thread, one writer thread owns the socket's send side */
+    static MpscRing<struct can_frame, 1024> txQueue;
+    static RxEvent txWake; //same coalescing wake-up the rx side hands out, here it wakes the writer
+    static std::atomic<bool> txRun{false};
+    static std::atomic<uint32_t> txFullCount{0};
+    void StopTx();
+    static struct TxThread {
+        std::thread thread;
+        ~TxThread() { StopTx(); } //don't let a running thread terminate the process at exit
+    } txThread;
+
+    /** @return when the kernel received the frame on the platform clock, falling back to when it was read */
+    uint64_t ReceiveTimeNs(struct msghdr & msg, ClockMapper & clock) {
+        int64_t hostNowNs = static_cast<int64_t>(SteadyNowNs());
+        for (struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+                /* kernel stamps on the wall clock, which can step, so carry it onto the steady clock */
+                struct timespec stamp;
+                std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+                int64_t wallNs = static_cast<int64_t>(stamp.tv_sec) * 1000000000 + stamp.tv_nsec;
+                return static_cast<uint64_t>(clock.ToHostNs(wallNs, hostNowNs));
+            }
+        }
+        return static_cast<uint64_t>(hostNowNs);
+    }
+
+    void RxLoop(int sock) {
+        /* poll timeout bounds how long StopRx waits for us */
+        const int timeoutMs = 100;
+        const uint32_t kMaxFramesPerRead = 64;
+        ClockMapper clock;
+
+        while (rxRun) {
+            struct pollfd pfd;
+            pfd.fd = sock;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, timeoutMs) <= 0) {
+                continue;
+            }
+
+            /* drain whatever is waiting, one frame per read */
+            canframe_ex_t batch[kMaxFramesPerRead];
+            uint32_t count = 0;
+            while (count < kMaxFramesPerRead) {
+                struct can_frame frame;
+                struct iovec iov;
+                iov.iov_base = &frame;
+                iov.iov_len = sizeof(struct can_frame);
+                union {
+                    char buffer[CMSG_SPACE(sizeof(struct timespec))];
+                    struct cmsghdr align;
+                } control;
+                struct msghdr msg;
+                std::memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control.buffer;
+                msg.msg_controllen = sizeof(control.buffer);
+
+                ssize_t bytesRead = recvmsg(sock, &msg, MSG_DONTWAIT);
+                if (bytesRead != (ssize_t) sizeof(struct can_frame)) { //Error, nothing waiting or partial read
+                    break;
+                }
+                //See https://www.kernel.org/doc/Documentation/networking/can.txt section 
+                //4.1.1.1 CAN filter usage optimisation for masking details
+
+                //Don't set any flags on toFill for right now
+                canframe_ex_t & toFill = batch[count++];
+                toFill.arbID = frame.can_id & CAN_EFF_MASK;
+                std::memcpy(toFill.data, frame.data, frame.can_dlc);
+                toFill.dlc = frame.can_dlc;
+                toFill.flags = 0;
+                toFill.bus = 0;
+                toFill.reserved = 0;
+                toFill.timeStampNs = ReceiveTimeNs(msg, clock);
+            }
+            /* subscribers first, they are the ones in a hurry */
+            rxDispatch.Dispatch(batch, count);
+
+            /* sorted into their classes, a full class drops the newest frames and counts them */
+            if (rxFrames.PushBulk(batch, count) > 0) {
+                rxEvent.Signal();
+            }
+        }
+    }
+    void StopRx() {
+        rxRun = false;
+        if (rxThread.thread.joinable()) {
+            rxThread.thread.join();
+        }
+    }
+    void StartRx() {
+        StopRx();
+        rxRun = true;
+        rxThread.thread = std::thread(RxLoop, socket);
+    }
+
+    /* frames the writer has taken off txQueue, ranked by their full 29-bit ID because the lowest ID
+     * wins arbitration on the bus, so it goes out first here too. Equal IDs stay in send order */
+    struct TxEntry {
+        uint32_t arbID;
+        uint64_t seq;
+        struct can_frame frame;
+    };
+    struct TxAfter {
+        bool operator()(const TxEntry & a, const TxEntry & b) const {
+            if (a.arbID != b.arbID) {
+                return a.arbID > b.arbID;
+            }
+            return a.seq > b.seq;
+        }
+    };
+    /* bounded so a stalled device still backs up into txQueue and senders see BufferFull */
+    static const size_t kTxRankedCapacity = 1024;
+    static std::priority_queue<TxEntry, std::vector<TxEntry>, TxAfter> txRanked; //writer thread only
+    static uint64_t txSeq = 0; //writer thread only
+
+    bool NextTx(struct can_frame & frame) {
+        /* rank everything queued so far, then take the winner */
+        TxEntry entry;
+        while (txRanked.size() < kTxRankedCapacity && txQueue.Pop(entry.frame)) {
+            entry.arbID = entry.frame.can_id & CAN_EFF_MASK;
+            entry.seq = txSeq++;
+            txRanked.push(entry);
+        }
+        if (txRanked.empty()) {
+            return false;
+        }
+        frame = txRanked.top().frame;
+        txRanked.pop();
+        return true;
+    }
+
+    void TxLoop(int sock, int wakeFd) {
+        /* poll timeout bounds how long StopTx waits for us */
+        const int timeoutMs = 100;
+        const int maxBackoffMs = 16;
+
+        struct can_frame frame;
+        bool pending = false;
+        int backoffMs = 0;
+        while (txRun) {
+            if (pending == false) {
+                pending = NextTx(frame);
+            }
+            if (pending == false) {
+                /* nothing queued, sleep until a sender signals */
+                txWake.Clear([] { return txQueue.Empty(); });
+                struct pollfd pfd;
+                pfd.fd = wakeFd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                (void)poll(&pfd, 1, timeoutMs);
+                continue;
+            }
+
+            ssize_t bytesWritten = send(sock, &frame, sizeof(struct can_frame), MSG_DONTWAIT);
+            if (bytesWritten == (ssize_t) sizeof(struct can_frame)) {
+                pending = false;
+                backoffMs = 0;
+            }
+            else if (errno == ENOBUFS || errno == EAGAIN) {
+                /* device queue is full, hold on to the frame and wait for room rather than drop it */
+                if (backoffMs == 0) {
+                    ++txFullCount;
+                    struct pollfd pfd;
+                    pfd.fd = sock;
+                    pfd.events = POLLOUT;
+                    pfd.revents = 0;
+                    (void)poll(&pfd, 1, timeoutMs);
+                    backoffMs = 1;
+                }
+                else {
+                    /* CAN sockets can poll writable while the device queue is still full, back off instead of spinning */
+                    std::this_thread::sleep_for(std::chrono::milliseconds(backoffMs));
+                    backoffMs = std::min(backoffMs * 2, maxBackoffMs);
+                }
+            }
+            else {
+                /* anything else won't get better by retrying */
+                std::cout << "Socket Can Error: " << strerror(errno) << std::endl;
+                pending = false;
+                backoffMs = 0;
+            }
+        }
+    }
+    void StopTx() {
+        txRun = false;
+        if (txThread.thread.joinable()) {
+            txThread.thread.join();
+        }
+    }
+    void StartTx() {
+        StopTx();
+        intptr_t wakeFd = -1;
+        if (txWake.Open(wakeFd) == false) {
+            std::cout << "Socket Can Error: could not create tx wake-up" << std::endl;
+            return;
+        }
+        txRun = true;
+        txThread.thread = std::thread(TxLoop, socket, static_cast<int>(wakeFd));
+    }
+
     int InitializeSocket(struct ifreq &ifr) {
         std::cout << "using interface: " << ifr.ifr_name << std::endl;
         
@@ -33,9 +261,22 @@ namespace can {
         addr.can_ifindex = ifr.ifr_ifindex;
 
         bind(socket, (struct sockaddr *)&addr, sizeof(addr));
+
+        /* have the kernel stamp each frame as it arrives, read latency then doesn't show in timeStampNs */
+        int enable = 1;
+        setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+
+        StartRx();
+        StartTx();
         return 0;
     }
     int32_t SetCANInterface(const char * interface) {
+        /* stop using the old socket before replacing it, frames still queued go out on the new one */
+        StopRx();
+        StopTx();
+        if (socket >= 0) {
+            close(socket);
+        }
         socket = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
         struct ifreq ifr;
         strcpy(ifr.ifr_name, interface );
@@ -45,64 +286,142 @@ namespace can {
     }
 
 
-	void CANbus_GetStatus(float * /*percentBusUtilization*/, uint32_t * /*busOffCount*/, uint32_t * /*txFullCount*/, uint32_t * /*receiveErrorCount*/,
+	void CANbus_GetStatus(float * /*percentBusUtilization*/, uint32_t * /*busOffCount*/, uint32_t * txFullCount, uint32_t * /*receiveErrorCount*/,
 		uint32_t * /*transmitErrorCount*/, int32_t * /*status*/)
 	{
-		std::cout << "CANbus_GetStatus (WIP)" << std::endl;
+		/* frames lost to a full rx ring are not bus errors, see SocketCANGetRxOverflowCount */
+		/* sends that found the tx queue or the device queue full */
+		if (txFullCount) { *txFullCount = can::txFullCount.load(std::memory_order_relaxed); }
 	}
 	int32_t CANbus_SendFrame(uint32_t messageID, const uint8_t *data, uint8_t dataSize)
 	{
 		struct can_frame frame;
+        std::memset(&frame, 0, sizeof(frame));
 
         std::memcpy(frame.data, data, dataSize);
         frame.can_id = messageID | CAN_EFF_FLAG;
         frame.can_dlc = dataSize;
 
-        errno = 0;
-
-        ssize_t err =  write(socket, &frame, sizeof(struct can_frame));
-
-        if(err == -1) {
-
-            std::cout << "Socket Can Error: " << strerror(errno) << std::endl;
+        if (txRun == false) { //No interface yet
+            return phoenix::ErrorCode::TxFailed;
+        }
 
-            return -1;
+        /* the writer thread sends it, retrying while the device queue is full */
+        if (txQueue.Push(frame) == false) {
+            ++txFullCount;
+            return phoenix::ErrorCode::BufferFull;
         }
+        txWake.Signal();
         
 		return 0;
 	}
 	int32_t CANbus_ReceiveFrame(canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
 	{
-        struct can_frame frame;
-       
         *numberFilled = 0;
 
         if(capacity <= 0) {
             return 0; //Shouldn't happen
         }
- 
-        auto bytesRead = read(socket, &frame, sizeof(struct can_frame)); //Only can read one at a time it appears
-        if(bytesRead <= 0) { //Error or nothing recieved
-            return 1;
+
+        /* rx thread does the reading, just take what it has queued */
+        *numberFilled = ReceiveAsCanframes(rxFrames, toFillArray, capacity);
+        if(*numberFilled < capacity) { //Drained, stop the rx event polling ready
+            rxEvent.Clear([] { return rxFrames.Empty(); });
         }
-        else if((bytesRead < (int) sizeof(struct can_frame)) != 0) {  //partial read, shouldn't ever happen
+        if(*numberFilled == 0) { //Nothing recieved
             return 1;
         }
-        else if(bytesRead > (int) (sizeof(struct can_frame))) { //Too much recieved, shouldn't ever happen
+
+		return 0;
+	}
+	int32_t CANbus_ReceiveFrameEx(canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+        *numberFilled = rxFrames.PopBulk(toFillArray, capacity);
+        if(*numberFilled < capacity) {
+            rxEvent.Clear([] { return rxFrames.Empty(); });
+        }
+        if(*numberFilled == 0) { //Nothing recieved, same as CANbus_ReceiveFrame
             return 1;
         }
-        else { //Success
-            //See https://www.kernel.org/doc/Documentation/networking/can.txt section 
-            //4.1.1.1 CAN filter usage optimisation for masking details
-             
-            //Don't set any flags on toFill for right now
-            toFillArray[0].arbID = frame.can_id & CAN_EFF_MASK;
-            std::memcpy(toFillArray[0].data, frame.data, frame.can_dlc);
-            toFillArray[0].dlc = frame.can_dlc;
-            toFillArray[0].timeStampUs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count() - 1530000000000);//take a bit off the top to ensure no overflow (shouldn't matter, but still...)
-            *numberFilled = 1;
+		return 0;
+	}
+	uint64_t CANbus_GetTimeNs()
+	{
+		return SteadyNowNs();
+	}
+	int32_t CANbus_LeaseFrames(canframe_lease_t * lease, uint32_t maxFrames)
+	{
+        /* lend the frames straight out of the rx ring */
+        RingSpans<canframe_ex_t> spans;
+        if (rxFrames.Lease(spans, maxFrames) < maxFrames) {
+            rxEvent.Clear([] { return rxFrames.Empty(); });
+        }
+        lease->first = spans.first;
+        lease->firstCount = spans.firstCount;
+        lease->second = spans.second;
+        lease->secondCount = spans.secondCount;
+		return 0;
+	}
+	int32_t CANbus_ReleaseFrames(uint32_t count)
+	{
+        rxFrames.Release(count);
+		return 0;
+	}
+	int32_t CANbus_Subscribe(uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle)
+	{
+        if (handle == nullptr || rxDispatch.Add(arbID, mask, callback, context, *handle) == false) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+		return 0;
+	}
+	int32_t CANbus_Unsubscribe(uint32_t handle)
+	{
+        if (rxDispatch.Remove(handle) == false) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+		return 0;
+	}
+	int32_t CANbus_GetRxEvent(intptr_t * handle)
+	{
+        if (handle == nullptr) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+        /* rx thread signals it after each batch it queues */
+        if (rxEvent.Open(*handle) == false) {
+            return phoenix::ErrorCode::ResourceNotAvailable;
+        }
+		return 0;
+	}
+	int32_t CANbus_SetRxClasses(const canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+	{
+        if (rules == nullptr && count > 0) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+        if (rxFrames.SetClasses(rules, count, defaultClass) == false) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+		return 0;
+	}
+	int32_t CANbus_SetRxCoalescing(uint32_t rxClass, bool latestOnly)
+	{
+        if (rxFrames.SetCoalescing(rxClass, latestOnly) == false) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+		return 0;
+	}
+	int32_t CANbus_ReceiveClassEx(uint32_t rxClass, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+        *numberFilled = 0;
+        if (rxClass >= kRxClassCount) {
+            return phoenix::ErrorCode::InvalidParamValue;
+        }
+        *numberFilled = rxFrames.PopBulk(rxClass, toFillArray, capacity);
+        if(*numberFilled < capacity) {
+            rxEvent.Clear([] { return rxFrames.Empty(); });
+        }
+        if(*numberFilled == 0) { //Nothing recieved, same as CANbus_ReceiveFrame
+            return 1;
         }
-
 		return 0;
 	}
 
@@ -134,6 +453,8 @@ int32_t SimDestroyAll() {
 }
 
 int32_t DisposePlatform() {
+	can::StopRx();
+	can::StopTx();
 	return phoenix::ErrorCode::OK;
 }
 
@@ -141,6 +462,14 @@ int32_t StartPlatform() {
 	return phoenix::ErrorCode::OK;
 }
 
+int32_t SocketCANGetRxOverflowCount(uint32_t * count) {
+	if (count == nullptr) {
+		return phoenix::ErrorCode::InvalidParamValue;
+	}
+	*count = static_cast<uint32_t>(can::rxFrames.Dropped());
+	return phoenix::ErrorCode::OK;
+}
+
 int32_t SimConfigGet(DeviceType /*type*/, uint32_t /*param*/, uint32_t /*valueToSend*/, uint32_t & /*outValueReceived*/, uint32_t & /*outSubvalue*/, uint32_t /*ordinal*/, uint32_t /*id*/) {
     return 0;
 }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+
+#include <cstdint>
+
+/**
+ * SocketCAN extensions to the platform API.
+ * These are exported by the socketcan platform only.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/**
+			 * @param count set to the number of frames dropped because the receive queue was full.
+			 * These are not bus errors, CANbus_GetStatus does not count them.
+			 * @return 0 on success, InvalidParamValue if count is null
+			 */
+			int32_t SocketCANGetRxOverflowCount(uint32_t * count);
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
@@ -1,10 +1,23 @@
 #include "ctre/phoenix/platform/Platform.h"
 #include "ctre/phoenix/runtime/LibLoader.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/FrameMerge.h"
+#include "ctre/phoenix/platform/FrameTime.h"
+#include "ctre/phoenix/platform/PlatformICS.h"
+#include "ctre/phoenix/platform/RingBuffer.h"
+#include "ctre/phoenix/platform/RxClass.h"
+#include "ctre/phoenix/platform/RxDispatch.h"
+#include "ctre/phoenix/platform/RxEvent.h"
 #include "ctre/phoenix/ErrorCode.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <memory>
 #include <thread>
 #include <mutex>
-#include <deque>
 #include <iostream> // std::cout
 
 #include "icsneo40DLLAPI.h"
@@ -14,57 +27,178 @@ using namespace ctre::phoenix;
 using namespace ctre::phoenix::platform;
 using namespace ctre::phoenix::platform::can;
 /* ------------------------------ */
+/** icsneo entry points, resolved once when the device opens */
+struct IcsNeoApi {
+	FINDNEODEVICES findNeoDevices = nullptr;
+	OPENNEODEVICE openNeoDevice = nullptr;
+	CLOSEPORT closePort = nullptr;
+	TXMESSAGES txMessages = nullptr;
+	WAITFORRXMSGS waitForRxMessages = nullptr;
+	GETMESSAGES getMessages = nullptr;
+	GETLASTAPIERROR getLastAPIError = nullptr;
+	GETTSFORMSG getTimeStampForMsg = nullptr;	//!< optional, frames get the host read time without it
+
+	bool IsResolved() const { return closePort != nullptr; }
+
+	/** @return 0 on success, the LibLoader error if an export is missing */
+	int32_t Resolve(ctre::phoenix::runtime::LibLoader & lib)
+	{
+		try
+		{
+			IcsNeoApi api;
+			api.findNeoDevices = lib.LookupFunc<FINDNEODEVICES>("icsneoFindNeoDevices");
+			api.openNeoDevice = lib.LookupFunc<OPENNEODEVICE>("icsneoOpenNeoDevice");
+			api.txMessages = lib.LookupFunc<TXMESSAGES>("icsneoTxMessages");
+			api.waitForRxMessages = lib.LookupFunc<WAITFORRXMSGS>("icsneoWaitForRxMessagesWithTimeOut");
+			api.getMessages = lib.LookupFunc<GETMESSAGES>("icsneoGetMessages");
+			api.getLastAPIError = lib.LookupFunc<GETLASTAPIERROR>("icsneoGetLastAPIError");
+			api.closePort = lib.LookupFunc<CLOSEPORT>("icsneoClosePort");
+			api.getTimeStampForMsg = LookupOptional<GETTSFORMSG>(lib, "icsneoGetTimeStampForMsg");
+			*this = api;
+		}
+		catch (const ctre::phoenix::runtime::LibLoaderException & excep)
+		{
+			/* DLL was good but func is missing? */
+			return excep.GetPhoenixErrorCode();
+		}
+		return ErrorCode::OK;
+	}
+
+private:
+	template <typename T>
+	static T LookupOptional(ctre::phoenix::runtime::LibLoader & lib, const char * name)
+	{
+		try
+		{
+			return lib.LookupFunc<T>(name);
+		}
+		catch (const ctre::phoenix::runtime::LibLoaderException &)
+		{
+			return nullptr;
+		}
+	}
+};
+
+/** One network on one tool, frames for it are routed here by the tool's rx thread */
+struct ICSChannel {
+	std::atomic<void *> device{ nullptr };	//!< tool handle, null while closed
+	int networkID = NETID_HSCAN;
+	int32_t serialNumber = 0;
+	int32_t deviceType = 0;
+
+	/* rx coll, filled by the tool's rx thread and drained by ReceiveFrame, a ring per priority class */
+	RxClassQueue<4096> rxFrames;
+	/* ready while rxFrames has frames, see CANbus_GetRxEvent */
+	RxEvent rxEvent;
+	/* subscriptions, called by the rx thread before a frame is queued */
+	RxDispatchTable rxDispatch;
+	bool rxQueued = false;	//!< frames pushed this poll but not yet signalled, only touched by the rx thread
+};
+
+/** One open tool and the rx thread that drains it */
+struct ICSDevice {
+	void * handle = nullptr;
+	std::thread rxThread;
+
+	/* dumb allocation for icsneo, only touched by the rx thread */
+	std::unique_ptr<icsSpyMessage[]> rxCache;
+	static const int kRxCacheSize = 20000;
+
+	/* hardware to host time, only touched by the rx thread */
+	ClockMapper clock;
+
+	/* channel for each icsneo NetworkID, null for networks we don't receive */
+	ICSChannel * routes[256] = {};
+};
+
 class ValueCANWrapper
 {
 private:
 	/* singleton pattern */
 	ValueCANWrapper() {	
-		_state = eRunning;
+		_state = eClosed;
+		LoadNetworksFromEnv();
+
+		/* every bus slot is a merge source, ones with no bus behind them just stay empty */
+		for (uint32_t bus = 0; bus < kMaxBuses; ++bus) {
+			_merger.AddSource([this, bus](canframe_ex_t * toFill, uint32_t capacity) {
+				uint32_t numberFilled = 0;
+				(void)RecEx(bus, toFill, capacity, &numberFilled);
+				return numberFilled;
+			});
+		}
 	}
 	~ValueCANWrapper() { 
 		Dispose();
 	}
 	ValueCANWrapper(const ValueCANWrapper &) {}
 
-	/* dumb allocation for icsneo*/
-	icsSpyMessage _rxCache[20000];
+	static const uint32_t kMaxDevices = 10;
+	static const uint32_t kMaxBuses = 16;
+
+	/* tools, only changed under _lckTool while no rx thread runs */
+	ICSDevice _devices[kMaxDevices];
+	uint32_t _deviceCount = 0;
+
+	/* buses, fixed storage so the fast path never sees one freed */
+	ICSChannel _channels[kMaxBuses];
+	std::atomic<uint32_t> _busCount{ 0 };
+
+	/* time-ordered receive across every bus, see ICSReceiveMerged */
+	FrameMerger _merger;
+	std::atomic<uint64_t> _reorderWindowNs{ FrameMerger::kDefaultWindowNs };
+
+	/* networks opened on each tool */
+	int _networks[kMaxBuses] = { NETID_HSCAN };
+	uint32_t _networkCount = 1;
 
-	/* rx coll*/
-	std::deque<canframe_t> _rxFrames;
-	std::recursive_timed_mutex _lckRx;
+	/* rx threads */
+	std::atomic<bool> _rxRun{ false };
 
 	/* DLL and Hardware management */
 	ctre::phoenix::runtime::LibLoader _lib;
-	void * _device = 0;
+	IcsNeoApi _api;	//!< written under _lckTool before _state goes to eOpen
 	std::recursive_timed_mutex _lckTool;
 
-	/* state */
-	enum {
-		eRunning,
+	/* state, only eOpen takes the fast path, every other state goes through Connect under _lckTool */
+	enum State {
+		eClosed,	//!< tools not open yet, or closed after a fault or a change of networks
+		eOpen,	//!< tools open and rx threads running
+		eFault,	//!< an rx thread saw its tool stop responding and exited
 		eDisposing,
 		eDisposed
-	} _state;
+	};
+	std::atomic<State> _state;
 
-
-	void SetStateDisposed()
+	void LoadNetworksFromEnv()
 	{
-		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
-		_state = eDisposing;
-	}
-	void SetStateDisposing()
-	{
-		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
-		_state = eDisposed;
+		const char * env = std::getenv("CTRE_ICSNEO_NETWORKS");
+		if (env == nullptr)
+			return;
+
+		int networks[kMaxBuses];
+		uint32_t count = 0;
+		while (*env != '\0' && count < kMaxBuses) {
+			char * end = nullptr;
+			long networkID = std::strtol(env, &end, 0);
+			if (end == env || networkID < 0 || networkID > 255)
+				break;
+			networks[count++] = static_cast<int>(networkID);
+			env = (*end == ',') ? end + 1 : end;
+		}
+		if (count > 0) {
+			std::copy(networks, networks + count, _networks);
+			_networkCount = count;
+		}
 	}
 	int32_t CheckState()
 	{
-		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
-
-		switch (_state) {
-			case eRunning:
-				return 0;
-			default:
+		switch (_state.load(std::memory_order_acquire)) {
+			case eDisposing:
+			case eDisposed:
 				return ErrorCode::GeneralError;
+			default:
+				return 0;
 		}
 	}
 	int32_t LoadDll()
@@ -73,7 +207,17 @@ private:
 
 		if (_lib.IsOpen() == false) {
 
-			try { _lib.Open("icsneo40.dll"); }
+			/* allow a different icsneo build, such as a fake one for testing without hardware */
+			const char * libName = std::getenv("CTRE_ICSNEO_LIBRARY_PATH");
+			if (libName == nullptr || *libName == '\0') {
+#if defined(_WIN32)
+				libName = "icsneo40.dll";
+#else
+				libName = "libicsneolegacy.so";
+#endif
+			}
+
+			try { _lib.Open(libName); }
 			catch (...)
 			{
 
@@ -83,120 +227,169 @@ private:
 		}
 		return ctre::phoenix::ErrorCode::OK;
 	}
-	int32_t OpenDevice()
+	int32_t OpenDevices()
 	{
 		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
 
-		if (_device == 0)
+		/* an rx thread gave up on its tool, reap them all before trying again */
+		if (_state.load(std::memory_order_acquire) == eFault) {
+			CloseDevices();
+			_state.store(eClosed, std::memory_order_release);
+		}
+
+		if (_api.IsResolved() == false) {
+			int32_t retval = _api.Resolve(_lib);
+			if (retval != 0)
+				return retval;
+		}
+
+		if (_deviceCount == 0)
 		{
-			/* find it */
-			NeoDevice temp[10];
-			int num = 10;
-			_lib.LookupFunc<FINDNEODEVICES>("icsneoFindNeoDevices")(0xFFFFFFFF, temp, &num);
-			/* open it */
-			uint8_t nets[] = { 0,1,2,3,4,5,6,7,8,9,10 };
-			(void)_lib.LookupFunc<OPENNEODEVICE>("icsneoOpenNeoDevice")(temp, &_device, nets, 0, 0);
+			/* find them, in serial number order so bus numbers don't depend on USB enumeration */
+			NeoDevice found[kMaxDevices];
+			int num = kMaxDevices;
+			_api.findNeoDevices(0xFFFFFFFF, found, &num);
+			if (num < 0)
+				num = 0;
+			std::stable_sort(found, found + num, [](const NeoDevice & a, const NeoDevice & b) { return a.SerialNumber < b.SerialNumber; });
+
+			/* open them */
+			uint32_t busCount = 0;
+			for (int i = 0; i < num && _deviceCount < kMaxDevices; ++i) {
+				uint8_t nets[] = { 0,1,2,3,4,5,6,7,8,9,10 };
+				void * handle = nullptr;
+				(void)_api.openNeoDevice(&found[i], &handle, nets, 0, 0);
+				if (handle == nullptr)
+					continue;
+
+				ICSDevice & device = _devices[_deviceCount++];
+				device.handle = handle;
+				device.clock.Reset();
+				std::fill(std::begin(device.routes), std::end(device.routes), nullptr);
+				if (device.rxCache == nullptr)
+					device.rxCache.reset(new icsSpyMessage[ICSDevice::kRxCacheSize]);
+
+				/* one bus per network */
+				for (uint32_t n = 0; n < _networkCount && busCount < kMaxBuses; ++n) {
+					ICSChannel & channel = _channels[busCount++];
+					channel.networkID = _networks[n];
+					channel.serialNumber = found[i].SerialNumber;
+					channel.deviceType = found[i].DeviceType;
+					channel.device.store(handle);
+					device.routes[_networks[n]] = &channel;
+				}
+			}
+			_busCount.store(busCount, std::memory_order_release);
+
+			/* start draining them */
+			_rxRun = true;
+			for (uint32_t i = 0; i < _deviceCount; ++i)
+				_devices[i].rxThread = std::thread(&ValueCANWrapper::RxLoop, this, &_devices[i]);
 		}
 		/* let caller know if open was successful */
-		if (_device == 0)
+		if (_busCount.load() == 0)
 			return ErrorCode::ResourceNotAvailable;
 
 		return ErrorCode::OK;
 	}
-	int32_t CloseDevice()
+	void CloseDevices()
 	{
-		/* helpful */
-		using Ms = std::chrono::milliseconds;
-
-		/* temps for API call */
-		int numError = 0;
-
-		/* attempt to lock - with 500ms timeout*/
-		if (_lckTool.try_lock_for(Ms(500))) {
-			// [
-
-			/* safely close device */
-			_lib.LookupFunc<CLOSEPORT>("icsneoClosePort")(_device, &numError);
-			_device = 0;
+		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
 
-			// ]
-			_lckTool.unlock();
+		/* hide the buses from the fast path first */
+		_busCount.store(0, std::memory_order_release);
+		for (uint32_t i = 0; i < kMaxBuses; ++i)
+			_channels[i].device.store(nullptr);
 
-			return ErrorCode::GeneralError;
+		/* stop the rx threads, they never take _lckTool so this can't deadlock */
+		_rxRun = false;
+		for (uint32_t i = 0; i < _deviceCount; ++i) {
+			if (_devices[i].rxThread.joinable())
+				_devices[i].rxThread.join();
 		}
-		else {
-			/* close it anyway*/
-			_lib.LookupFunc<CLOSEPORT>("icsneoClosePort")(_device, &numError);
-			_device = 0;
 
-			return ErrorCode::OK;
+		/* safely close the tools */
+		for (uint32_t i = 0; i < _deviceCount; ++i) {
+			int numError = 0;
+			_api.closePort(_devices[i].handle, &numError);
+			_devices[i].handle = nullptr;
 		}
+		_deviceCount = 0;
+
+		/* frames already queued are still handed out, they were received before the close */
 	}
-	void ProcError(unsigned long err)
+	/**
+	 * Slow path of every send and receive: load the library, open the tools and start the rx threads.
+	 * Only runs until the tools are open, or after an rx thread reports a fault.
+	 */
+	int32_t Connect()
 	{
-		if (err == 75) // NEOVI_ERROR_DLL_NEOVI_NO_RESPONSE
-		{
-			std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
+		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
 
-			/* close device */
-			(void)CloseDevice();
+		int32_t retval = 0;
 
-			/* lock and clear rx frames */
-			{
-				std::lock_guard < std::recursive_timed_mutex > lockRx(_lckRx);
-				_rxFrames.clear();
-			}
+		if (retval == 0)
+			retval = CheckState();
+
+		if (retval == 0)
+			retval = LoadDll();
+
+		if (retval == 0)
+			retval = OpenDevices();
+
+		/* Dispose may have started while we waited for the lock, don't reopen under it */
+		if (retval == 0) {
+			State expected = eClosed;
+			if (_state.compare_exchange_strong(expected, eOpen) == false && expected != eOpen)
+				retval = ErrorCode::GeneralError;
 		}
+
+		return retval;
 	}
-	int32_t Send(uint32_t messageID, const uint8_t * data, uint8_t dataSize)
-	{
-		/* encode ICS tx message */
-		icsSpyMessage msg;
-		memset(&msg, 0, sizeof(msg));
-		msg.StatusBitField |= SPY_STATUS_XTD_FRAME;
-		msg.ArbIDOrHeader = messageID;
-		memcpy(msg.Data, data, dataSize);
-		msg.NumberBytesData = dataSize;
-		/* pass it to icsneo api */
-		int ret = _lib.LookupFunc<TXMESSAGES>("icsneoTxMessages")(_device, &msg, NETID_HSCAN, 1);
-		if (ret == 1)
-			return ctre::phoenix::ErrorCode::OK;
-		return ctre::phoenix::ErrorCode::GeneralError;
-	}
-	int32_t Rec(canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	/**
+	 * Body of a tool's rx thread. Blocks in the icsneo API so the caller of CANbus_ReceiveFrame doesn't have to.
+	 * Never takes _lckTool, so it can always be joined by a thread holding it.
+	 */
+	void RxLoop(ICSDevice * device)
 	{
-		/* initialize outputs */
-		*numberFilled = 0;
+		/* wait timeout bounds how long CloseDevices waits for us */
+		const unsigned int timeoutMs = 100;
 
-		/* wait for frames */
-		int numMessages = 0, numErr = 0;
-		const int timeoutMs = 100;
-		int bOneIfMsgReceived = _lib.LookupFunc<WAITFORRXMSGS>("icsneoWaitForRxMessagesWithTimeOut")(_device, timeoutMs);
-
-		/* retrieve them */
-		if (bOneIfMsgReceived == 1)
-			_lib.LookupFunc<GETMESSAGES>("icsneoGetMessages")(_device, _rxCache, &numMessages, &numErr);
-		else if (bOneIfMsgReceived < 0) {
-			/* error condition*/
-			unsigned long errorNumber = 0;
-			_lib.LookupFunc<GETLASTAPIERROR>("icsneoGetLastAPIError")(_device, &errorNumber);
-			ProcError(errorNumber);
-		}
+		icsSpyMessage * rxCache = device->rxCache.get();
 
-		/* did we get anything from ics */
-		if (numMessages > 0)
-		{
-			/* lock the container */
-			std::lock_guard < std::recursive_timed_mutex > lock(_lckRx);
+		while (_rxRun) {
+			/* wait for frames */
+			int numMessages = 0, numErr = 0;
+			int bOneIfMsgReceived = _api.waitForRxMessages(device->handle, timeoutMs);
 
-			/* queue up the received messages */
+			/* retrieve them */
+			if (bOneIfMsgReceived == 1) {
+				_api.getMessages(device->handle, rxCache, &numMessages, &numErr);
+			}
+			else if (bOneIfMsgReceived < 0) {
+				/* error condition*/
+				unsigned long errorNumber = 0;
+				_api.getLastAPIError(device->handle, &errorNumber);
+				if (errorNumber == 75) { // NEOVI_ERROR_DLL_NEOVI_NO_RESPONSE
+					/* tool is gone, next send/receive closes and reopens them all */
+					State expected = eOpen;
+					(void)_state.compare_exchange_strong(expected, eFault);
+					return;
+				}
+			}
+
+			/* one host read time for the whole batch, hardware times place each frame within it */
+			int64_t hostNowNs = static_cast<int64_t>(SteadyNowNs());
+
+			/* route the received messages in one pass */
 			for (int i = 0; i < numMessages; ++i)
 			{
 				/* get ics msg */
-				const icsSpyMessage & newMsg = _rxCache[i];
+				icsSpyMessage & newMsg = rxCache[i];
+				ICSChannel * channel = device->routes[newMsg.NetworkID];
 
-				if (newMsg.NetworkID != NETID_HSCAN) {
-					/* not HSCAN, ignore it */
+				if (channel == nullptr) {
+					/* not a network we have a bus for, ignore it */
 				}
 				else if (newMsg.StatusBitField & SPY_STATUS_TX_MSG) {
 					/* this is a tx receipt, not a message event */
@@ -205,44 +398,87 @@ private:
 					/* this is a bus error event, not a message event */
 				}
 				else {
-
 					/* copy to our format*/
-					canframe_t cf;
-					cf.arbID = newMsg.ArbIDOrHeader;
-					cf.dlc = newMsg.NumberBytesData;
-					memcpy(cf.data, newMsg.Data, newMsg.NumberBytesData);
-
-					/* insert to coll */
-					{
-						if (_rxFrames.size() > 1000) {
-							/* overflow*/
-							CTRE_ASSERT(0);
-						}
-						else {
-							_rxFrames.push_back(cf);
-						}
-					}
+					canframe_ex_t cf = {};
+					cf.bus = static_cast<uint8_t>(channel - _channels);
+					cf.arbID = static_cast<uint32_t>(newMsg.ArbIDOrHeader);
+					cf.dlc = (newMsg.NumberBytesData < 8) ? newMsg.NumberBytesData : 8;
+					memcpy(cf.data, newMsg.Data, cf.dlc);
+					cf.timeStampNs = ReceiveTimeNs(*device, newMsg, hostNowNs);
+					cf.flags = 0;
+
+					channel->rxDispatch.Dispatch(&cf, 1);
+
+					/* insert to coll, a full ring counts the frame as lost */
+					if (channel->rxFrames.Push(cf))
+						channel->rxQueued = true;
 				}
 			}
-		}
-
 
-		/* pass to caller */
-		{
-			std::lock_guard < std::recursive_timed_mutex > lock(_lckRx);
-			
-			size_t avail = _rxFrames.size();
-			size_t numToCopy = (avail < capacity) ? avail : capacity;
-
-			for (size_t i = 0; i < numToCopy; ++i)
-			{
-				toFillArray[i] = _rxFrames.front();
-				_rxFrames.pop_front();
+			/* one signal per bus per poll, however many frames it got */
+			for (uint32_t n = 0; n < _networkCount; ++n) {
+				ICSChannel * channel = device->routes[_networks[n]];
+				if (channel != nullptr && channel->rxQueued) {
+					channel->rxQueued = false;
+					channel->rxEvent.Signal();
+				}
 			}
+		}
+	}
+	/** @return when the frame came off the bus on the host steady clock, falling back to when it was read */
+	uint64_t ReceiveTimeNs(ICSDevice & device, icsSpyMessage & msg, int64_t hostNowNs)
+	{
+		double hwSeconds = 0;
+		if (_api.getTimeStampForMsg == nullptr || _api.getTimeStampForMsg(device.handle, &msg, &hwSeconds) != 1)
+			return static_cast<uint64_t>(hostNowNs);
+		int64_t hwNs = static_cast<int64_t>(std::llround(hwSeconds * 1e9));
+		return static_cast<uint64_t>(device.clock.ToHostNs(hwNs, hostNowNs));
+	}
+	int32_t Send(uint32_t bus, uint32_t messageID, const uint8_t * data, uint8_t dataSize)
+	{
+		if (bus >= _busCount.load(std::memory_order_acquire))
+			return ErrorCode::InvalidParamValue;
 
-			*numberFilled = static_cast<uint32_t>(numToCopy);
+		ICSChannel & channel = _channels[bus];
+		/* the tool may be closing or not reopened yet */
+		void * device = channel.device.load(std::memory_order_acquire);
+		if (device == nullptr)
+			return ErrorCode::ResourceNotAvailable;
 
-		}
+		/* encode ICS tx message */
+		icsSpyMessage msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.StatusBitField |= SPY_STATUS_XTD_FRAME;
+		msg.ArbIDOrHeader = messageID;
+		memcpy(msg.Data, data, dataSize);
+		msg.NumberBytesData = dataSize;
+		/* pass it to icsneo api */
+		int ret = _api.txMessages(device, &msg, channel.networkID, 1);
+		if (ret == 1)
+			return ctre::phoenix::ErrorCode::OK;
+		return ctre::phoenix::ErrorCode::GeneralError;
+	}
+	int32_t Rec(uint32_t bus, canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+		if (bus >= _busCount.load(std::memory_order_acquire))
+			return ErrorCode::InvalidParamValue;
+
+		/* rx threads do the waiting, just take what has been queued */
+		ICSChannel & channel = _channels[bus];
+		*numberFilled = ReceiveAsCanframes(channel.rxFrames, toFillArray, capacity);
+		if (*numberFilled < capacity)
+			channel.rxEvent.Clear([&channel] { return channel.rxFrames.Empty(); });
+		return 0;
+	}
+	int32_t RecEx(uint32_t bus, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+		if (bus >= _busCount.load(std::memory_order_acquire))
+			return ErrorCode::InvalidParamValue;
+
+		ICSChannel & channel = _channels[bus];
+		*numberFilled = channel.rxFrames.PopBulk(toFillArray, capacity);
+		if (*numberFilled < capacity)
+			channel.rxEvent.Clear([&channel] { return channel.rxFrames.Empty(); });
 		return 0;
 	}
 
@@ -252,46 +488,255 @@ public:
 		static ValueCANWrapper instance;
 		return instance;
 	}
-	int32_t SendFrame(uint32_t messageID, const uint8_t * data, uint8_t dataSize)
+	int32_t SendFrame(uint32_t bus, uint32_t messageID, const uint8_t * data, uint8_t dataSize)
 	{
 		int32_t retval = 0;
 
-		if (retval == 0)
-			retval = CheckState();
+		/* steady state is one atomic load, no lock and no symbol lookup */
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
 
 		if (retval == 0)
-			retval = LoadDll();
+			retval = Send(bus, messageID, data, dataSize);
 
-		if (retval == 0)
-			retval = OpenDevice();
+		return retval;
+	}
+	int32_t ReceiveFrame(uint32_t bus, canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+		int32_t retval = 0;
+
+		/* initialize outputs */
+		*numberFilled = 0;
+
+		/* steady state is one atomic load, no lock and no symbol lookup */
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
 
 		if (retval == 0)
-			retval = Send(messageID, data, dataSize);
+			retval = Rec(bus, toFillArray, capacity, numberFilled);
 
 		return retval;
 	}
-	int32_t ReceiveFrame(canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	int32_t ReceiveFrameEx(uint32_t bus, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
 	{
 		int32_t retval = 0;
 
-		if (retval == 0)
-			retval = CheckState();
+		/* initialize outputs */
+		*numberFilled = 0;
 
-		if (retval == 0)
-			retval = LoadDll();
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
 
 		if (retval == 0)
-			retval = OpenDevice();
+			retval = RecEx(bus, toFillArray, capacity, numberFilled);
 
-		if (retval == 0)
-			retval = Rec( toFillArray, capacity,  numberFilled);
+		return retval;
+	}
+	int32_t ReceiveMerged(canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+		int32_t retval = 0;
+
+		/* initialize outputs */
+		*numberFilled = 0;
+
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+
+		if (retval == 0) {
+			_merger.SetWindowNs(_reorderWindowNs.load(std::memory_order_relaxed));
+			*numberFilled = _merger.Receive(toFillArray, capacity, SteadyNowNs());
+		}
+		return retval;
+	}
+	void SetReorderWindow(uint32_t windowUs)
+	{
+		_reorderWindowNs.store(static_cast<uint64_t>(windowUs) * 1000, std::memory_order_relaxed);
+	}
+	int32_t LeaseFrames(uint32_t bus, canframe_lease_t * lease, uint32_t maxFrames)
+	{
+		int32_t retval = 0;
+
+		/* initialize outputs */
+		*lease = canframe_lease_t();
+
+		/* steady state is one atomic load, no lock and no symbol lookup */
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+
+		if (retval == 0 && bus >= _busCount.load(std::memory_order_acquire))
+			retval = ErrorCode::InvalidParamValue;
+
+		if (retval == 0) {
+			/* lend the frames straight out of the bus's rx ring */
+			ICSChannel & channel = _channels[bus];
+			RingSpans<canframe_ex_t> spans;
+			if (channel.rxFrames.Lease(spans, maxFrames) < maxFrames)
+				channel.rxEvent.Clear([&channel] { return channel.rxFrames.Empty(); });
+			lease->first = spans.first;
+			lease->firstCount = spans.firstCount;
+			lease->second = spans.second;
+			lease->secondCount = spans.secondCount;
+		}
+		return retval;
+	}
+	int32_t ReleaseFrames(uint32_t bus, uint32_t count)
+	{
+		/* buses live in fixed storage, so a release after a reconnect still lands on the same ring */
+		if (bus >= kMaxBuses)
+			return ErrorCode::InvalidParamValue;
+
+		_channels[bus].rxFrames.Release(count);
+		return ErrorCode::OK;
+	}
+	int32_t Subscribe(uint32_t bus, uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle)
+	{
+		if (handle == nullptr)
+			return ErrorCode::InvalidParamValue;
+
+		int32_t retval = 0;
+
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+
+		if (retval == 0 && bus >= _busCount.load(std::memory_order_acquire))
+			retval = ErrorCode::InvalidParamValue;
+
+		/* like the rx event, subscriptions belong to the bus slot and survive reconnects */
+		if (retval == 0 && _channels[bus].rxDispatch.Add(arbID, mask, callback, context, *handle) == false)
+			retval = ErrorCode::InvalidParamValue;
 
 		return retval;
 	}
+	int32_t Unsubscribe(uint32_t bus, uint32_t handle)
+	{
+		if (bus >= kMaxBuses || _channels[bus].rxDispatch.Remove(handle) == false)
+			return ErrorCode::InvalidParamValue;
+		return ErrorCode::OK;
+	}
+	int32_t SetRxClasses(uint32_t bus, const canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+	{
+		if (bus >= kMaxBuses || (rules == nullptr && count > 0))
+			return ErrorCode::InvalidParamValue;
+
+		/* the classes belong to the bus slot, like its subscriptions */
+		if (_channels[bus].rxFrames.SetClasses(rules, count, defaultClass) == false)
+			return ErrorCode::InvalidParamValue;
+		return ErrorCode::OK;
+	}
+	int32_t SetRxCoalescing(uint32_t bus, uint32_t rxClass, bool latestOnly)
+	{
+		if (bus >= kMaxBuses || _channels[bus].rxFrames.SetCoalescing(rxClass, latestOnly) == false)
+			return ErrorCode::InvalidParamValue;
+		return ErrorCode::OK;
+	}
+	int32_t ReceiveClassEx(uint32_t bus, uint32_t rxClass, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+	{
+		int32_t retval = 0;
+
+		/* initialize outputs */
+		*numberFilled = 0;
+
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+
+		if (retval == 0 && (bus >= _busCount.load(std::memory_order_acquire) || rxClass >= kRxClassCount))
+			retval = ErrorCode::InvalidParamValue;
+
+		if (retval == 0) {
+			ICSChannel & channel = _channels[bus];
+			*numberFilled = channel.rxFrames.PopBulk(rxClass, toFillArray, capacity);
+			if (*numberFilled < capacity)
+				channel.rxEvent.Clear([&channel] { return channel.rxFrames.Empty(); });
+		}
+		return retval;
+	}
+	int32_t GetRxEvent(uint32_t bus, intptr_t * handle)
+	{
+		if (handle == nullptr)
+			return ErrorCode::InvalidParamValue;
+
+		int32_t retval = 0;
+
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+
+		if (retval == 0 && bus >= _busCount.load(std::memory_order_acquire))
+			retval = ErrorCode::InvalidParamValue;
+
+		/* the event belongs to the bus slot, so it stays registered across reconnects */
+		if (retval == 0 && _channels[bus].rxEvent.Open(*handle) == false)
+			retval = ErrorCode::ResourceNotAvailable;
+
+		return retval;
+	}
+	int32_t SetNetworks(const int32_t * networkIDs, uint32_t count)
+	{
+		if (networkIDs == nullptr || count == 0 || count > kMaxBuses)
+			return ErrorCode::InvalidParamValue;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (networkIDs[i] < 0 || networkIDs[i] > 255)
+				return ErrorCode::InvalidParamValue;
+		}
+
+		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
+
+		int32_t retval = CheckState();
+		if (retval != 0)
+			return retval;
+
+		/* reopen with the new buses on next use */
+		State state = _state.load();
+		if (state == eOpen || state == eFault) {
+			_state.store(eClosed);
+			CloseDevices();
+		}
+		for (uint32_t i = 0; i < count; ++i)
+			_networks[i] = static_cast<int>(networkIDs[i]);
+		_networkCount = count;
+		return ErrorCode::OK;
+	}
+	int32_t GetBuses(ICSBusInfo * buses, uint32_t capacity, uint32_t * numberFilled)
+	{
+		*numberFilled = 0;
+
+		int32_t retval = 0;
+		if (_state.load(std::memory_order_acquire) != eOpen)
+			retval = Connect();
+		if (retval != 0)
+			return retval;
+
+		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
+
+		uint32_t busCount = _busCount.load();
+		uint32_t count = (busCount < capacity) ? busCount : capacity;
+		for (uint32_t i = 0; i < count; ++i) {
+			buses[i].serialNumber = _channels[i].serialNumber;
+			buses[i].deviceType = _channels[i].deviceType;
+			buses[i].networkID = _channels[i].networkID;
+		}
+		*numberFilled = count;
+		return ErrorCode::OK;
+	}
+	/** frames dropped because a bus's rx ring was full */
+	int32_t GetRxOverflowCount(uint32_t bus, uint32_t * count) const
+	{
+		if (count == nullptr)
+			return ErrorCode::InvalidParamValue;
+		*count = 0;
+		if (bus >= kMaxBuses)
+			return ErrorCode::InvalidParamValue;
+		*count = static_cast<uint32_t>(_channels[bus].rxFrames.Dropped());
+		return ErrorCode::OK;
+	}
 	void Dispose() {
-		SetStateDisposing();
-		CloseDevice();
-		SetStateDisposed();
+		std::lock_guard < std::recursive_timed_mutex > lock(_lckTool);
+
+		if (_state.load() == eDisposed)
+			return;
+
+		_state.store(eDisposing);
+		CloseDevices();
+		_state.store(eDisposed);
 	}
 };
 
@@ -302,14 +747,55 @@ namespace ctre {
 			namespace can {
 				void CANbus_GetStatus(float * /*percentBusUtilization*/, uint32_t * /*busOffCount*/, uint32_t * /*txFullCount*/, uint32_t * /*receiveErrorCount*/, uint32_t * /*transmitErrorCount*/, int32_t * /*status*/)
 				{
+					/* frames lost to a full rx ring are not bus errors, see ICSGetRxOverflowCount */
 				}
 				int32_t CANbus_SendFrame(uint32_t messageID, const uint8_t * data, uint8_t dataSize)
 				{
-					return ValueCANWrapper::GetInstance().SendFrame(messageID, data, dataSize);
+					return ValueCANWrapper::GetInstance().SendFrame(0, messageID, data, dataSize);
 				}
 				int32_t CANbus_ReceiveFrame(canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
 				{
-					return ValueCANWrapper::GetInstance().ReceiveFrame( toFillArray, capacity,  numberFilled);
+					return ValueCANWrapper::GetInstance().ReceiveFrame(0, toFillArray, capacity,  numberFilled);
+				}
+				int32_t CANbus_ReceiveFrameEx(canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+				{
+					return ValueCANWrapper::GetInstance().ReceiveFrameEx(0, toFillArray, capacity, numberFilled);
+				}
+				uint64_t CANbus_GetTimeNs()
+				{
+					return SteadyNowNs();
+				}
+				int32_t CANbus_LeaseFrames(canframe_lease_t * lease, uint32_t maxFrames)
+				{
+					return ValueCANWrapper::GetInstance().LeaseFrames(0, lease, maxFrames);
+				}
+				int32_t CANbus_ReleaseFrames(uint32_t count)
+				{
+					return ValueCANWrapper::GetInstance().ReleaseFrames(0, count);
+				}
+				int32_t CANbus_Subscribe(uint32_t arbID, uint32_t mask, canframe_callback_t callback, void * context, uint32_t * handle)
+				{
+					return ValueCANWrapper::GetInstance().Subscribe(0, arbID, mask, callback, context, handle);
+				}
+				int32_t CANbus_Unsubscribe(uint32_t handle)
+				{
+					return ValueCANWrapper::GetInstance().Unsubscribe(0, handle);
+				}
+				int32_t CANbus_GetRxEvent(intptr_t * handle)
+				{
+					return ValueCANWrapper::GetInstance().GetRxEvent(0, handle);
+				}
+				int32_t CANbus_SetRxClasses(const canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+				{
+					return ValueCANWrapper::GetInstance().SetRxClasses(0, rules, count, defaultClass);
+				}
+				int32_t CANbus_SetRxCoalescing(uint32_t rxClass, bool latestOnly)
+				{
+					return ValueCANWrapper::GetInstance().SetRxCoalescing(0, rxClass, latestOnly);
+				}
+				int32_t CANbus_ReceiveClassEx(uint32_t rxClass, canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+				{
+					return ValueCANWrapper::GetInstance().ReceiveClassEx(0, rxClass, toFillArray, capacity, numberFilled);
 				}
 				int32_t SetCANInterface(const char * /*interface*/)
 				{
@@ -366,6 +852,87 @@ namespace ctre {
 				return ErrorCode::NotImplemented;
 			}
 
+			int32_t ICSSetNetworks(const int32_t * networkIDs, uint32_t count)
+			{
+				return ValueCANWrapper::GetInstance().SetNetworks(networkIDs, count);
+			}
+
+			int32_t ICSGetBuses(ICSBusInfo * buses, uint32_t capacity, uint32_t * numberFilled)
+			{
+				return ValueCANWrapper::GetInstance().GetBuses(buses, capacity, numberFilled);
+			}
+
+			int32_t ICSSendFrame(uint32_t bus, uint32_t messageID, const uint8_t * data, uint8_t dataSize)
+			{
+				return ValueCANWrapper::GetInstance().SendFrame(bus, messageID, data, dataSize);
+			}
+
+			int32_t ICSReceiveFrame(uint32_t bus, can::canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+			{
+				return ValueCANWrapper::GetInstance().ReceiveFrame(bus, toFillArray, capacity, numberFilled);
+			}
+
+			int32_t ICSReceiveFrameEx(uint32_t bus, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+			{
+				return ValueCANWrapper::GetInstance().ReceiveFrameEx(bus, toFillArray, capacity, numberFilled);
+			}
+
+			int32_t ICSReceiveMerged(can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+			{
+				return ValueCANWrapper::GetInstance().ReceiveMerged(toFillArray, capacity, numberFilled);
+			}
+
+			int32_t ICSSetReorderWindow(uint32_t windowUs)
+			{
+				ValueCANWrapper::GetInstance().SetReorderWindow(windowUs);
+				return ErrorCode::OK;
+			}
+
+			int32_t ICSLeaseFrames(uint32_t bus, can::canframe_lease_t * lease, uint32_t maxFrames)
+			{
+				return ValueCANWrapper::GetInstance().LeaseFrames(bus, lease, maxFrames);
+			}
+
+			int32_t ICSReleaseFrames(uint32_t bus, uint32_t count)
+			{
+				return ValueCANWrapper::GetInstance().ReleaseFrames(bus, count);
+			}
+
+			int32_t ICSSubscribe(uint32_t bus, uint32_t arbID, uint32_t mask, can::canframe_callback_t callback, void * context, uint32_t * handle)
+			{
+				return ValueCANWrapper::GetInstance().Subscribe(bus, arbID, mask, callback, context, handle);
+			}
+
+			int32_t ICSUnsubscribe(uint32_t bus, uint32_t handle)
+			{
+				return ValueCANWrapper::GetInstance().Unsubscribe(bus, handle);
+			}
+
+			int32_t ICSGetRxEvent(uint32_t bus, intptr_t * handle)
+			{
+				return ValueCANWrapper::GetInstance().GetRxEvent(bus, handle);
+			}
+
+			int32_t ICSSetRxClasses(uint32_t bus, const can::canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass)
+			{
+				return ValueCANWrapper::GetInstance().SetRxClasses(bus, rules, count, defaultClass);
+			}
+
+			int32_t ICSSetRxCoalescing(uint32_t bus, uint32_t rxClass, bool latestOnly)
+			{
+				return ValueCANWrapper::GetInstance().SetRxCoalescing(bus, rxClass, latestOnly);
+			}
+
+			int32_t ICSReceiveClassEx(uint32_t bus, uint32_t rxClass, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled)
+			{
+				return ValueCANWrapper::GetInstance().ReceiveClassEx(bus, rxClass, toFillArray, capacity, numberFilled);
+			}
+
+			int32_t ICSGetRxOverflowCount(uint32_t bus, uint32_t * count)
+			{
+				return ValueCANWrapper::GetInstance().GetRxOverflowCount(bus, count);
+			}
+
 			int32_t DisposePlatform() {
 
 				//ctre::phoenix::platform::can::CANComm_Dispose();
@@ -1,6 +1,15 @@
 //FILE: icsneo40DLLAPI.H
 
+#if defined(_WIN32)
 #include <windows.h>
+#else
+/* just enough of windows.h to build against a non-Windows icsneo library */
+#define __stdcall
+#define __declspec(x)
+typedef void * HINSTANCE;
+typedef char TCHAR;
+typedef unsigned char byte;
+#endif
 #include "icsnVC40.h"
 
 
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+
+#include <cstdint>
+
+/**
+ * ICS (neoVI / ValueCAN) extensions to the platform API.
+ * These are exported by the ics platform only.
+ *
+ * Every network of every connected tool is a bus, numbered from 0.
+ * Tools are ordered by serial number and each tool's networks follow the order given to ICSSetNetworks.
+ * Bus 0 is the one used by the CANbus_* functions.
+ */
+namespace ctre {
+	namespace phoenix {
+		namespace platform {
+
+			/** One network on one tool, see ICSGetBuses */
+			struct ICSBusInfo {
+				int32_t serialNumber;	//!< serial number of the tool
+				int32_t deviceType;	//!< icsneo device type of the tool
+				int32_t networkID;	//!< icsneo network ID, such as 1 for HS-CAN
+			};
+
+			/**
+			 * Select which networks of each tool become buses.
+			 * Tools already open are closed and reopened with the new networks on the next call that uses them,
+			 * which renumbers the buses.
+			 * Defaults to HS-CAN only, or the comma separated network IDs in the environment variable
+			 * CTRE_ICSNEO_NETWORKS, such as CTRE_ICSNEO_NETWORKS=1,42,44 for HS-CAN, HS-CAN2 and HS-CAN3.
+			 *
+			 * @param networkIDs icsneo network IDs
+			 * @param count number of network IDs, at least 1
+			 * @return 0 on success, InvalidParamValue if the list is empty or too long
+			 */
+			int32_t ICSSetNetworks(const int32_t * networkIDs, uint32_t count);
+
+			/**
+			 * Open every connected tool if not already open and list the buses.
+			 *
+			 * @param buses array to fill, indexed by bus
+			 * @param capacity size of buses
+			 * @param numberFilled set to the number of entries filled
+			 * @return 0 on success, ResourceNotAvailable if no tool could be opened
+			 */
+			int32_t ICSGetBuses(ICSBusInfo * buses, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * Same as CANbus_SendFrame, on any bus.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus
+			 */
+			int32_t ICSSendFrame(uint32_t bus, uint32_t messageID, const uint8_t * data, uint8_t dataSize);
+
+			/**
+			 * Same as CANbus_ReceiveFrame, on any bus. Never waits.
+			 * Each bus may only be received from by one thread at a time.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus
+			 */
+			int32_t ICSReceiveFrame(uint32_t bus, can::canframe_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * Same as CANbus_ReceiveFrameEx, on any bus.
+			 * Tools that report hardware receive times have them carried onto the CANbus_GetTimeNs clock.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus
+			 */
+			int32_t ICSReceiveFrameEx(uint32_t bus, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * Receive from every bus at once, in receive time order. canframe_ex_t::bus says which bus each frame came from.
+			 * A frame is held back until it is older than the reorder window, so one that took longer to reach
+			 * the host on another bus can still be put ahead of it.
+			 * Draws from the same queues as the per-bus calls, so don't mix the two.
+			 *
+			 * @return 0 on success, ResourceNotAvailable if no tool could be opened
+			 */
+			int32_t ICSReceiveMerged(can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * How long ICSReceiveMerged holds frames back to put them in order, 5000 us by default.
+			 * Longer tolerates slower tools at the cost of latency.
+			 *
+			 * @return 0
+			 */
+			int32_t ICSSetReorderWindow(uint32_t windowUs);
+
+			/**
+			 * Same as CANbus_LeaseFrames, on any bus.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus
+			 */
+			int32_t ICSLeaseFrames(uint32_t bus, can::canframe_lease_t * lease, uint32_t maxFrames);
+
+			/**
+			 * Same as CANbus_ReleaseFrames, on any bus.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus
+			 */
+			int32_t ICSReleaseFrames(uint32_t bus, uint32_t count);
+
+			/**
+			 * Same as CANbus_Subscribe, on any bus. Each bus has its own subscriptions,
+			 * called from the receive thread of the tool the bus is on.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus or callback or handle is null
+			 */
+			int32_t ICSSubscribe(uint32_t bus, uint32_t arbID, uint32_t mask, can::canframe_callback_t callback, void * context, uint32_t * handle);
+
+			/**
+			 * Same as CANbus_Unsubscribe, on any bus.
+			 *
+			 * @param bus bus index the subscription was made on
+			 * @return 0 on success, InvalidParamValue if there is no such subscription on that bus
+			 */
+			int32_t ICSUnsubscribe(uint32_t bus, uint32_t handle);
+
+			/**
+			 * Same as CANbus_GetRxEvent, on any bus. Each bus has its own handle.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus or handle is null
+			 */
+			int32_t ICSGetRxEvent(uint32_t bus, intptr_t * handle);
+
+			/**
+			 * Same as CANbus_SetRxClasses, on any bus. Each bus has its own classes.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus or a class is not below kRxClassCount
+			 */
+			int32_t ICSSetRxClasses(uint32_t bus, const can::canframe_class_rule_t * rules, uint32_t count, uint32_t defaultClass);
+
+			/**
+			 * Same as CANbus_SetRxCoalescing, on any bus.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus or class
+			 */
+			int32_t ICSSetRxCoalescing(uint32_t bus, uint32_t rxClass, bool latestOnly);
+
+			/**
+			 * Same as CANbus_ReceiveClassEx, on any bus.
+			 *
+			 * @param bus bus index, see ICSGetBuses
+			 * @return 0 on success, InvalidParamValue if there is no such bus or class
+			 */
+			int32_t ICSReceiveClassEx(uint32_t bus, uint32_t rxClass, can::canframe_ex_t * toFillArray, uint32_t capacity, uint32_t * numberFilled);
+
+			/**
+			 * @param bus bus index, see ICSGetBuses
+			 * @param count set to the number of frames dropped because the bus's receive queue was full.
+			 * These are not bus errors, CANbus_GetStatus does not count them.
+			 * @return 0 on success, InvalidParamValue if there is no such bus or count is null
+			 */
+			int32_t ICSGetRxOverflowCount(uint32_t bus, uint32_t * count);
+
+		} // namespace platform
+	} // namespace phoenix
+} // namespace ctre
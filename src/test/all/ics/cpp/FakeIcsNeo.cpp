@@ -0,0 +1,166 @@
+/**
+ * Stand-in for the icsneo library, so the ICS platform can be tested and benchmarked without a tool.
+ * Point the platform at it with CTRE_ICSNEO_LIBRARY_PATH.
+ *
+ * Every tool it reports is always open and sends always succeed. Each rx wait returns after 1 ms with a
+ * burst of frames, their arbIDs count up across calls and data[0..3] holds the host time they were made.
+ * Hardware timestamps run 100 ppm fast from a 5000 s offset, so clock alignment has something to correct.
+ *
+ * Tuned with environment variables:
+ *   CTRE_FAKE_ICSNEO_DEVICES      number of tools found, default 1, serial numbers count down from 300
+ *   CTRE_FAKE_ICSNEO_BURST        frames per read, default 10
+ *   CTRE_FAKE_ICSNEO_TWO_CHANNELS set to put every other frame on HSCAN2
+ *   CTRE_FAKE_ICSNEO_NO_HW_TIME   set to fail icsneoGetTimeStampForMsg
+ *
+ * Exports are undecorated, so on 32-bit Windows the platform will not find them, use a 64-bit build.
+ */
+#if defined(_WIN32)
+#include <windows.h>
+#define FAKE_ICSNEO_EXPORT extern "C" __declspec(dllexport)
+#else
+/* just enough of windows.h for icsnVC40.h, same as icsneo40DLLAPI.h */
+#define __stdcall
+#define __declspec(x)
+typedef char TCHAR;
+typedef unsigned char byte;
+#define FAKE_ICSNEO_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+#include "icsnVC40.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace {
+	const int kMaxDevices = 8;
+	const int kDefaultBurst = 10;
+	/* frames are read back this long after they were "made" */
+	const int64_t kReadLatencyUs = 300;
+
+	std::atomic<uint32_t> nextArbID{ 0 };
+	/* handles we give out, each holds its tool's serial number */
+	int32_t serialNumbers[kMaxDevices] = {};
+
+	int EnvInt(const char * name, int defaultValue, int minValue, int maxValue)
+	{
+		const char * text = std::getenv(name);
+		if (text == nullptr || *text == '\0')
+			return defaultValue;
+		int value = std::atoi(text);
+		if (value < minValue) { return minValue; }
+		if (value > maxValue) { return maxValue; }
+		return value;
+	}
+
+	bool EnvSet(const char * name)
+	{
+		const char * text = std::getenv(name);
+		return text != nullptr && *text != '\0';
+	}
+
+	int64_t HostNowUs()
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoFindNeoDevices(unsigned long deviceTypes, NeoDevice * pNeoDevice, int * pNumDevices)
+{
+	(void)deviceTypes;
+	int capacity = (*pNumDevices < kMaxDevices) ? *pNumDevices : kMaxDevices;
+	int count = EnvInt("CTRE_FAKE_ICSNEO_DEVICES", 1, 0, capacity);
+	for (int i = 0; i < count; ++i) {
+		memset(&pNeoDevice[i], 0, sizeof(pNeoDevice[i]));
+		pNeoDevice[i].SerialNumber = 300 - i * 100;
+		pNeoDevice[i].DeviceType = NEODEVICE_VCAN3;
+		pNeoDevice[i].Handle = i;
+	}
+	*pNumDevices = count;
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoOpenNeoDevice(NeoDevice * pNeoDevice, void * hObject, unsigned char * bNetworkIDs, int bConfigRead, int bSyncToPC)
+{
+	(void)bNetworkIDs;
+	(void)bConfigRead;
+	(void)bSyncToPC;
+	if (pNeoDevice->Handle < 0 || pNeoDevice->Handle >= kMaxDevices)
+		return 0;
+	int32_t * handle = &serialNumbers[pNeoDevice->Handle];
+	*handle = pNeoDevice->SerialNumber;
+	*static_cast<void **>(hObject) = handle;
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoClosePort(void * hObject, int * pNumberOfErrors)
+{
+	(void)hObject;
+	*pNumberOfErrors = 0;
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoTxMessages(void * hObject, icsSpyMessage * pMsg, int lNetworkID, int lNumMessages)
+{
+	(void)pMsg;
+	(void)lNetworkID;
+	(void)lNumMessages;
+	return (hObject != nullptr) ? 1 : 0;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoWaitForRxMessagesWithTimeOut(void * hObject, unsigned int iTimeOut)
+{
+	(void)hObject;
+	(void)iTimeOut;
+	std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoGetMessages(void * hObject, icsSpyMessage * pMsg, int * pNumberOfMessages, int * pNumberOfErrors)
+{
+	int32_t serialNumber = *static_cast<int32_t *>(hObject);
+	int burst = EnvInt("CTRE_FAKE_ICSNEO_BURST", kDefaultBurst, 0, 20000);
+	bool twoChannels = EnvSet("CTRE_FAKE_ICSNEO_TWO_CHANNELS");
+	int64_t nowUs = HostNowUs();
+
+	for (int i = 0; i < burst; ++i) {
+		icsSpyMessage & msg = pMsg[i];
+		memset(&msg, 0, sizeof(msg));
+		msg.NetworkID = static_cast<unsigned char>((twoChannels && (i & 1)) ? NETID_HSCAN2 : NETID_HSCAN);
+		msg.ArbIDOrHeader = static_cast<long>(nextArbID++);
+		msg.NumberBytesData = 8;
+
+		/* the oldest frame of the burst was made first */
+		int64_t madeUs = nowUs - kReadLatencyUs - (burst - i);
+		uint32_t madeUs32 = static_cast<uint32_t>(madeUs);
+		memcpy(msg.Data, &madeUs32, sizeof(madeUs32));
+		msg.Data[4] = static_cast<unsigned char>(serialNumber / 100);
+		/* long is 32 bits on Windows, keep the full hardware time across both fields */
+		uint64_t hardwareUs = static_cast<uint64_t>(static_cast<double>(madeUs) * 1.0001) + 5000000000ULL;
+		msg.TimeHardware = static_cast<unsigned long>(hardwareUs & 0xFFFFFFFF);
+		msg.TimeHardware2 = static_cast<unsigned long>(hardwareUs >> 32);
+		msg.TimeSystem = static_cast<unsigned long>(madeUs32);
+	}
+	*pNumberOfMessages = burst;
+	*pNumberOfErrors = 0;
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoGetLastAPIError(void * hObject, unsigned long * pErrorNumber)
+{
+	(void)hObject;
+	*pErrorNumber = 0;
+	return 1;
+}
+
+FAKE_ICSNEO_EXPORT int __stdcall icsneoGetTimeStampForMsg(void * hObject, icsSpyMessage * pMsg, double * pTimeStamp)
+{
+	(void)hObject;
+	if (EnvSet("CTRE_FAKE_ICSNEO_NO_HW_TIME"))
+		return 0;
+	uint64_t hardwareUs = (static_cast<uint64_t>(pMsg->TimeHardware2) << 32) | static_cast<uint32_t>(pMsg->TimeHardware);
+	*pTimeStamp = static_cast<double>(hardwareUs) / 1e6;
+	return 1;
+}
@@ -0,0 +1,139 @@
+/**
+ * The ICS platform's receive: a call never waits for the tool, frames come out in the order the tool read
+ * them, and every frame a stalled reader loses to the full receive ring is counted by ICSGetRxOverflowCount.
+ * Needs CTRE_ICSNEO_LIBRARY_PATH set to the fake icsneo library, see FakeIcsNeo.cpp.
+ */
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformICS.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream> // std::cout
+#include <thread>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const char * const kLibraryEnv = "CTRE_ICSNEO_LIBRARY_PATH";
+	/* frames the fake makes each millisecond */
+	const char * const kBurst = "200";
+	/* larger than the platform's 4096 frame receive ring, so a reader that drains in one call keeps up */
+	const uint32_t kCapacity = 8192;
+	const std::chrono::milliseconds kKeepUpFor(300);
+	/* 10000 frames, far more than the receive ring holds */
+	const std::chrono::milliseconds kStallFor(50);
+	const int kStalls = 3;
+	const std::chrono::milliseconds kCatchUpFor(20);
+	/* the fake takes a millisecond per burst, a receive that waited for one would be well past this */
+	const double kMaxEmptyCallUs = 200;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	void SetEnv(const char * name, const char * value)
+	{
+#if defined(_WIN32)
+		(void)_putenv_s(name, value);
+#else
+		(void)setenv(name, value, 1);
+#endif
+	}
+
+	/* the fake's arbIDs count up from 0, so a gap is frames lost in the platform */
+	struct Stream {
+		uint32_t nextArbID = 0;
+		uint64_t received = 0;
+		uint64_t missing = 0;
+		bool inOrder = true;
+		uint32_t emptyCalls = 0;
+		double emptyUs = 0;
+		int32_t error = 0;
+	};
+
+	uint32_t Receive(Stream & stream)
+	{
+		static canframe_t frames[kCapacity];
+		uint32_t filled = 0;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		int32_t err = CANbus_ReceiveFrame(frames, kCapacity, &filled);
+		double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		if (err != 0)
+			stream.error = err;
+		if (filled == 0) {
+			++stream.emptyCalls;
+			stream.emptyUs += us;
+		}
+		for (uint32_t i = 0; i < filled; ++i) {
+			if (frames[i].arbID < stream.nextArbID)
+				stream.inOrder = false;
+			else
+				stream.missing += frames[i].arbID - stream.nextArbID;
+			stream.nextArbID = frames[i].arbID + 1;
+		}
+		stream.received += filled;
+		return filled;
+	}
+
+	void KeepUp(Stream & stream, std::chrono::milliseconds duration)
+	{
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + duration;
+		while (std::chrono::steady_clock::now() < end) {
+			(void)Receive(stream);
+			std::this_thread::yield();
+		}
+	}
+}
+
+int main()
+{
+	if (std::getenv(kLibraryEnv) == nullptr) {
+		std::cout << "FAIL: set " << kLibraryEnv << " to the CTRE_PhoenixPlatform_ics_fakeIcsNeo library" << std::endl;
+		return 1;
+	}
+	/* before the first call opens the tool, the fake's I/O thread reads it from then on */
+	SetEnv("CTRE_FAKE_ICSNEO_BURST", kBurst);
+
+	/* a reader that keeps up, most calls find nothing and must come straight back */
+	Stream stream;
+	KeepUp(stream, kKeepUpFor);
+	Check(stream.error == 0, "CANbus_ReceiveFrame failed");
+	Check(stream.received > 0, "no frames received from the fake tool");
+	Check(stream.emptyCalls > 0, "never caught up with the fake tool");
+	if (stream.emptyCalls > 0)
+		Check(stream.emptyUs / stream.emptyCalls < kMaxEmptyCallUs, "an empty receive waited for frames");
+
+	uint32_t before = 0;
+	Check(ICSGetRxOverflowCount(0, &before) == 0, "ICSGetRxOverflowCount failed");
+	Check(ICSGetRxOverflowCount(0, nullptr) != 0, "ICSGetRxOverflowCount took a null count");
+
+	/* a reader that stalls, the ring fills and drops the newest frames until it is drained */
+	for (int i = 0; i < kStalls; ++i) {
+		std::this_thread::sleep_for(kStallFor);
+		(void)Receive(stream);
+	}
+	/* keep up again, so frames dropped in the last stall show as a gap before the next one received */
+	KeepUp(stream, kCatchUpFor);
+
+	uint32_t after = 0;
+	Check(ICSGetRxOverflowCount(0, &after) == 0, "ICSGetRxOverflowCount failed");
+	Check(after > before, "frames lost to a stalled reader were not counted");
+	Check(stream.missing == after, "ICSGetRxOverflowCount did not match the frames missing from the stream");
+	Check(stream.inOrder, "frames received out of order");
+	Check(stream.error == 0, "CANbus_ReceiveFrame failed");
+
+	DisposePlatform();
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * CoalescingQueue keeps one frame per arbID in its place in line, never overwrites a frame it has lent,
+ * and finds every queued arbID again after removals shift its index entries back.
+ * RxClassQueue hands out the frames queued before a class changed mode first, by pop and by lease.
+ */
+#include "ctre/phoenix/platform/CoalescingQueue.h"
+#include "ctre/phoenix/platform/RxClass.h"
+
+#include <iostream> // std::cout
+#include <vector>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const uint32_t kCapacity = 8;
+	/* CoalescingQueue<kCapacity> indexes twice its capacity */
+	const uint32_t kIndexMask = kCapacity * 2 - 1;
+
+	typedef CoalescingQueue<kCapacity> Queue;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	/* same hash as CoalescingQueue::Home, so the test can line arbIDs up into one probe run */
+	uint32_t Home(uint32_t arbID)
+	{
+		uint32_t h = arbID * 0x9E3779B1u;
+		return (h ^ (h >> 16)) & kIndexMask;
+	}
+
+	/* the next arbID after start whose index entry starts at home */
+	uint32_t WithHome(uint32_t home, uint32_t start)
+	{
+		uint32_t arbID = start + 1;
+		while (Home(arbID) != home)
+			++arbID;
+		return arbID;
+	}
+
+	/* data[0] tells versions of one arbID apart */
+	canframe_ex_t Frame(uint32_t arbID, uint8_t version)
+	{
+		canframe_ex_t frame = {};
+		frame.arbID = arbID;
+		frame.dlc = 8;
+		frame.data[0] = version;
+		return frame;
+	}
+
+	template <typename Q>
+	void Push(Q & queue, uint32_t arbID, uint8_t version)
+	{
+		canframe_ex_t frame = Frame(arbID, version);
+		(void)queue.PushBulk(&frame, 1);
+	}
+
+	/* arbID and version of every frame, in order */
+	template <typename Q>
+	std::vector<uint32_t> PopAll(Q & queue)
+	{
+		std::vector<uint32_t> popped;
+		canframe_ex_t frames[4 * kCapacity];
+		uint32_t count = queue.PopBulk(frames, 4 * kCapacity);
+		for (uint32_t i = 0; i < count; ++i)
+			popped.push_back((frames[i].arbID << 8) | frames[i].data[0]);
+		return popped;
+	}
+
+	uint32_t Tag(uint32_t arbID, uint8_t version)
+	{
+		return (arbID << 8) | version;
+	}
+
+	/*
+	 * removing the head of a probe run shifts the entries behind it back, but only those whose home
+	 * is at or before the hole; either mistake leaves an arbID that is queued but can't be found,
+	 * and its next frame queues a second copy instead of merging
+	 */
+	void CheckErase(uint32_t home)
+	{
+		Queue queue;
+		uint32_t a = WithHome(home, 0);
+		uint32_t b = WithHome(home, a);
+		uint32_t c = WithHome((home + 1) & kIndexMask, 0);
+		uint32_t d = WithHome(home, b);
+
+		/* run of a, c in its own home right behind a, then b and d probing past both from a's home */
+		Push(queue, a, 1);
+		Push(queue, c, 1);
+		Push(queue, b, 1);
+		Push(queue, d, 1);
+
+		/* pop a: c must stay put, b and d must move back, and each survivor must still merge */
+		canframe_ex_t frame;
+		Check(queue.PopBulk(&frame, 1) == 1 && frame.arbID == a, "first frame was not the oldest");
+		Push(queue, b, 2);
+		Push(queue, c, 2);
+		Push(queue, d, 2);
+		Check(PopAll(queue) == std::vector<uint32_t>({ Tag(c, 2), Tag(b, 2), Tag(d, 2) }), "an arbID was lost from the index after an erase");
+		Check(queue.Empty(), "queue not empty after popping everything");
+	}
+
+	void CheckLent()
+	{
+		Queue queue;
+		Push(queue, 0x100, 1);
+		Push(queue, 0x200, 1);
+
+		/* lend 0x100, a newer 0x100 must queue behind rather than overwrite the lent one */
+		RingSpans<canframe_ex_t> spans;
+		Check(queue.Lease(spans, 1) == 1 && spans.first[0].arbID == 0x100, "lease did not lend the oldest frame");
+		Push(queue, 0x100, 2);
+		Check(spans.first[0].data[0] == 1, "a lent frame was overwritten");
+		/* and even newer ones merge into that second copy */
+		Push(queue, 0x100, 3);
+		Push(queue, 0x200, 2);
+		queue.Release(1);
+		Check(PopAll(queue) == std::vector<uint32_t>({ Tag(0x200, 2), Tag(0x100, 3) }), "frames after a lend did not merge behind it");
+
+		/* popping takes lent frames first, the rest of the lease stays protected */
+		Push(queue, 0x100, 1);
+		Push(queue, 0x200, 1);
+		Check(queue.Lease(spans, 2) == 2, "lease did not lend both frames");
+		canframe_ex_t frame;
+		Check(queue.PopBulk(&frame, 1) == 1 && frame.arbID == 0x100, "pop did not take the first lent frame");
+		Push(queue, 0x200, 2);
+		Check(spans.first[1].data[0] == 1, "a frame still lent after a pop was overwritten");
+		queue.Release(1);
+		Check(PopAll(queue) == std::vector<uint32_t>({ Tag(0x200, 2) }), "newer frame did not queue behind the lent one");
+
+		/* a full queue drops new arbIDs but still merges queued ones */
+		for (uint32_t i = 0; i < kCapacity; ++i)
+			Push(queue, 0x300 + i, 1);
+		Push(queue, 0x400, 1);
+		Push(queue, 0x300, 2);
+		Check(queue.Dropped() == 1, "full queue did not count the dropped frame");
+		std::vector<uint32_t> kept = PopAll(queue);
+		Check(kept.size() == kCapacity && kept.front() == Tag(0x300, 2), "full queue did not merge a queued arbID");
+	}
+
+	/* frames queued in the mode a class just left are older, so they come out first either way */
+	void CheckModeSwitch()
+	{
+		RxClassQueue<kCapacity> queue;
+
+		/* FIFO then latest-wins */
+		Push(queue, 0x100, 1);
+		Push(queue, 0x100, 2);
+		Check(queue.SetCoalescing(0, true), "SetCoalescing failed");
+		Push(queue, 0x100, 3);
+		Push(queue, 0x100, 4);
+		Check(PopAll(queue) == std::vector<uint32_t>({ Tag(0x100, 1), Tag(0x100, 2), Tag(0x100, 4) }), "FIFO frames did not come out before the coalesced one");
+
+		/* and back */
+		Push(queue, 0x100, 5);
+		Check(queue.SetCoalescing(0, false), "SetCoalescing back to FIFO failed");
+		Push(queue, 0x100, 6);
+		Check(PopAll(queue) == std::vector<uint32_t>({ Tag(0x100, 5), Tag(0x100, 6) }), "coalesced frame did not come out before the FIFO one");
+
+		/* leasing follows the same order */
+		RingSpans<canframe_ex_t> spans;
+		Push(queue, 0x100, 7);
+		Check(queue.SetCoalescing(0, true), "SetCoalescing failed");
+		Push(queue, 0x100, 8);
+		Check(queue.Lease(spans, 4) == 1 && spans.first[0].data[0] == 7, "lease did not lend the FIFO frame first");
+		queue.Release(1);
+		Check(queue.Lease(spans, 4) == 1 && spans.first[0].data[0] == 8, "lease did not move on to the coalesced frame");
+		queue.Release(1);
+
+		Push(queue, 0x100, 9);
+		Check(queue.SetCoalescing(0, false), "SetCoalescing back to FIFO failed");
+		Push(queue, 0x100, 10);
+		Check(queue.Lease(spans, 4) == 1 && spans.first[0].data[0] == 9, "lease did not lend the coalesced frame first");
+		queue.Release(1);
+		Check(queue.Lease(spans, 4) == 1 && spans.first[0].data[0] == 10, "lease did not move on to the FIFO frame");
+		queue.Release(1);
+		Check(queue.Empty(), "queue not empty after releasing everything");
+
+		Check(queue.SetCoalescing(kRxClassCount, true) == false, "SetCoalescing took a class out of range");
+	}
+}
+
+int main()
+{
+	CheckErase(3);
+	/* a run that wraps past the end of the index */
+	CheckErase(kIndexMask);
+	CheckLent();
+	CheckModeSwitch();
+
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
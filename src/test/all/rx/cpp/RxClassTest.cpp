@@ -0,0 +1,191 @@
+/**
+ * RxClassQueue sorts frames by the first rule they match, drains class 0 first, never lends across
+ * classes, and a full class drops only its own frames.
+ * SetClasses can swap the rules while the I/O thread classifies, the old table is only freed once
+ * no push is still using it; build with a sanitizer to catch one that is freed early.
+ */
+#include "ctre/phoenix/platform/RxClass.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream> // std::cout
+#include <thread>
+#include <vector>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const uint32_t kCapacity = 8;
+	const uint32_t kExact = 0x1FFFFFFF;
+	const uint32_t kSlowRules = 4096;
+	const std::chrono::milliseconds kSwapFor(500);
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	canframe_ex_t Frame(uint32_t arbID)
+	{
+		canframe_ex_t frame = {};
+		frame.arbID = arbID;
+		frame.dlc = 8;
+		return frame;
+	}
+
+	std::vector<uint32_t> PopAll(RxClassQueue<kCapacity> & queue)
+	{
+		std::vector<uint32_t> arbIDs;
+		canframe_ex_t frames[4 * kCapacity];
+		uint32_t count = queue.PopBulk(frames, 4 * kCapacity);
+		for (uint32_t i = 0; i < count; ++i)
+			arbIDs.push_back(frames[i].arbID);
+		return arbIDs;
+	}
+
+	std::vector<uint32_t> PopClass(RxClassQueue<kCapacity> & queue, uint32_t rxClass)
+	{
+		std::vector<uint32_t> arbIDs;
+		canframe_ex_t frames[kCapacity];
+		uint32_t count = queue.PopBulk(rxClass, frames, kCapacity);
+		for (uint32_t i = 0; i < count; ++i)
+			arbIDs.push_back(frames[i].arbID);
+		return arbIDs;
+	}
+
+	void CheckClassify()
+	{
+		RxClassQueue<kCapacity> queue;
+
+		/* no rules, everything is class 0 in arrival order */
+		(void)queue.Push(Frame(0x300));
+		(void)queue.Push(Frame(0x100));
+		Check(PopClass(queue, 0) == std::vector<uint32_t>({ 0x300, 0x100 }), "without rules frames were not all class 0");
+
+		/* out of range classes are refused and leave the rules alone */
+		canframe_class_rule_t bad = { 0x100, 0x1FF, kExact, kRxClassCount };
+		Check(queue.SetClasses(&bad, 1, 0) == false, "SetClasses took a rule class out of range");
+		Check(queue.SetClasses(nullptr, 0, kRxClassCount) == false, "SetClasses took a default class out of range");
+
+		/* a range, a mask match, and an overlapping rule that loses because it comes later */
+		canframe_class_rule_t rules[] = {
+			{ 0x100, 0x1FF, kExact, 1 },
+			{ 0x040, 0x040, 0x0F0, 0 },
+			{ 0x000, 0x1FF, kExact, 2 },
+		};
+		Check(queue.SetClasses(rules, 3, 3), "SetClasses failed");
+		const uint32_t arrivals[] = { 0x500, 0x180, 0x041, 0x020, 0x14F, 0x04E };
+		for (uint32_t arbID : arrivals)
+			(void)queue.Push(Frame(arbID));
+
+		/* class 0 first, each class in arrival order; 0x14F matches the range rule before the mask rule */
+		Check(PopAll(queue) == std::vector<uint32_t>({ 0x041, 0x04E, 0x180, 0x14F, 0x020, 0x500 }), "frames not drained by class");
+
+		/* changing the rules leaves queued frames in their class */
+		(void)queue.Push(Frame(0x180));
+		Check(queue.SetClasses(nullptr, 0, 0), "SetClasses back to no rules failed");
+		(void)queue.Push(Frame(0x181));
+		Check(PopClass(queue, 1) == std::vector<uint32_t>({ 0x180 }), "a queued frame moved class when the rules changed");
+		Check(PopClass(queue, 0) == std::vector<uint32_t>({ 0x181 }), "a frame after the rules changed was not class 0");
+		Check(queue.Empty(), "queue not empty after draining every class");
+	}
+
+	void CheckLeaseAndDrops()
+	{
+		RxClassQueue<kCapacity> queue;
+		canframe_class_rule_t rules[] = {
+			{ 0x100, 0x1FF, kExact, 1 },
+			{ 0x300, 0x3FF, kExact, 3 },
+		};
+		Check(queue.SetClasses(rules, 2, 0), "SetClasses failed");
+
+		/* a lease is one class at a time, the most urgent one with frames */
+		(void)queue.Push(Frame(0x300));
+		(void)queue.Push(Frame(0x100));
+		(void)queue.Push(Frame(0x101));
+		RingSpans<canframe_ex_t> spans;
+		Check(queue.Lease(spans, 16) == 2 && spans.first[0].arbID == 0x100 && spans.first[1].arbID == 0x101, "lease did not lend class 1 alone");
+		queue.Release(2);
+		Check(queue.Lease(spans, 16) == 1 && spans.first[0].arbID == 0x300, "lease after release did not move on to class 3");
+		queue.Release(1);
+		Check(queue.Lease(spans, 16) == 0, "empty queue lent frames");
+
+		/* a full class drops its own newest frames, other classes still take theirs */
+		for (uint32_t i = 0; i < kCapacity + 2; ++i)
+			(void)queue.Push(Frame(0x100 + i));
+		Check(queue.Push(Frame(0x300)), "a full class stopped another class queueing");
+		Check(queue.Dropped() == 2, "drops in a full class not counted");
+		std::vector<uint32_t> kept = PopClass(queue, 1);
+		Check(kept.size() == kCapacity && kept.back() == 0x100 + kCapacity - 1, "full class did not keep its oldest frames");
+	}
+
+	/*
+	 * the I/O thread keeps classifying while the rules are swapped under it. Thousands of rules that never
+	 * match make each push slow, so the I/O thread is often descheduled partway through a table
+	 */
+	void CheckSwapWhilePushing()
+	{
+		static RxClassQueue<kCapacity * 64> queue;
+		std::vector<canframe_class_rule_t> tables[2];
+		for (uint32_t t = 0; t < 2; ++t) {
+			for (uint32_t i = 0; i < kSlowRules; ++i) {
+				canframe_class_rule_t never = { 0x10000 + i, 0x10000 + i, kExact, 2 };
+				tables[t].push_back(never);
+			}
+			/* both tables put 0x100 in class 1, so a frame anywhere else was classified with a freed table */
+			canframe_class_rule_t wanted = { 0x100, 0x100 + t, kExact, 1 };
+			tables[t].push_back(wanted);
+		}
+
+		Check(queue.SetClasses(tables[0].data(), static_cast<uint32_t>(tables[0].size()), 3), "SetClasses failed");
+		std::atomic<bool> run{ true };
+		std::thread io([&run] {
+			canframe_ex_t frames[64];
+			for (uint32_t i = 0; i < 64; ++i)
+				frames[i] = Frame(0x100);
+			/* like a real I/O thread, which waits for the next batch of frames between pushes */
+			while (run.load()) {
+				(void)queue.PushBulk(frames, 64);
+				std::this_thread::yield();
+			}
+		});
+
+		canframe_ex_t frames[256];
+		uint64_t misplaced = 0;
+		uint64_t received = 0;
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + kSwapFor;
+		for (uint32_t i = 0; std::chrono::steady_clock::now() < end; ++i) {
+			const std::vector<canframe_class_rule_t> & table = tables[i & 1];
+			(void)queue.SetClasses(table.data(), static_cast<uint32_t>(table.size()), 3);
+			for (uint32_t c = 0; c < kRxClassCount; ++c) {
+				uint32_t count = queue.PopBulk(c, frames, 256);
+				received += count;
+				if (c != 1)
+					misplaced += count;
+			}
+			std::this_thread::yield();
+		}
+		run.store(false);
+		io.join();
+		Check(received > 0, "I/O thread never pushed");
+		Check(misplaced == 0, "frames classified while the rules were swapped landed in the wrong class");
+	}
+}
+
+int main()
+{
+	CheckClassify();
+	CheckLeaseAndDrops();
+	CheckSwapWhilePushing();
+
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
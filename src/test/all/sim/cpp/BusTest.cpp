@@ -0,0 +1,125 @@
+/**
+ * The sim bus model: frames take their worst-case bit time to go through, the lowest ID waiting when
+ * the bus goes idle wins arbitration, equal IDs stay in order, and full transmit queues are counted.
+ */
+#include "SimBus.h"
+#include "ctre/phoenix/ErrorCode.h"
+
+#include <iostream> // std::cout
+#include <vector>
+
+using namespace ctre::phoenix;
+using namespace ctre::phoenix::platform;
+
+namespace {
+	/* an 8-byte extended frame is 160 bits worst case, 160 us at 1 Mbps */
+	const uint64_t kFrameNs = 160000;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	struct Collector {
+		std::vector<SimBusFrame> frames;
+		SimBus::DeliverHandler Handler()
+		{
+			return [this](const SimBusFrame & frame) { frames.push_back(frame); };
+		}
+	};
+
+	void DeliveryDelay()
+	{
+		SimBus bus;
+		bus.SetBitrate(1000000);
+		Check(SimBus::FrameBits(8) == 160, "8-byte frame is not 160 bits");
+
+		uint8_t data[8] = {};
+		Check(bus.TransmitFromRobot(0x100, data, 8, 0) == 0, "robot frame refused");
+
+		Collector delivered;
+		bus.Advance(kFrameNs - 1, delivered.Handler());
+		Check(delivered.frames.empty(), "frame delivered before its last bit was out");
+		bus.Advance(kFrameNs, delivered.Handler());
+		Check(delivered.frames.size() == 1 && delivered.frames[0].deliveredNs == kFrameNs, "frame not delivered after one frame time");
+
+		/* an ideal bus delivers as soon as it is run */
+		SimBus ideal;
+		ideal.SetBitrate(0);
+		Check(ideal.TransmitFromRobot(0x100, data, 8, 5000) == 0, "robot frame refused");
+		Collector instant;
+		ideal.Advance(5000, instant.Handler());
+		Check(instant.frames.size() == 1 && instant.frames[0].deliveredNs == 5000, "ideal bus did not deliver instantly");
+	}
+
+	void Arbitration()
+	{
+		SimBus bus;
+		bus.SetBitrate(1000000);
+		uint8_t data[8] = {};
+
+		/* 0x500 takes the idle bus, everything else queues behind it and arbitrates when it is done */
+		(void)bus.TransmitFromRobot(0x500, data, 8, 0);
+		(void)bus.TransmitFromDevice(1, 0x300, data, 8, 10000);
+		(void)bus.TransmitFromDevice(2, 0x100, data, 8, 20000);
+		data[0] = 1;
+		(void)bus.TransmitFromRobot(0x200, data, 8, 30000);
+		data[0] = 2;
+		(void)bus.TransmitFromDevice(1, 0x200, data, 8, 40000);
+
+		Collector delivered;
+		bus.Advance(10 * kFrameNs, delivered.Handler());
+
+		const uint32_t order[] = { 0x500, 0x100, 0x200, 0x200, 0x300 };
+		Check(delivered.frames.size() == 5, "not every frame was delivered");
+		for (size_t i = 0; i < delivered.frames.size() && i < 5; ++i) {
+			Check(delivered.frames[i].arbID == order[i], "frames did not leave in arbitration order");
+			Check(delivered.frames[i].deliveredNs == (i + 1) * kFrameNs, "frames were not back to back");
+		}
+		if (delivered.frames.size() == 5) {
+			Check(delivered.frames[2].data[0] == 1 && delivered.frames[2].fromRobot, "equal IDs did not stay in order");
+			Check(delivered.frames[3].data[0] == 2 && delivered.frames[3].fromRobot == false, "equal IDs did not stay in order");
+		}
+	}
+
+	void FullQueues()
+	{
+		SimBus bus;
+		bus.SetBitrate(1000000);
+		uint8_t data[8] = {};
+
+		uint32_t refused = 0;
+		for (size_t i = 0; i < SimBus::kDeviceTxQueueCapacity + 5; ++i) {
+			if (bus.TransmitFromDevice(1, 0x200, data, 8, 0) == ErrorCode::BufferFull) { ++refused; }
+		}
+		Check(refused == 5, "device queue did not hold exactly its capacity");
+		Check(bus.TransmitFromDevice(2, 0x200, data, 8, 0) == 0, "one device's full queue refused another device");
+
+		for (size_t i = 0; i < SimBus::kTxQueueCapacity; ++i)
+			(void)bus.TransmitFromRobot(0x100, data, 8, 0);
+		Check(bus.TransmitFromRobot(0x100, data, 8, 0) == ErrorCode::BufferFull, "robot queue took more than its capacity");
+
+		uint32_t txFull = 0;
+		uint32_t deviceDrops = 0;
+		bus.GetStatus(nullptr, &txFull, &deviceDrops);
+		Check(txFull == 1, "robot queue full not counted");
+		Check(deviceDrops == 5, "device queue drops not counted");
+	}
+}
+
+int main()
+{
+	DeliveryDelay();
+	Arbitration();
+	FullQueues();
+
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * In virtual time the clock only advances once every attached thread is asleep, so threads sleeping
+ * different steps over the same span finish together, and a running thread holds the clock.
+ * Devices are only polled as the clock advances, never by the wall-clock pump.
+ * Needs CTRE_TALON_LIBRARY_PATH set to the test adapter library, see TestAdapter.cpp.
+ */
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "TestAdapter.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream> // std::cout
+#include <thread>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	/* both threads are in the lockstep before either sleeps */
+	void AttachAndWait(std::atomic<int> & attached, int threads)
+	{
+		SimClockAttach();
+		++attached;
+		while (attached < threads) { std::this_thread::yield(); }
+	}
+
+	/* 1000 steps of 1 ms and 500 steps of 2 ms both end 1 s later, each wake at exactly its step */
+	void TwoThreadsFinishTogether()
+	{
+		const uint64_t start = SimGetTimeUs();
+		std::atomic<int> attached{ 0 };
+
+		auto run = [&](int steps, int stepUs, uint64_t & end, bool & onTime) {
+			AttachAndWait(attached, 2);
+			for (int i = 1; i <= steps; ++i) {
+				SleepUs(stepUs);
+				/* we are running, the clock can't have moved past our wake time */
+				if (SimGetTimeUs() != start + static_cast<uint64_t>(i) * static_cast<uint64_t>(stepUs))
+					onTime = false;
+			}
+			end = SimGetTimeUs();
+			SimClockDetach();
+		};
+
+		uint64_t endA = 0;
+		uint64_t endB = 0;
+		bool onTimeA = true;
+		bool onTimeB = true;
+		std::thread a([&] { run(1000, 1000, endA, onTimeA); });
+		std::thread b([&] { run(500, 2000, endB, onTimeB); });
+		a.join();
+		b.join();
+
+		Check(onTimeA && onTimeB, "a thread woke later than its wake time");
+		Check(endA == start + 1000000, "1 ms steps did not end after 1 s of sim time");
+		Check(endB == start + 1000000, "2 ms steps did not end after 1 s of sim time");
+	}
+
+	/* a thread that is attached but busy keeps the clock where it is */
+	void RunningThreadHoldsClock()
+	{
+		const uint64_t start = SimGetTimeUs();
+		std::atomic<int> attached{ 0 };
+		std::atomic<bool> sleeperWoke{ false };
+		uint64_t seenWhileBusy = 0;
+		uint64_t sleeperWokeAt = 0;
+
+		std::thread busy([&] {
+			AttachAndWait(attached, 2);
+			auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(20);
+			while (std::chrono::steady_clock::now() < until && sleeperWoke == false) { std::this_thread::yield(); }
+			seenWhileBusy = SimGetTimeUs();
+			SleepUs(5000);
+			SimClockDetach();
+		});
+		std::thread sleeper([&] {
+			AttachAndWait(attached, 2);
+			SleepUs(1000);
+			sleeperWokeAt = SimGetTimeUs();
+			sleeperWoke = true;
+			SimClockDetach();
+		});
+		busy.join();
+		sleeper.join();
+
+		Check(seenWhileBusy == start, "clock advanced while an attached thread was running");
+		Check(sleeperWokeAt == start + 1000, "sleeper did not wake at its wake time");
+	}
+
+	void CountFrame(const canframe_ex_t * /*frame*/, void * context)
+	{
+		++*static_cast<std::atomic<uint32_t> *>(context);
+	}
+
+	uint64_t ReceiveCalls()
+	{
+		SimDeviceStats stats = {};
+		uint32_t filled = 0;
+		(void)SimGetDeviceStats(&stats, 1, &filled);
+		return filled == 1 ? stats.receive.calls : 0;
+	}
+
+	/* a subscriber starts the pump thread, in virtual time it must leave the devices alone */
+	void PumpWaitsForTheClock()
+	{
+		Check(SimCreate(TalonSRXType, 1) == 0, "could not create the test device");
+		std::atomic<uint32_t> frames{ 0 };
+		uint32_t handle = 0;
+		Check(CANbus_Subscribe(sim_test::kStatusBase | 1, 0x1FFFFFFF, CountFrame, &frames, &handle) == 0, "could not subscribe");
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		Check(ReceiveCalls() == 0, "devices were polled while virtual time stood still");
+		Check(frames == 0, "frames arrived while virtual time stood still");
+
+		/* status frames come every 10 ms of sim time, each advance pumps the bus */
+		for (int i = 0; i < 50; ++i)
+			SleepUs(1000);
+		Check(ReceiveCalls() > 0, "devices were not polled as the clock advanced");
+		Check(frames >= 4, "status frames did not arrive as the clock advanced");
+
+		(void)CANbus_Unsubscribe(handle);
+		SimDestroyAll();
+	}
+}
+
+int main()
+{
+	if (std::getenv(sim_test::kAdapterEnv) == nullptr) {
+		std::cout << "FAIL: set " << sim_test::kAdapterEnv << " to the CTRE_PhoenixPlatform_sim_testAdapter library" << std::endl;
+		return 1;
+	}
+
+	SimSetVirtualTime(true);
+	TwoThreadsFinishTogether();
+	RunningThreadHoldsClock();
+	PumpWaitsForTheClock();
+
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
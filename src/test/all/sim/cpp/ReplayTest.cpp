@@ -0,0 +1,106 @@
+/**
+ * A log recorded from one world, replayed into a fresh world with no devices, hands the robot the same
+ * frames at the same offsets from the start as the devices did while recording.
+ * Needs CTRE_TALON_LIBRARY_PATH set to the test adapter library, see TestAdapter.cpp.
+ */
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "TestAdapter.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream> // std::cout
+#include <vector>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const char * const kLogPath = "ReplayTest.simlog";
+	const uint32_t kControl = 0x02040C01;
+	const int kRunMs = 50;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	/* what the robot receives over kRunMs of sim time, stamped relative to startUs, sending now and then */
+	std::vector<canframe_ex_t> Run(uint64_t startUs)
+	{
+		std::vector<canframe_ex_t> received;
+		for (int i = 0; i < kRunMs; ++i) {
+			if (i % 10 == 3) {
+				uint8_t data[8] = { static_cast<uint8_t>(i) };
+				(void)CANbus_SendFrame(kControl, data, 8);
+			}
+			SleepUs(1000);
+
+			canframe_ex_t frames[32];
+			uint32_t filled = 0;
+			while (CANbus_ReceiveFrameEx(frames, 32, &filled) == 0 && filled > 0) {
+				for (uint32_t k = 0; k < filled; ++k) {
+					frames[k].timeStampNs -= startUs * 1000;
+					received.push_back(frames[k]);
+				}
+			}
+		}
+		return received;
+	}
+}
+
+int main()
+{
+	if (std::getenv(sim_test::kAdapterEnv) == nullptr) {
+		std::cout << "FAIL: set " << sim_test::kAdapterEnv << " to the CTRE_PhoenixPlatform_sim_testAdapter library" << std::endl;
+		return 1;
+	}
+
+	/* record a device's status frames and its echoes of what we send */
+	SimSetVirtualTime(true);
+	Check(SimCreate(TalonSRXType, 1) == 0, "could not create the test device");
+	Check(SimStartRecording(kLogPath) == 0, "could not start recording");
+	std::vector<canframe_ex_t> recorded = Run(SimGetTimeUs());
+	(void)SimStopRecording();
+	SimDestroyAll();
+
+	bool sawEcho = false;
+	for (const canframe_ex_t & frame : recorded) {
+		if ((frame.arbID & ~0x3Fu) == sim_test::kEchoBase) { sawEcho = true; }
+	}
+	Check(recorded.size() >= 5 && sawEcho, "too few frames recorded to compare");
+
+	/* replay it into a world that has never seen a device */
+	SimWorld * world = SimWorldCreate();
+	Check(SimWorldSetCurrent(world) == 0, "could not bind the replay world");
+	SimSetVirtualTime(true);
+	Check(SimStartReplay(kLogPath) == 0, "could not start the replay");
+	Check(SimCreate(TalonSRXType, 1) == 0, "creating a device while replaying failed");
+	std::vector<canframe_ex_t> replayed = Run(SimGetTimeUs());
+	(void)SimStopReplay();
+
+	Check(replayed.size() == recorded.size(), "replay handed the robot a different number of frames");
+	for (size_t i = 0; i < recorded.size() && i < replayed.size(); ++i) {
+		const canframe_ex_t & a = recorded[i];
+		const canframe_ex_t & b = replayed[i];
+		if (a.arbID != b.arbID || a.dlc != b.dlc || a.timeStampNs != b.timeStampNs || std::memcmp(a.data, b.data, 8) != 0) {
+			Check(false, "replay handed the robot different frames");
+			break;
+		}
+	}
+
+	(void)SimWorldSetCurrent(nullptr);
+	(void)SimWorldDestroy(world);
+	(void)std::remove(kLogPath);
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * Robot frames go to the one device that owns their address once the sim has seen that device send,
+ * and to every device when they are broadcast or addressed to a device it does not know.
+ * Needs CTRE_TALON_LIBRARY_PATH set to the test adapter library, see TestAdapter.cpp.
+ */
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "TestAdapter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream> // std::cout
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	/* TalonSRX, CTRE, an API the adapter doesn't care about */
+	const uint32_t kControlBase = 0x02040C00;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	/* run the clock long enough for the frame to reach the devices and their echoes to come back */
+	uint32_t DevicesThatGot(uint32_t arbID)
+	{
+		uint8_t data[8] = {};
+		(void)CANbus_SendFrame(arbID, data, 8);
+
+		uint32_t devices = 0;
+		for (int i = 0; i < 5; ++i) {
+			SleepUs(1000);
+
+			canframe_ex_t frames[32];
+			uint32_t filled = 0;
+			while (CANbus_ReceiveFrameEx(frames, 32, &filled) == 0 && filled > 0) {
+				for (uint32_t k = 0; k < filled; ++k) {
+					uint32_t echoed;
+					std::memcpy(&echoed, frames[k].data, sizeof(echoed));
+					if ((frames[k].arbID & ~0x3Fu) == sim_test::kEchoBase && echoed == arbID)
+						devices |= 1u << (frames[k].arbID & 0x3F);
+				}
+			}
+		}
+		return devices;
+	}
+}
+
+int main()
+{
+	if (std::getenv(sim_test::kAdapterEnv) == nullptr) {
+		std::cout << "FAIL: set " << sim_test::kAdapterEnv << " to the CTRE_PhoenixPlatform_sim_testAdapter library" << std::endl;
+		return 1;
+	}
+
+	SimSetVirtualTime(true);
+	Check(SimCreate(TalonSRXType, 1) == 0, "could not create device 1");
+	Check(SimCreate(TalonSRXType, 2) == 0, "could not create device 2");
+
+	/* let both send a status frame, that is how the sim learns their addresses */
+	for (int i = 0; i < 3; ++i)
+		SleepUs(1000);
+
+	const uint32_t both = (1u << 1) | (1u << 2);
+	Check(DevicesThatGot(kControlBase | 1) == (1u << 1), "frame to device 1 did not go to device 1 only");
+	Check(DevicesThatGot(kControlBase | 2) == (1u << 2), "frame to device 2 did not go to device 2 only");
+	Check(DevicesThatGot(kControlBase | 0x3F) == both, "frame to device number 63 did not go to every device");
+	Check(DevicesThatGot((kControlBase & 0x00FFFFFF) | 1) == both, "frame to the broadcast device type did not go to every device");
+	Check(DevicesThatGot(kControlBase | 3) == both, "frame to an unknown device did not go to every device");
+
+	/* a destroyed device's address is forgotten, frames to it go to everyone left */
+	SimDestroy(TalonSRXType, 2);
+	Check(DevicesThatGot(kControlBase | 2) == (1u << 1), "frame to a destroyed device was not broadcast");
+
+	SimDestroyAll();
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * The sim's robot receive queue: frames lent by CANbus_LeaseFrames stay put until released,
+ * leasing again before releasing lends the same frames, and a release never frees frames it did not lend.
+ * With CANbus_SetRxClasses a more urgent class is received first, and snapshots keep each class's frames.
+ * A class set to CANbus_SetRxCoalescing keeps one frame per arbID, after the frames queued before the switch.
+ * Needs CTRE_TALON_LIBRARY_PATH set to the test adapter library, see TestAdapter.cpp.
+ */
+#include "ctre/phoenix/ErrorCode.h"
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "TestAdapter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream> // std::cout
+#include <vector>
+
+using namespace ctre::phoenix;
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	/* TalonSRX, CTRE, an API the adapter doesn't care about, device 1 */
+	const uint32_t kControlBase = 0x02040C01;
+	const uint32_t kFrames = 6;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	void Drain()
+	{
+		canframe_ex_t frames[32];
+		uint32_t filled = 0;
+		while (CANbus_ReceiveFrameEx(frames, 32, &filled) == 0 && filled > 0) {}
+	}
+
+	/* robot frames numbered from first, the device echoes each one back with the number in data[0..3] */
+	void SendNumbered(uint32_t first, uint32_t count)
+	{
+		uint8_t data[8] = {};
+		for (uint32_t i = 0; i < count; ++i)
+			(void)CANbus_SendFrame(kControlBase + ((first + i) << 6), data, 8);
+		for (int i = 0; i < 5; ++i)
+			SleepUs(1000);
+	}
+
+	/* echoes only, status frames may be interleaved */
+	std::vector<uint32_t> Echoes(const canframe_lease_t & lease)
+	{
+		std::vector<uint32_t> echoed;
+		auto add = [&](const canframe_ex_t & frame) {
+			if ((frame.arbID & ~0x3Fu) != sim_test::kEchoBase)
+				return;
+			uint32_t arbID;
+			std::memcpy(&arbID, frame.data, sizeof(arbID));
+			echoed.push_back((arbID - kControlBase) >> 6);
+		};
+		for (uint32_t i = 0; i < lease.firstCount; ++i)
+			add(lease.first[i]);
+		for (uint32_t i = 0; i < lease.secondCount; ++i)
+			add(lease.second[i]);
+		return echoed;
+	}
+
+	uint32_t Lent(const canframe_lease_t & lease)
+	{
+		return lease.firstCount + lease.secondCount;
+	}
+
+	bool IsStatus(const canframe_ex_t & frame)
+	{
+		return (frame.arbID & ~0x3Fu) == sim_test::kStatusBase;
+	}
+
+	/* status frames in class 0, echoes in class 2 */
+	void CheckClasses()
+	{
+		canframe_class_rule_t rule = { sim_test::kStatusBase | 1, sim_test::kStatusBase | 1, 0x1FFFFFFF, 0 };
+		Check(CANbus_SetRxClasses(&rule, 1, kRxClassCount) == ErrorCode::InvalidParamValue, "SetRxClasses took a default class out of range");
+		Check(CANbus_SetRxClasses(&rule, 1, 2) == 0, "SetRxClasses failed");
+		canframe_ex_t frames[64];
+		uint32_t filled = 0;
+		Check(CANbus_ReceiveClassEx(kRxClassCount, frames, 64, &filled) == ErrorCode::InvalidParamValue, "ReceiveClassEx took a class out of range");
+
+		/* echoes first, then let a status frame come in behind them */
+		Drain();
+		SendNumbered(0, kFrames);
+		SleepUs(static_cast<int>(sim_test::kStatusPeriodUs));
+		Check(CANbus_ReceiveFrameEx(frames, 1, &filled) == 0 && filled == 1 && IsStatus(frames[0]), "class 0 status frame was not received ahead of the echoes");
+
+		/* the world is the same after a snapshot round trip, each frame back in its class */
+		SleepUs(static_cast<int>(sim_test::kStatusPeriodUs));
+		SimSnapshot * snapshot = nullptr;
+		Check(SimSnapshotTake(&snapshot) == 0, "SimSnapshotTake failed");
+		Drain();
+		Check(snapshot != nullptr && SimSnapshotRestore(snapshot) == 0, "SimSnapshotRestore failed");
+		(void)SimSnapshotRelease(snapshot);
+
+		Check(CANbus_ReceiveClassEx(0, frames, 64, &filled) == 0 && filled > 0, "class 0 was empty after restore");
+		for (uint32_t i = 0; i < filled; ++i)
+			Check(IsStatus(frames[i]), "class 0 got a frame it has no rule for");
+		Check(CANbus_ReceiveClassEx(2, frames, 64, &filled) == 0 && filled >= kFrames, "class 2 lost its echoes over a snapshot");
+		uint32_t next = 0;
+		for (uint32_t i = 0; i < filled; ++i) {
+			Check(IsStatus(frames[i]) == false, "class 2 got a status frame");
+			uint32_t arbID;
+			std::memcpy(&arbID, frames[i].data, sizeof(arbID));
+			Check(((arbID - kControlBase) >> 6) == next++, "class 2 echoes out of order after a snapshot");
+		}
+
+		Check(CANbus_SetRxClasses(nullptr, 0, 0) == 0, "could not go back to a single class");
+	}
+
+	/* every echo has the same arbID, so coalesced they are just the latest one */
+	void CheckCoalescing()
+	{
+		Check(CANbus_SetRxCoalescing(kRxClassCount, true) == ErrorCode::InvalidParamValue, "SetRxCoalescing took a class out of range");
+		Drain();
+
+		/* queued before the switch, so received first and all of them */
+		SendNumbered(0, 3);
+		Check(CANbus_SetRxCoalescing(0, true) == 0, "SetRxCoalescing failed");
+		SendNumbered(3, 3);
+
+		canframe_ex_t frames[64];
+		uint32_t filled = 0;
+		Check(CANbus_ReceiveFrameEx(frames, 64, &filled) == 0, "receive from a coalescing class failed");
+		std::vector<uint32_t> echoed;
+		for (uint32_t i = 0; i < filled; ++i) {
+			if (IsStatus(frames[i]))
+				continue;
+			uint32_t arbID;
+			std::memcpy(&arbID, frames[i].data, sizeof(arbID));
+			echoed.push_back((arbID - kControlBase) >> 6);
+		}
+		Check(echoed == std::vector<uint32_t>({ 0, 1, 2, 5 }), "coalescing did not keep the FIFO frames first and then only the latest echo");
+
+		/* a lent frame is never replaced, the newer one queues behind it */
+		SendNumbered(6, 1);
+		canframe_lease_t lease = {};
+		Check(CANbus_LeaseFrames(&lease, 64) == 0 && Lent(lease) > 0, "nothing lent from a coalescing class");
+		std::vector<uint32_t> lent = Echoes(lease);
+		SendNumbered(7, 2);
+		Check(lent == Echoes(lease) && lent == std::vector<uint32_t>({ 6 }), "a lent frame was replaced");
+		Check(CANbus_ReleaseFrames(Lent(lease)) == 0, "ReleaseFrames failed");
+		Check(CANbus_LeaseFrames(&lease, 64) == 0 && Echoes(lease) == std::vector<uint32_t>({ 8 }), "newer frame did not queue behind the lent one");
+		Check(CANbus_ReleaseFrames(Lent(lease)) == 0, "ReleaseFrames failed");
+
+		Check(CANbus_SetRxCoalescing(0, false) == 0, "could not go back to FIFO");
+	}
+}
+
+int main()
+{
+	if (std::getenv(sim_test::kAdapterEnv) == nullptr) {
+		std::cout << "FAIL: set " << sim_test::kAdapterEnv << " to the CTRE_PhoenixPlatform_sim_testAdapter library" << std::endl;
+		return 1;
+	}
+
+	SimSetVirtualTime(true);
+	Check(SimCreate(TalonSRXType, 1) == 0, "could not create device 1");
+	SleepUs(1000);
+	Drain();
+
+	/* lease everything, then lease again without releasing, the same frames come back */
+	SendNumbered(0, kFrames);
+	canframe_lease_t lease = {};
+	Check(CANbus_LeaseFrames(&lease, 64) == 0, "LeaseFrames failed");
+	std::vector<uint32_t> echoed = Echoes(lease);
+	Check(echoed.size() == kFrames, "LeaseFrames did not lend every echo");
+	for (uint32_t i = 0; i < echoed.size(); ++i)
+		Check(echoed[i] == i, "LeaseFrames lent echoes out of order");
+
+	const canframe_ex_t * firstLent = lease.first;
+	canframe_ex_t saved = *lease.first;
+	Check(CANbus_LeaseFrames(&lease, 64) == 0 && lease.first == firstLent, "leasing again did not lend the same frames first");
+
+	/* more traffic while the frames are lent must not touch them */
+	SendNumbered(kFrames, kFrames);
+	Check(std::memcmp(firstLent, &saved, sizeof(saved)) == 0, "a lent frame changed before it was released");
+
+	/* release part of the lease, the rest comes first next time */
+	uint32_t lent = Lent(lease);
+	Check(lent >= 2, "not enough frames lent to release part of them");
+	canframe_ex_t third = (lease.firstCount > 2) ? lease.first[2] : lease.second[2 - lease.firstCount];
+	Check(CANbus_ReleaseFrames(2) == 0, "ReleaseFrames failed");
+	Check(CANbus_LeaseFrames(&lease, 64) == 0 && Lent(lease) > 0, "nothing lent after a partial release");
+	Check(std::memcmp(lease.first, &third, sizeof(third)) == 0, "lease after a partial release did not start after the released frames");
+
+	/* receiving ends the lease, a late release of more than is left frees nothing it should not */
+	canframe_ex_t frames[64];
+	uint32_t filled = 0;
+	Check(CANbus_ReceiveFrameEx(frames, 64, &filled) == 0 && filled > 0, "receive after a lease got nothing");
+	Check(CANbus_ReleaseFrames(64) == 0, "ReleaseFrames after a receive failed");
+	SendNumbered(2 * kFrames, kFrames);
+	Check(CANbus_LeaseFrames(&lease, 64) == 0, "LeaseFrames after a stale release failed");
+	echoed = Echoes(lease);
+	Check(echoed.size() == kFrames && echoed.front() == 2 * kFrames, "a stale release lost or freed frames");
+	Check(CANbus_ReleaseFrames(Lent(lease)) == 0, "ReleaseFrames failed");
+
+	/* an empty queue lends nothing */
+	Check(CANbus_LeaseFrames(&lease, 64) == 0 && Lent(lease) == 0, "empty queue lent frames");
+
+	CheckClasses();
+	CheckCoalescing();
+
+	SimDestroyAll();
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
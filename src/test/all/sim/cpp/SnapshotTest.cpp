@@ -0,0 +1,113 @@
+/**
+ * Restoring a snapshot puts the clock, the bus, the robot's receive queue and the devices back, so the
+ * robot receives exactly the same frames, with the same timestamps, as it did after the snapshot was taken.
+ * Needs CTRE_TALON_LIBRARY_PATH set to the test adapter library, see TestAdapter.cpp.
+ */
+#include "ctre/phoenix/platform/Platform.h"
+#include "ctre/phoenix/platform/PlatformExt.h"
+#include "ctre/phoenix/platform/PlatformSim.h"
+#include "TestAdapter.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream> // std::cout
+#include <vector>
+
+using namespace ctre::phoenix::platform;
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const uint32_t kControl = 0x02040C01;
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	bool Same(const canframe_ex_t & a, const canframe_ex_t & b)
+	{
+		return a.arbID == b.arbID && a.dlc == b.dlc && a.timeStampNs == b.timeStampNs && std::memcmp(a.data, b.data, 8) == 0;
+	}
+
+	/* what the robot receives over the next stepsMs of sim time */
+	std::vector<canframe_ex_t> Run(int stepsMs)
+	{
+		std::vector<canframe_ex_t> received;
+		for (int i = 0; i < stepsMs; ++i) {
+			SleepUs(1000);
+
+			canframe_ex_t frames[32];
+			uint32_t filled = 0;
+			while (CANbus_ReceiveFrameEx(frames, 32, &filled) == 0 && filled > 0)
+				received.insert(received.end(), frames, frames + filled);
+		}
+		return received;
+	}
+
+	uint32_t DeviceCount()
+	{
+		SimDeviceStats stats[4];
+		uint32_t filled = 0;
+		(void)SimGetDeviceStats(stats, 4, &filled);
+		return filled;
+	}
+}
+
+int main()
+{
+	if (std::getenv(sim_test::kAdapterEnv) == nullptr) {
+		std::cout << "FAIL: set " << sim_test::kAdapterEnv << " to the CTRE_PhoenixPlatform_sim_testAdapter library" << std::endl;
+		return 1;
+	}
+
+	SimSetVirtualTime(true);
+	Check(SimCreate(TalonSRXType, 1) == 0, "could not create the test device");
+	(void)Run(25);
+
+	/* leave status frames queued for the robot and a robot frame still on the bus */
+	for (int i = 0; i < 25; ++i)
+		SleepUs(1000);
+	uint8_t data[8] = {};
+	Check(CANbus_SendFrame(kControl, data, 8) == 0, "could not send");
+
+	SimSnapshot * snapshot = nullptr;
+	Check(SimSnapshotTake(&snapshot) == 0 && snapshot != nullptr, "could not take a snapshot");
+	uint64_t takenUs = SimGetTimeUs();
+
+	std::vector<canframe_ex_t> first = Run(30);
+	Check(first.size() >= 5, "too few frames after the snapshot to compare");
+
+	/* a device created after the snapshot goes away on restore */
+	Check(SimCreate(TalonSRXType, 2) == 0, "could not create a second device");
+	Check(DeviceCount() == 2, "second device missing");
+
+	Check(SimSnapshotRestore(snapshot) == 0, "could not restore the snapshot");
+	Check(SimGetTimeUs() == takenUs, "clock not restored");
+	Check(DeviceCount() == 1, "device created after the snapshot survived the restore");
+
+	std::vector<canframe_ex_t> second = Run(30);
+	Check(second.size() == first.size(), "different number of frames after the restore");
+	for (size_t i = 0; i < first.size() && i < second.size(); ++i) {
+		if (Same(first[i], second[i]) == false) {
+			Check(false, "different frames after the restore");
+			break;
+		}
+	}
+
+	/* a snapshot can be restored as often as needed */
+	Check(SimSnapshotRestore(snapshot) == 0, "could not restore the snapshot twice");
+	std::vector<canframe_ex_t> third = Run(30);
+	Check(third.size() == first.size(), "different number of frames after the second restore");
+
+	(void)SimSnapshotRelease(snapshot);
+	SimDestroyAll();
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * Adapter library the sim tests create their devices from, point CTRE_TALON_LIBRARY_PATH at it.
+ * Each device loads its own copy, so everything here is per device.
+ *
+ * It sends a status frame every 10 ms of sim time and echoes every frame the robot sends it,
+ * addressed to it or not, so a test can see which devices the sim delivered a frame to.
+ * Its state can be saved and loaded, so a snapshot restores it exactly.
+ */
+#include "ctre/phoenix/platform/SimulationAdapterExt.h"
+#include "TestAdapter.h"
+
+#include <cstring>
+#include <deque>
+
+using namespace sim_test;
+
+namespace {
+	struct Pending {
+		uint32_t arbID;
+		uint32_t payload;
+	};
+
+	int deviceID = 0;
+	uint64_t nextStatusUs = 0;
+	std::deque<Pending> pending;
+
+	void Put(uint8_t * buffer, uint32_t & offset, const void * value, uint32_t size)
+	{
+		std::memcpy(buffer + offset, value, size);
+		offset += size;
+	}
+
+	void Get(const uint8_t * buffer, uint32_t & offset, void * value, uint32_t size)
+	{
+		std::memcpy(value, buffer + offset, size);
+		offset += size;
+	}
+}
+
+CTRE_SIM_ADAPTER_EXPORT int ctre_phoenix_simulation_adapter_Start(int id)
+{
+	deviceID = id;
+	nextStatusUs = 0;
+	pending.clear();
+	return 0;
+}
+
+CTRE_SIM_ADAPTER_EXPORT int ctre_phoenix_simulation_adapter_SendCANFrame(uint32_t messageID, const uint8_t * /*data*/, uint8_t /*dataSize*/)
+{
+	Pending echo = { kEchoBase | static_cast<uint32_t>(deviceID), messageID };
+	pending.push_back(echo);
+	return 0;
+}
+
+CTRE_SIM_ADAPTER_EXPORT int ctre_phoenix_simulation_adapter_ReceiveCANFrame(uint32_t * messageID, uint8_t * data, uint8_t * dataSize)
+{
+	if (pending.empty())
+		return 1;
+	*messageID = pending.front().arbID;
+	std::memset(data, 0, 8);
+	std::memcpy(data, &pending.front().payload, sizeof(uint32_t));
+	*dataSize = 8;
+	pending.pop_front();
+	return 0;
+}
+
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_SetTime(uint64_t timeUs)
+{
+	if (timeUs >= nextStatusUs) {
+		Pending status = { kStatusBase | static_cast<uint32_t>(deviceID), static_cast<uint32_t>(timeUs) };
+		pending.push_back(status);
+		nextStatusUs = timeUs - timeUs % kStatusPeriodUs + kStatusPeriodUs;
+	}
+	return 0;
+}
+
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_SaveState(uint8_t * buffer, uint32_t capacity, uint32_t * size)
+{
+	uint32_t count = static_cast<uint32_t>(pending.size());
+	*size = static_cast<uint32_t>(sizeof(nextStatusUs) + sizeof(count) + count * sizeof(Pending));
+	if (buffer == nullptr)
+		return 0;
+	if (capacity < *size)
+		return 1;
+
+	uint32_t offset = 0;
+	Put(buffer, offset, &nextStatusUs, sizeof(nextStatusUs));
+	Put(buffer, offset, &count, sizeof(count));
+	for (const Pending & frame : pending)
+		Put(buffer, offset, &frame, sizeof(frame));
+	return 0;
+}
+
+CTRE_SIM_ADAPTER_EXPORT int32_t ctre_phoenix_simulation_adapter_LoadState(const uint8_t * buffer, uint32_t size)
+{
+	uint32_t offset = 0;
+	uint32_t count = 0;
+	if (size < sizeof(nextStatusUs) + sizeof(count))
+		return 1;
+	Get(buffer, offset, &nextStatusUs, sizeof(nextStatusUs));
+	Get(buffer, offset, &count, sizeof(count));
+	if (size != offset + count * sizeof(Pending))
+		return 1;
+
+	pending.clear();
+	for (uint32_t i = 0; i < count; ++i) {
+		Pending frame;
+		Get(buffer, offset, &frame, sizeof(frame));
+		pending.push_back(frame);
+	}
+	return 0;
+}
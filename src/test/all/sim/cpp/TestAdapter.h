@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Frames the sim tests' adapter library sends, see TestAdapter.cpp.
+ * Device number in bits 5:0, like every CTRE arbitration ID.
+ */
+namespace sim_test {
+	/* TalonSRX status frame, sent every kStatusPeriodUs of sim time, data[0..3] hold the sim time in us */
+	const uint32_t kStatusBase = 0x02041400;
+	const uint64_t kStatusPeriodUs = 10000;
+	/* answer to every frame the device gets from the robot, data[0..3] hold the arbID it got */
+	const uint32_t kEchoBase = 0x02041800;
+
+	/* adapter the tests create their devices from */
+	const char * const kAdapterEnv = "CTRE_TALON_LIBRARY_PATH";
+}
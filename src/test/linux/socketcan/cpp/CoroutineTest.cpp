@@ -0,0 +1,146 @@
+/**
+ * CANAsyncReceiver resumes waiters with the frames they asked for, times them out on CANbus_GetTimeNs,
+ * and only copies frames, CANbus_ReceiveFrameEx still gets every one.
+ * A socketpair stands in for the CAN socket, same as TxPriorityTest.
+ * Needs a compiler with coroutines, without one it only reports SKIP.
+ */
+#include "Platform_socketcan.cpp"
+
+#include <iostream> // std::cout
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include "ctre/phoenix/platform/CANCoroutine.h"
+
+#include <sys/socket.h>
+
+#include <coroutine>
+#include <exception>
+
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	const uint32_t kExact = 0x1FFFFFFF;
+	const uint32_t kWanted = 0x02041400;
+	const uint32_t kOther = 0x02041480;
+	const uint32_t kBatchBase = 0x02050000;
+	const uint32_t kBatchCount = 5;
+
+	/* fire and forget coroutine, runs until its first co_await when called */
+	struct Task {
+		struct promise_type {
+			Task get_return_object() { return Task(); }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	struct Results {
+		bool done = false;
+		std::optional<canframe_ex_t> wanted;
+		std::optional<canframe_ex_t> missing;
+		uint64_t missingWaitNs = 0;
+		uint64_t delayNs = 0;
+		std::vector<canframe_ex_t> batch;
+	};
+
+	bool failed = false;
+
+	void Check(bool condition, const char * what)
+	{
+		if (condition == false) {
+			std::cout << "FAIL: " << what << std::endl;
+			failed = true;
+		}
+	}
+
+	bool Write(int fd, uint32_t arbID)
+	{
+		struct can_frame frame;
+		std::memset(&frame, 0, sizeof(frame));
+		frame.can_id = arbID | CAN_EFF_FLAG;
+		frame.can_dlc = 8;
+		return write(fd, &frame, sizeof(frame)) == (ssize_t) sizeof(frame);
+	}
+
+	Task Run(CANAsyncReceiver & rx, int peer, Results & results)
+	{
+		/* the other frame goes first, the waiter must skip it */
+		(void)Write(peer, kOther);
+		(void)Write(peer, kWanted);
+		results.wanted = co_await rx.NextFrame(kWanted, kExact, std::chrono::seconds(2));
+
+		uint64_t start = CANbus_GetTimeNs();
+		results.missing = co_await rx.NextFrame(0x1234, kExact, std::chrono::milliseconds(20));
+		results.missingWaitNs = CANbus_GetTimeNs() - start;
+
+		start = CANbus_GetTimeNs();
+		co_await rx.Delay(std::chrono::milliseconds(10));
+		results.delayNs = CANbus_GetTimeNs() - start;
+
+		for (uint32_t i = 0; i < kBatchCount; ++i)
+			(void)Write(peer, kBatchBase | i);
+		results.batch = co_await rx.Frames(kBatchBase, 0x1FFFFF00, kBatchCount, std::chrono::seconds(2));
+		results.done = true;
+	}
+}
+
+int main()
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+		std::cout << "could not create socketpair: " << strerror(errno) << std::endl;
+		return 1;
+	}
+	ctre::phoenix::platform::can::socket = sv[0];
+	StartRx();
+
+	Results results;
+	{
+		CANAsyncReceiver rx;
+		Check(rx.Status() == 0, "receiver did not subscribe");
+		intptr_t handle;
+		Check(rx.EventHandle(handle), "receiver has no event handle");
+
+		Run(rx, sv[1], results);
+		uint64_t giveUp = CANbus_GetTimeNs() + 5000000000ULL;
+		while (results.done == false && CANbus_GetTimeNs() < giveUp)
+			(void)rx.RunOnce(std::chrono::milliseconds(100));
+		Check(rx.Dropped() == 0, "receiver dropped frames");
+	}
+
+	Check(results.done, "coroutine never finished");
+	Check(results.wanted.has_value() && results.wanted->arbID == kWanted, "NextFrame got the wrong frame");
+	Check(results.missing.has_value() == false, "NextFrame for a frame never sent did not time out");
+	Check(results.missingWaitNs >= 20000000, "NextFrame timed out early");
+	Check(results.delayNs >= 10000000, "Delay resumed early");
+	Check(results.batch.size() == kBatchCount, "Frames did not get the whole batch");
+	for (uint32_t i = 0; i < results.batch.size(); ++i)
+		Check(results.batch[i].arbID == (kBatchBase | i), "Frames got the batch out of order");
+
+	/* the receiver only copied, the platform queue still has every frame */
+	uint32_t queued = 0;
+	canframe_ex_t frames[64];
+	uint32_t filled = 0;
+	while (CANbus_ReceiveFrameEx(frames, 64, &filled) == 0)
+		queued += filled;
+	Check(queued == 2 + kBatchCount, "CANbus_ReceiveFrameEx lost frames to the receiver");
+
+	ctre::phoenix::platform::DisposePlatform();
+	if (failed)
+		return 1;
+	std::cout << "PASS" << std::endl;
+	return 0;
+}
+
+#else
+
+int main()
+{
+	std::cout << "SKIP: compiler has no coroutines" << std::endl;
+	return 0;
+}
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * Frames queued behind a full device queue must leave lowest ID first, the order the bus would arbitrate them.
+ * A socketpair stands in for the CAN socket so no interface is needed, the platform is built into the test
+ * to reach its socket.
+ */
+#include "Platform_socketcan.cpp"
+
+#include <sys/socket.h>
+
+#include <functional>
+#include <iostream> // std::cout
+
+using namespace ctre::phoenix::platform::can;
+
+namespace {
+	/* CTRE control frames win arbitration over parameter frames for the same device */
+	const uint32_t kHighPriority = 0x02040000;
+	const uint32_t kLowPriority = 0x02041880;
+	const uint32_t kFramesPerClass = 32;
+	const uint32_t kFiller = 0x1F000000;
+
+	bool WaitFor(const std::function<bool()> & condition)
+	{
+		for (int i = 0; i < 2000; ++i) {
+			if (condition())
+				return true;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+}
+
+int main()
+{
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) != 0) {
+		std::cout << "could not create socketpair: " << strerror(errno) << std::endl;
+		return 1;
+	}
+	int size = 4096;
+	(void)setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	(void)setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	ctre::phoenix::platform::can::socket = sv[0];
+	StartTx();
+
+	/* stall the writer: fill the device queue until a send has to wait */
+	uint8_t data[8] = {};
+	uint32_t filler = 0;
+	bool stalled = WaitFor([&] {
+		(void)CANbus_SendFrame(kFiller | filler++, data, 8);
+		return txFullCount.load() > 0;
+	});
+	if (stalled == false) {
+		std::cout << "FAIL: writer never stalled" << std::endl;
+		return 1;
+	}
+
+	/* low priority first, so send order alone would get it wrong */
+	for (uint32_t i = 0; i < kFramesPerClass; ++i)
+		(void)CANbus_SendFrame(kLowPriority | i, data, 8);
+	for (uint32_t i = 0; i < kFramesPerClass; ++i)
+		(void)CANbus_SendFrame(kHighPriority | i, data, 8);
+
+	/* drain, skipping filler, high priority must all come out before any low priority */
+	uint32_t high = 0;
+	uint32_t low = 0;
+	bool ok = true;
+	(void)WaitFor([&] {
+		struct can_frame frame;
+		while (recv(sv[1], &frame, sizeof(frame), MSG_DONTWAIT) == (ssize_t) sizeof(frame)) {
+			uint32_t arbID = frame.can_id & CAN_EFF_MASK;
+			if ((arbID & ~0x3Fu) == kHighPriority) {
+				if (low > 0 || (arbID & 0x3F) != high) { ok = false; }
+				++high;
+			}
+			else if ((arbID & ~0x3Fu) == kLowPriority) {
+				if ((arbID & 0x3F) != low) { ok = false; }
+				++low;
+			}
+		}
+		return high + low == 2 * kFramesPerClass;
+	});
+	ctre::phoenix::platform::DisposePlatform();
+
+	if (ok == false || high != kFramesPerClass || low != kFramesPerClass) {
+		std::cout << "FAIL: got " << high << " high and " << low << " low priority frames, order " << (ok ? "ok" : "wrong") << std::endl;
+		return 1;
+	}
+	std::cout << "PASS" << std::endl;
+	return 0;
+}